@@ -0,0 +1,223 @@
+#include "corpusgenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// SplitMix64: быстрый и одинаковый на всех платформах, в отличие от std::*_distribution
+class Random
+{
+public:
+    explicit Random(quint64 seed) : _state(seed) {}
+
+    quint64 next()
+    {
+        quint64 z = (_state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    quint32 below(quint32 bound) { return static_cast<quint32>(next() % bound); }
+    double unit() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    quint64 _state;
+};
+
+class ZipfSampler
+{
+public:
+    ZipfSampler(qsizetype n, double s)
+    {
+        _cdf.reserve(static_cast<size_t>(n));
+        double total = 0;
+        for (qsizetype k = 1; k <= n; ++k) {
+            total += 1.0 / std::pow(static_cast<double>(k), s);
+            _cdf.push_back(total);
+        }
+        for (double& v : _cdf)
+            v /= total;
+    }
+
+    qsizetype sample(Random& rng) const
+    {
+        const auto it = std::lower_bound(_cdf.begin(), _cdf.end(), rng.unit());
+        return qMin(static_cast<qsizetype>(it - _cdf.begin()), static_cast<qsizetype>(_cdf.size()) - 1);
+    }
+
+private:
+    std::vector<double> _cdf;
+};
+
+constexpr qsizetype kVocabularySize = 50000;
+constexpr double kZipfExponent = 1.07;
+
+QList<QByteArray> englishVocabulary(Random& rng)
+{
+    static const char* const syllables[] = {
+        "the", "an", "er", "in", "on", "at", "re", "st", "en", "ing", "ou", "al", "pro",
+        "con", "ver", "tion", "ly", "ment", "ex", "de", "com", "ab", "ble", "ti", "ra",
+        "lo", "ca", "mi", "sa", "po", "ter", "ness", "ful", "ight", "or", "us", "is"
+    };
+    const quint32 count = sizeof(syllables) / sizeof(syllables[0]);
+
+    QList<QByteArray> words;
+    words.reserve(kVocabularySize);
+    for (qsizetype i = 0; i < kVocabularySize; ++i) {
+        QByteArray word;
+        const quint32 parts = 1 + rng.below(4);
+        for (quint32 p = 0; p < parts; ++p)
+            word += syllables[rng.below(count)];
+        words.append(word);
+    }
+    return words;
+}
+
+QList<QByteArray> unicodeVocabulary(Random& rng)
+{
+    // Диапазоны строчных букв: кириллица, греческий, латиница-1 с диакритикой
+    static const char16_t ranges[][2] = {
+        {0x0430, 0x044F}, {0x03B1, 0x03C9}, {0x00E0, 0x00FF}
+    };
+
+    QList<QByteArray> words;
+    words.reserve(kVocabularySize);
+    for (qsizetype i = 0; i < kVocabularySize; ++i) {
+        // Большая часть слов в одном алфавите, как в реальном тексте; иногда с ASCII-вставкой
+        const auto& range = ranges[rng.below(10) < 7 ? 0 : 1 + rng.below(2)];
+        QString word;
+        const quint32 length = 2 + rng.below(9);
+        for (quint32 c = 0; c < length; ++c)
+            word += QChar(static_cast<char16_t>(range[0] + rng.below(range[1] - range[0] + 1)));
+        if (rng.below(10) == 0)
+            word += QString::number(rng.below(100));
+        words.append(word.toUtf8());
+    }
+    return words;
+}
+
+QByteArray capitalizeAscii(QByteArray word)
+{
+    if (!word.isEmpty() && word[0] >= 'a' && word[0] <= 'z')
+        word[0] = static_cast<char>(word[0] - ('a' - 'A'));
+    return word;
+}
+
+QByteArray generateText(const QList<QByteArray>& vocabulary, qint64 size, Random& rng)
+{
+    const ZipfSampler zipf(vocabulary.size(), kZipfExponent);
+    QByteArray out;
+    out.reserve(size + 64);
+
+    while (out.size() < size) {
+        const quint32 words = 6 + rng.below(15);
+        for (quint32 w = 0; w < words; ++w) {
+            const QByteArray& word = vocabulary[zipf.sample(rng)];
+            out += (w == 0) ? capitalizeAscii(word) : word;
+            if (w + 1 == words)
+                out += rng.below(5) == 0 ? "!" : ".";
+            else if (rng.below(9) == 0)
+                out += ',';
+            out += ' ';
+        }
+        if (rng.below(4) == 0)
+            out += '\n';
+    }
+    out.truncate(size);
+    return out;
+}
+
+QByteArray generateLogs(qint64 size, Random& rng)
+{
+    static const char* const levels[] = {"INFO", "INFO", "INFO", "INFO", "DEBUG", "DEBUG", "WARN", "ERROR"};
+    static const char* const components[] = {
+        "http", "db", "cache", "auth", "scheduler", "worker", "billing", "search", "mailer", "storage"
+    };
+    static const char* const messages[] = {
+        "request completed", "request started", "cache miss", "retrying operation",
+        "connection reset by peer", "slow query detected", "token refreshed", "job queued"
+    };
+
+    QByteArray out;
+    out.reserve(size + 256);
+    qint64 millis = 1714557600000LL;    // 2024-05-01T10:00:00Z
+    char hex[17];
+    static const char digits[] = "0123456789abcdef";
+
+    while (out.size() < size) {
+        millis += rng.below(50);
+        const qint64 s = millis / 1000;
+        QByteArray line = QByteArray::number(s) + '.' + QByteArray::number(millis % 1000).rightJustified(3, '0');
+
+        quint64 id = rng.next();
+        for (int i = 0; i < 16; ++i, id >>= 4)
+            hex[i] = digits[id & 0xF];
+        hex[16] = '\0';
+
+        line += ' ';
+        line += levels[rng.below(8)];
+        line += " [";
+        line += components[rng.below(10)];
+        line += '-';
+        line += QByteArray::number(rng.below(32));
+        line += "] ";
+        line += messages[rng.below(8)];
+        line += " request_id=";
+        line += hex;
+        line += " user=u";
+        line += QByteArray::number(rng.below(1000000));
+        line += " latency=";
+        line += QByteArray::number(rng.below(5000));
+        line += "ms path=/api/v1/items/";
+        line += QByteArray::number(rng.below(10000000));
+        line += '\n';
+        out += line;
+    }
+    out.truncate(size);
+    return out;
+}
+
+} // namespace
+
+bool CorpusGenerator::parseKind(const QString& name, Kind& kind)
+{
+    const QString lower = name.trimmed().toLower();
+    if (lower == "zipf")
+        kind = Kind::Zipf;
+    else if (lower == "logs")
+        kind = Kind::Logs;
+    else if (lower == "unicode")
+        kind = Kind::Unicode;
+    else
+        return false;
+    return true;
+}
+
+QString CorpusGenerator::kindName(Kind kind)
+{
+    switch (kind) {
+    case Kind::Zipf:
+        return "zipf";
+    case Kind::Logs:
+        return "logs";
+    case Kind::Unicode:
+        return "unicode";
+    }
+    return QString();
+}
+
+QByteArray CorpusGenerator::generate(Kind kind, qint64 size, quint64 seed)
+{
+    Random rng(seed);
+    switch (kind) {
+    case Kind::Zipf:
+        return generateText(englishVocabulary(rng), size, rng);
+    case Kind::Logs:
+        return generateLogs(size, rng);
+    case Kind::Unicode:
+        return generateText(unicodeVocabulary(rng), size, rng);
+    }
+    return QByteArray();
+}
@@ -0,0 +1,25 @@
+#ifndef CORPUSGENERATOR_H
+#define CORPUSGENERATOR_H
+
+#include <QByteArray>
+#include <QString>
+
+// Синтетические корпуса для wordpulse_bench. Генерация детерминирована:
+// одни и те же kind, size и seed дают одни и те же байты на любой машине,
+// так что результаты разных коммитов сравнимы.
+class CorpusGenerator
+{
+public:
+    enum class Kind {
+        Zipf,       // англоподобный текст, частоты слов по закону Ципфа
+        Logs,       // строки логов с идентификаторами высокой кардинальности
+        Unicode     // кириллица, греческий и латиница с диакритикой, тоже по Ципфу
+    };
+
+    static bool parseKind(const QString& name, Kind& kind);
+    static QString kindName(Kind kind);
+
+    static QByteArray generate(Kind kind, qint64 size, quint64 seed = 42);
+};
+
+#endif // CORPUSGENERATOR_H
@@ -0,0 +1,306 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QMap>
+#include <QTemporaryFile>
+#include <QThread>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <vector>
+#include "corpusgenerator.h"
+#include "config.h"
+#include "filereaderthread.h"
+#include "topnselector.h"
+#include "wordcounttable.h"
+#include "wordtokenizer.h"
+
+// Замеры стадий конвейера по отдельности: чтение (FileReaderThread с
+// отображением окон и нарезкой по разделителям; с постоянным блоком и с
+// adaptive_chunking), токенизация, подсчёт в
+// WordCountTable (и для сравнения в QMap<QString, quint64>) и выбор top-N. Каждая стадия гоняется repeat раз, в отчёт
+// идёт лучший прогон. Файл для чтения только что записан, то есть лежит в
+// page cache: меряется сам читатель, а не диск.
+// С --reader-grid читатель ещё прогоняется по сетке постоянных размеров блока и
+// глубин очереди (стадия reader_static): с ней сравнивается reader_adaptive.
+
+namespace {
+
+struct Result {
+    QString corpus;
+    QString stage;
+    qint64 bytes;
+    qint64 items;
+    QString itemName;
+    double seconds;
+    quint64 checksum;
+    // Только для reader_static: постоянные размер блока и глубина очереди
+    qint64 chunkBytes = 0;
+    qint32 depth = 0;
+};
+
+// Сетка для reader_static; пустая - стадия не гоняется
+struct ReaderGrid {
+    QList<qint64> chunkBytes;
+    QList<qint32> depths;
+};
+
+// Слова корпуса подряд в одном буфере: подсчёт меряется без токенизатора
+struct TokenList {
+    QByteArray storage;
+    std::vector<std::pair<qsizetype, qsizetype>> spans;
+};
+
+double bestOf(int repeat, const std::function<quint64()>& run, quint64& checksum)
+{
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < repeat; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        checksum = run();
+        best = qMin(best, static_cast<double>(timer.nsecsElapsed()) / 1e9);
+    }
+    return best;
+}
+
+quint64 runReader(const QString& path, const Config& config)
+{
+    FileReaderThread reader(path, config);
+    QEventLoop loop;
+    quint64 bytes = 0;
+
+    const auto drain = [&reader, &bytes]() {
+        QByteArrayView blocks[8];
+        qsizetype sizeBefore = 0;
+        while (const qsizetype taken = reader.takeDataBlocks(blocks, 8, sizeBefore)) {
+            for (qsizetype i = 0; i < taken; ++i) {
+                bytes += static_cast<quint64>(blocks[i].size());
+                reader.releaseDataBlock(blocks[i]);
+            }
+        }
+    };
+    QObject::connect(&reader, &FileReaderThread::chunkIsReady, &loop, drain, Qt::QueuedConnection);
+    QObject::connect(&reader, &FileReaderThread::readingFinished, &loop, &QEventLoop::quit, Qt::QueuedConnection);
+    QObject::connect(&reader, &FileReaderThread::readingError, &loop, &QEventLoop::quit, Qt::QueuedConnection);
+
+    reader.start();
+    QMetaObject::invokeMethod(&reader, "startReading", Qt::QueuedConnection);
+    loop.exec();
+    drain();
+
+    QThread* mainThread = QThread::currentThread();
+    QMetaObject::invokeMethod(&reader, [&reader, mainThread]() {
+        reader.moveToThread(mainThread);
+    }, Qt::BlockingQueuedConnection);
+    reader.quit();
+    reader.wait();
+    return bytes;
+}
+
+void benchCorpus(CorpusGenerator::Kind kind, qint64 size, int repeat, qint32 topN, const ReaderGrid& grid,
+                 QList<Result>& results)
+{
+    const QString name = CorpusGenerator::kindName(kind);
+    std::fprintf(stderr, "generating %s corpus, %lld bytes\n", qPrintable(name), static_cast<long long>(size));
+    const QByteArray corpus = CorpusGenerator::generate(kind, size);
+
+    Config config = Config::defaultConfig();
+    config.top_n = topN;
+    if (kind == CorpusGenerator::Kind::Unicode)
+        config.string_pattern = "(*UCP)\\w+";
+    const WordTokenizer tokenizer(config);
+
+    TokenList tokens;
+    tokenizer.tokenize(corpus, [&tokens](QByteArrayView word) {
+        tokens.spans.push_back({tokens.storage.size(), word.size()});
+        tokens.storage.append(word.data(), word.size());
+    });
+    const qint64 tokenCount = static_cast<qint64>(tokens.spans.size());
+
+    // Чтение
+    QTemporaryFile file;
+    if (!file.open() || file.write(corpus) != corpus.size()) {
+        std::fprintf(stderr, "cannot write temporary corpus file\n");
+        return;
+    }
+    file.flush();
+    quint64 checksum = 0;
+    double seconds = bestOf(repeat, [&]() { return runReader(file.fileName(), config); }, checksum);
+    results.append({name, "reader", size, tokenCount, "token", seconds, checksum});
+
+    // То же чтение с подстройкой блока и очереди; начинает с тех же значений
+    Config adaptive = config;
+    adaptive.adaptive_chunking = true;
+    seconds = bestOf(repeat, [&]() { return runReader(file.fileName(), adaptive); }, checksum);
+    results.append({name, "reader_adaptive", size, tokenCount, "token", seconds, checksum});
+    const double adaptiveSeconds = seconds;
+
+    // Постоянные настройки по сетке: подстройка имеет смысл, только если не хуже лучшей из них
+    qsizetype bestStatic = -1;      // индекс в results: append может перенести элементы
+    for (const qint64 chunk : grid.chunkBytes) {
+        for (const qint32 depth : grid.depths) {
+            Config fixed = config;
+            fixed.chunk_size_bytes = chunk;
+            fixed.max_chunks_in_mem_num = depth;
+            seconds = bestOf(repeat, [&]() { return runReader(file.fileName(), fixed); }, checksum);
+            results.append({name, "reader_static", size, tokenCount, "token", seconds, checksum, chunk, depth});
+            if (bestStatic < 0 || seconds < results.at(bestStatic).seconds)
+                bestStatic = results.size() - 1;
+        }
+    }
+    if (bestStatic >= 0) {
+        const Result& best = results.at(bestStatic);
+        std::fprintf(stderr, "%s: reader_adaptive %.3f s, best reader_static %.3f s (chunk %lld, depth %d)\n",
+                     qPrintable(name), adaptiveSeconds, best.seconds,
+                     static_cast<long long>(best.chunkBytes), best.depth);
+    }
+
+    // Токенизация
+    seconds = bestOf(repeat, [&]() {
+        quint64 count = 0;
+        tokenizer.tokenize(corpus, [&count](QByteArrayView word) { count += static_cast<quint64>(word.size()); });
+        return count;
+    }, checksum);
+    results.append({name, "tokenizer", size, tokenCount, "token", seconds, checksum});
+
+    // Подсчёт: хеш + вставка/инкремент
+    WordCountTable table;
+    seconds = bestOf(repeat, [&]() {
+        table.clear();
+        for (const auto& span : tokens.spans)
+            table.add(QByteArrayView(tokens.storage.constData() + span.first, span.second));
+        return static_cast<quint64>(table.size());
+    }, checksum);
+    results.append({name, "count_table", size, tokenCount, "token", seconds, checksum});
+
+    // То же на QMap<QString, quint64>, которым считали до WordCountTable: база для сравнения
+    seconds = bestOf(repeat, [&]() {
+        QMap<QString, quint64> map;
+        for (const auto& span : tokens.spans)
+            ++map[QString::fromUtf8(tokens.storage.constData() + span.first, span.second)];
+        return static_cast<quint64>(map.size());
+    }, checksum);
+    results.append({name, "count_qmap", size, tokenCount, "token", seconds, checksum});
+
+    // Top-N по заполненной таблице, как в getTopWordsWithCount на каждом обновлении
+    seconds = bestOf(repeat, [&]() {
+        TopNSelector selector(topN);
+        table.forEach([&selector](QByteArrayView word, quint64, quint64 count) {
+            selector.offer(count, word);
+        });
+        const auto top = selector.takeAscending();
+        return top.isEmpty() ? quint64(0) : top.last().first;
+    }, checksum);
+    results.append({name, "top_n", 0, table.size(), "entry", seconds, checksum});
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("wordpulse_bench");
+    QLoggingCategory::setFilterRules("*.debug=false\n*.info=false");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures reader, tokenizer, counting and top-N throughput on synthetic corpora.");
+    parser.addHelpOption();
+    const QCommandLineOption sizeOption({"s", "size-mb"}, "Corpus size in MiB.", "mb", "64");
+    const QCommandLineOption corpusOption({"c", "corpus"}, "Comma-separated corpora: zipf, logs, unicode.", "list", "zipf,logs,unicode");
+    const QCommandLineOption repeatOption({"r", "repeat"}, "Runs per stage, the best one is reported.", "count", "3");
+    const QCommandLineOption topOption({"n", "top"}, "top_n for the top-N stage.", "count", "100");
+    const QCommandLineOption labelOption({"l", "label"}, "Free-form label stored in the report, e.g. a commit hash.", "text");
+    const QCommandLineOption outputOption({"o", "output"}, "Write the JSON report to a file instead of stdout.", "path");
+    const QCommandLineOption gridOption("reader-grid", "Also run the reader over a grid of static chunk sizes and queue depths.");
+    const QCommandLineOption gridChunkOption("grid-chunk-kb", "Comma-separated chunk sizes in KiB for --reader-grid.", "list",
+                                             "64,256,1024,4096");
+    const QCommandLineOption gridDepthOption("grid-depth", "Comma-separated queue depths for --reader-grid.", "list", "2,8,32");
+    parser.addOptions({sizeOption, corpusOption, repeatOption, topOption, labelOption, outputOption,
+                       gridOption, gridChunkOption, gridDepthOption});
+    parser.process(app);
+
+    const qint64 size = parser.value(sizeOption).toLongLong() * 1024 * 1024;
+    const int repeat = parser.value(repeatOption).toInt();
+    const qint32 topN = parser.value(topOption).toInt();
+    if (size <= 0 || repeat <= 0 || topN <= 0) {
+        std::fprintf(stderr, "wordpulse_bench: size, repeat and top must be positive\n");
+        return 2;
+    }
+
+    QList<CorpusGenerator::Kind> kinds;
+    for (const QString& name : parser.value(corpusOption).split(',', Qt::SkipEmptyParts)) {
+        CorpusGenerator::Kind kind;
+        if (!CorpusGenerator::parseKind(name, kind)) {
+            std::fprintf(stderr, "wordpulse_bench: unknown corpus %s\n", qPrintable(name));
+            return 2;
+        }
+        kinds.append(kind);
+    }
+
+    ReaderGrid grid;
+    if (parser.isSet(gridOption)) {
+        for (const QString& value : parser.value(gridChunkOption).split(',', Qt::SkipEmptyParts))
+            grid.chunkBytes.append(value.toLongLong() * 1024);
+        for (const QString& value : parser.value(gridDepthOption).split(',', Qt::SkipEmptyParts))
+            grid.depths.append(value.toInt());
+        const auto positive = [](auto v) { return v > 0; };
+        if (grid.chunkBytes.isEmpty() || grid.depths.isEmpty()
+            || !std::all_of(grid.chunkBytes.cbegin(), grid.chunkBytes.cend(), positive)
+            || !std::all_of(grid.depths.cbegin(), grid.depths.cend(), positive)) {
+            std::fprintf(stderr, "wordpulse_bench: grid chunk sizes and depths must be positive\n");
+            return 2;
+        }
+    }
+
+    QList<Result> results;
+    for (CorpusGenerator::Kind kind : kinds)
+        benchCorpus(kind, size, repeat, topN, grid, results);
+
+    QJsonArray rows;
+    for (const Result& r : results) {
+        QJsonObject row;
+        row["corpus"] = r.corpus;
+        row["stage"] = r.stage;
+        row["bytes"] = r.bytes;
+        row["items"] = r.items;
+        row["item"] = r.itemName;
+        row["seconds"] = r.seconds;
+        row["mb_per_s"] = r.bytes > 0 ? static_cast<double>(r.bytes) / (1024.0 * 1024.0) / r.seconds : 0.0;
+        row["ns_per_item"] = r.items > 0 ? r.seconds * 1e9 / static_cast<double>(r.items) : 0.0;
+        row["checksum"] = QString::number(r.checksum);
+        if (r.chunkBytes > 0) {
+            row["chunk_bytes"] = r.chunkBytes;
+            row["depth"] = r.depth;
+        }
+        rows.append(row);
+    }
+
+    QJsonObject report;
+    report["label"] = parser.value(labelOption);
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["qt_version"] = QString(qVersion());
+    report["cpu_count"] = QThread::idealThreadCount();
+    report["size_bytes"] = size;
+    report["repeat"] = repeat;
+    report["results"] = rows;
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet(outputOption)) {
+        QFile out(parser.value(outputOption));
+        if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate) || out.write(json) != json.size()) {
+            std::fprintf(stderr, "wordpulse_bench: cannot write %s\n", qPrintable(out.fileName()));
+            return 1;
+        }
+    } else {
+        std::fwrite(json.constData(), 1, static_cast<size_t>(json.size()), stdout);
+    }
+    return 0;
+}
@@ -81,6 +81,21 @@ ApplicationWindow {
             border.width: 1
         }
 
+        // МЕТРИКИ КОНВЕЙЕРА
+        Label {
+            Layout.fillWidth: true
+            visible: vm.hasMetrics
+            color: "#555"
+            text: "Чтение " + vm.readMBps.toFixed(1) + " МБ/с"
+                  + "  ·  Анализ " + vm.analyzeMBps.toFixed(1) + " МБ/с"
+                  + "  ·  Слов/с " + Math.round(vm.tokensPerSec)
+                  + "  ·  Очередь " + vm.queueDepth + "/" + vm.queueCapacity
+                  + "  ·  Простой чтения " + vm.readerStalledMs + " мс, анализа " + vm.analyzerStarvedMs + " мс"
+                  + "  ·  Слов в таблице " + vm.tableWords + " (" + (vm.tableBytes / (1024 * 1024)).toFixed(1) + " МБ)"
+                  + (vm.etaMs >= 0 ? "  ·  Осталось " + Math.ceil(vm.etaMs / 1000) + " с" : "")
+                  + "  ·  Узкое место: " + vm.bottleneck
+        }
+
         // ГИСТОГРАММА
         // ГИСТОГРАММА
         Rectangle {
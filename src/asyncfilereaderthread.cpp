@@ -0,0 +1,546 @@
+#include "asyncfilereaderthread.h"
+#include "logger.h"
+#include "tracer.h"
+#include <QFile>
+#include <QMutexLocker>
+#include <QSocketNotifier>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef WORDPULSE_HAVE_URING
+#include <liburing.h>
+#include <sys/eventfd.h>
+#endif
+
+namespace {
+
+qint64 alignUp(qint64 value)
+{
+    const qint64 align = AsyncFileReaderThread::kAlignment;
+    return qMax(align, (value + align - 1) / align * align);
+}
+
+void freeArena(char* arena)
+{
+    ::operator delete[](arena, std::align_val_t(AsyncFileReaderThread::kAlignment));
+}
+
+QString errnoString(qint64 error)
+{
+    return QString::fromLocal8Bit(std::strerror(static_cast<int>(error)));
+}
+
+} // namespace
+
+struct AsyncFileReaderThread::Uring {
+#ifdef WORDPULSE_HAVE_URING
+    io_uring ring;
+    bool initialized = false;
+    int eventFd = -1;
+    qint32 pending = 0;     // отправлено и ещё не получено
+
+    ~Uring()
+    {
+        if (initialized)
+            io_uring_queue_exit(&ring);
+        if (eventFd >= 0)
+            ::close(eventFd);
+    }
+
+    // nullptr - io_uring нет (старое ядро, seccomp в контейнере), читаем pread
+    static std::unique_ptr<Uring> create(unsigned entries, QString& why)
+    {
+        auto uring = std::make_unique<Uring>();
+        const int rc = io_uring_queue_init(entries, &uring->ring, 0);
+        if (rc < 0) {
+            why = errnoString(-rc);
+            return nullptr;
+        }
+        uring->initialized = true;
+        uring->eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (uring->eventFd < 0 || io_uring_register_eventfd(&uring->ring, uring->eventFd) < 0) {
+            why = "eventfd: " + errnoString(errno);
+            return nullptr;
+        }
+        return uring;
+    }
+#endif
+};
+
+AsyncFileReaderThread::AsyncFileReaderThread(const QString& filePath, const Config& config, QObject* parent)
+    : QThread{parent}, RingDataProvider(config.max_chunks_in_mem_num),
+      _filePath(filePath), _startPos(0), _config(config), _separators(config.word_separators),
+      _fd(-1), _direct(false), _uring(false), _fileSize(0), _nextOffset(0), _skipBytes(0), _running(false),
+      _reserveBytes(alignUp(config.chunk_size_bytes)), _dataBytes(_reserveBytes),
+      // В очереди, у анализаторов и в полёте одновременно
+      _bufferCount(config.max_chunks_in_mem_num + config.analyzer_threads + config.io_depth),
+      _arena(nullptr, &freeArena), _waitingForBuffer(false)
+{
+    _ioPool = new QThreadPool(this);
+    _ioPool->setMaxThreadCount(config.io_depth);
+
+    this->moveToThread(this);
+}
+
+AsyncFileReaderThread::~AsyncFileReaderThread()
+{
+    qInfo() << "AsyncFileReaderThread is being destroyed";
+    stopIo();
+    if (isRunning()) {
+        quit();
+        if (!wait(3000)) {
+            qCritical() << "AsyncFileReaderThread did not stop gracefully, terminating.";
+            terminate();
+        }
+    }
+    closeFile();
+}
+
+bool AsyncFileReaderThread::isSupported()
+{
+#ifdef Q_OS_UNIX
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AsyncFileReaderThread::setFilePath(const QString& filePath)
+{
+    _filePath = filePath;
+}
+
+void AsyncFileReaderThread::setStartPos(qint64 pos)
+{
+    _startPos = pos;
+}
+
+QString AsyncFileReaderThread::backendName() const
+{
+    return QString(_uring ? "io_uring" : "pread") + (_direct ? "+O_DIRECT" : "");
+}
+
+char* AsyncFileReaderThread::dataOf(qint32 index) const
+{
+    return _arena.get() + index * (_reserveBytes + _dataBytes) + _reserveBytes;
+}
+
+void AsyncFileReaderThread::releaseDataBlock(QByteArrayView block)
+{
+    // Блок лежит внутри своего буфера: номер - по адресу, без поиска
+    const quintptr arena = reinterpret_cast<quintptr>(_arena.get());
+    const quintptr address = reinterpret_cast<quintptr>(block.data());
+    const qint64 index = arena && address >= arena
+                             ? static_cast<qint64>((address - arena) / static_cast<quintptr>(_reserveBytes + _dataBytes))
+                             : -1;
+    if (index < 0 || index >= _bufferCount) {
+        // Блок с длинным словом, собранный в куче: его буфер уже свободен
+        QMutexLocker locker(&_heapMutex);
+        if (!_heapBlocks.remove(block.data()))
+            qWarning() << "Released block does not belong to any buffer";
+        return;
+    }
+    // Ячеек в кольце не меньше, чем буферов: место есть всегда
+    _freeBuffers->tryPush(static_cast<qint32>(index));
+
+    // Пара к submitReads: либо читатель увидит буфер, либо мы - его флаг
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_waitingForBuffer.load() && _waitingForBuffer.exchange(false))
+        triggerRead();
+}
+
+void AsyncFileReaderThread::onSpaceFreed()
+{
+    triggerRead();
+}
+
+void AsyncFileReaderThread::triggerRead()
+{
+    QMetaObject::invokeMethod(this, &AsyncFileReaderThread::readChunk, Qt::QueuedConnection);
+}
+
+void AsyncFileReaderThread::run()
+{
+    exec();
+}
+
+bool AsyncFileReaderThread::openFile(QString& error)
+{
+#ifdef Q_OS_UNIX
+    const QByteArray path = QFile::encodeName(_filePath);
+    _direct = false;
+    if (_config.direct_io) {
+#if defined(O_DIRECT)
+        _fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+        _direct = _fd >= 0;
+#elif defined(F_NOCACHE)
+        _fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC);
+        _direct = _fd >= 0 && fcntl(_fd, F_NOCACHE, 1) == 0;
+#endif
+        // tmpfs и часть FUSE не умеют O_DIRECT (EINVAL)
+        if (!_direct)
+            qWarning() << "direct_io is not available for" << _filePath << "- reading through the page cache";
+    }
+    if (_fd < 0)
+        _fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC);
+    if (_fd < 0) {
+        error = "Failed to open file: " + _filePath + ": " + errnoString(errno);
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(_fd, &st) != 0) {
+        error = "Failed to stat file: " + _filePath + ": " + errnoString(errno);
+        closeFile();
+        return false;
+    }
+    _fileSize = static_cast<qint64>(st.st_size);
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (!_direct)
+        ::posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+#ifdef WORDPULSE_HAVE_URING
+    if (!_ring) {
+        QString why;
+        _ring = Uring::create(static_cast<unsigned>(qMax(2, _config.io_depth)), why);
+        if (_ring) {
+            auto* notifier = new QSocketNotifier(_ring->eventFd, QSocketNotifier::Read, this);
+            connect(notifier, &QSocketNotifier::activated, this, &AsyncFileReaderThread::onUringEvent);
+        } else {
+            qInfo() << "io_uring is not available (" << why << "), reading with pread";
+        }
+    }
+    _uring = _ring != nullptr;
+#endif
+    return true;
+#else
+    error = "read_backend \"async\" needs a Unix system";
+    return false;
+#endif
+}
+
+void AsyncFileReaderThread::closeFile()
+{
+#ifdef Q_OS_UNIX
+    if (_fd >= 0)
+        ::close(_fd);
+#endif
+    _fd = -1;
+}
+
+void AsyncFileReaderThread::startReading()
+{
+    if (_running) {
+        qWarning() << "Attempt to start reading while already running.";
+        return;
+    }
+    stopIo();
+    closeFile();
+
+    QString error;
+    if (!openFile(error)) {
+        qCritical() << error;
+        emit readingError(error);
+        return;
+    }
+
+    if (!_arena) {
+        const size_t bytes = static_cast<size_t>(_bufferCount * (_reserveBytes + _dataBytes));
+        _arena.reset(static_cast<char*>(::operator new[](bytes, std::align_val_t(kAlignment))));
+        _slots = std::make_unique<Slot[]>(static_cast<size_t>(_bufferCount));
+        _freeBuffers = std::make_unique<BlockRing<qint32, false>>(_bufferCount);
+    }
+    qint32 index = 0;
+    while (_freeBuffers->tryPop(index)) {}
+    for (index = 0; index < _bufferCount; ++index) {
+        _slots[index].done = 0;
+        _freeBuffers->tryPush(index);
+    }
+    _inFlight.clear();
+    _carry.clear();
+    _waitingForBuffer = false;
+
+    const qint64 start = qBound<qint64>(0, _startPos, _fileSize);
+    _nextOffset = start / kAlignment * kAlignment;
+    _skipBytes = start - _nextOffset;
+    _running = true;
+    reopenData();
+
+    qInfo() << "Reading" << _filePath << "with" << backendName() << "," << _config.io_depth << "reads in flight";
+    emit totalSizeChanged(static_cast<quint64>(_fileSize));
+    triggerRead();
+}
+
+void AsyncFileReaderThread::cancelReading()
+{
+    qInfo() << "Canceling reading operation.";
+    _running = false;
+    stopIo();
+
+    // Блоки, которые уже разбирают анализаторы, вернут свои буферы сами
+    QByteArrayView blocks[8];
+    qsizetype sizeBefore = 0;
+    while (const qsizetype taken = takeDataBlocks(blocks, 8, sizeBefore)) {
+        for (qsizetype i = 0; i < taken; ++i)
+            releaseDataBlock(blocks[i]);
+    }
+    for (qint32 index : _inFlight)
+        _freeBuffers->tryPush(index);
+    _inFlight.clear();
+    _carry.clear();
+    closeData();
+    closeFile();
+}
+
+void AsyncFileReaderThread::readChunk()
+{
+    if (!_running)
+        return;
+
+    TraceSpan span("readChunk", "offset", _nextOffset);
+    try {
+        processReady();
+        if (!_running)
+            return;
+        submitReads();
+
+        if (_inFlight.empty() && _nextOffset >= _fileSize) {
+            _running = false;
+            qInfo() << "File reading completed (EOF reached).";
+            closeData();
+            closeFile();
+            emit readingFinished();
+        }
+    } catch (const std::exception& e) {
+        fail(QString("Exception in readChunk:") + e.what());
+    }
+}
+
+void AsyncFileReaderThread::submitReads()
+{
+    while (static_cast<qint32>(_inFlight.size()) < _config.io_depth && _nextOffset < _fileSize) {
+        qint32 index = 0;
+        if (!_freeBuffers->tryPop(index)) {
+            // Все буферы в очереди и у анализаторов: продолжит releaseDataBlock
+            _waitingForBuffer = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!_freeBuffers->tryPop(index)) {
+                markProducerStalled();
+                return;
+            }
+            _waitingForBuffer = false;
+        }
+
+        Slot& slot = _slots[index];
+#ifdef POSIX_FADV_DONTNEED
+        // Прошлое содержимое буфера разобрано: его страницы в кэше больше никому не нужны
+        if (!_direct && slot.done > 0)
+            ::posix_fadvise(_fd, slot.offset, slot.done, POSIX_FADV_DONTNEED);
+#endif
+        slot.offset = _nextOffset;
+        slot.done = 0;
+        slot.skip = _skipBytes;
+        slot.result.store(kPending, std::memory_order_relaxed);
+        _skipBytes = 0;
+        _nextOffset += _dataBytes;
+        _inFlight.push_back(index);
+        startRead(index);
+    }
+}
+
+void AsyncFileReaderThread::startRead(qint32 index)
+{
+    Slot& slot = _slots[index];
+    char* data = dataOf(index) + slot.done;
+    const qint64 offset = slot.offset + slot.done;
+    const qint64 length = _dataBytes - slot.done;
+
+#ifdef WORDPULSE_HAVE_URING
+    if (_uring) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&_ring->ring);
+        // В полёте не больше io_depth чтений, а в кольце столько же мест
+        Q_ASSERT(sqe);
+        io_uring_prep_read(sqe, _fd, data, static_cast<unsigned>(length), static_cast<quint64>(offset));
+        sqe->user_data = static_cast<quint64>(index);
+        const int rc = io_uring_submit(&_ring->ring);
+        if (rc < 0) {
+            slot.result.store(rc, std::memory_order_release);
+            triggerRead();
+            return;
+        }
+        ++_ring->pending;
+        return;
+    }
+#endif
+
+#ifdef Q_OS_UNIX
+    const int fd = _fd;
+    const qint64 fileSize = _fileSize;
+    _ioPool->start([this, &slot, fd, data, offset, length, fileSize]() {
+        TraceSpan readSpan("pread", "bytes", length);
+        qint64 total = 0;
+        qint64 result = 0;
+        // Короткий ответ бывает только у конца файла; с O_DIRECT дальше конца читать нельзя (EINVAL)
+        while (total < length && offset + total < fileSize) {
+            const ssize_t n = ::pread(fd, data + total, static_cast<size_t>(length - total), offset + total);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0) {
+                result = -errno;
+                break;
+            }
+            if (n == 0)
+                break;
+            total += n;
+        }
+        slot.result.store(result < 0 ? result : slot.done + total, std::memory_order_release);
+        triggerRead();
+    });
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(offset);
+    Q_UNUSED(length);
+#endif
+}
+
+void AsyncFileReaderThread::onUringEvent()
+{
+#ifdef WORDPULSE_HAVE_URING
+    eventfd_t value = 0;
+    eventfd_read(_ring->eventFd, &value);
+
+    io_uring_cqe* cqe = nullptr;
+    while (io_uring_peek_cqe(&_ring->ring, &cqe) == 0) {
+        const qint32 index = static_cast<qint32>(cqe->user_data);
+        const int res = cqe->res;
+        io_uring_cqe_seen(&_ring->ring, cqe);
+        --_ring->pending;
+
+        Slot& slot = _slots[index];
+        if (res < 0) {
+            slot.result.store(res, std::memory_order_release);
+            continue;
+        }
+        slot.done += res;
+        // io_uring вправе вернуть меньше запрошенного и не у конца файла: дочитываем остаток
+        if (res > 0 && _running && slot.done < _dataBytes && slot.offset + slot.done < _fileSize) {
+            startRead(index);
+            continue;
+        }
+        slot.result.store(slot.done, std::memory_order_release);
+    }
+    readChunk();
+#endif
+}
+
+void AsyncFileReaderThread::processReady()
+{
+    while (_running && !_inFlight.empty()) {
+        const qint32 index = _inFlight.front();
+        Slot& slot = _slots[index];
+        const qint64 result = slot.result.load(std::memory_order_acquire);
+        if (result == kPending)
+            return;
+        if (result < 0) {
+            fail("Read failed: " + _filePath + ": " + errnoString(-result));
+            return;
+        }
+        // При полной очереди разбор продолжит onSpaceFreed()
+        if (!waitForSpace(_config.max_chunks_in_mem_num))
+            return;
+        _inFlight.pop_front();
+        slot.done = result;
+
+        // Всё, что за концом файла на момент открытия, не читаем: файл мог вырасти
+        const qint64 available = qMin(result, _fileSize - slot.offset);
+        const bool last = slot.offset + available >= _fileSize || available < _dataBytes;
+        const qint64 skip = qMin(slot.skip, available);
+
+        // Хвост прошлого блока встаёт вплотную перед данными, в запас буфера.
+        // Не влез (слово длиннее запаса) - блок собирается в куче, буфер сразу свободен
+        const qint64 data = available - skip;
+        QByteArray joined;
+        char* begin = nullptr;
+        qint64 length = 0;
+        const bool onHeap = _carry.size() > _reserveBytes + skip;
+        if (!onHeap) {
+            begin = dataOf(index) + skip - _carry.size();
+            if (!_carry.isEmpty())
+                std::memcpy(begin, _carry.constData(), static_cast<size_t>(_carry.size()));
+            length = _carry.size() + data;
+        } else {
+            joined = std::move(_carry);
+            joined.append(dataOf(index) + skip, data);
+            begin = joined.data();
+            length = joined.size();
+            _freeBuffers->tryPush(index);
+        }
+        _carry.clear();
+
+        if (!last) {
+            qsizetype cutPos = -1;
+            {
+                TraceSpan boundarySpan("findBoundary", "bytes", length);
+                cutPos = _separators.findLast(QByteArrayView(begin, length));
+            }
+            if (cutPos >= 0) {
+                _carry = QByteArray(begin + cutPos + 1, length - cutPos - 1);
+                length = cutPos + 1;
+            } else {
+                // Разделителя нет во всём буфере: слово продолжается в следующем
+                if (onHeap)
+                    _carry = std::move(joined);
+                else
+                    _carry = QByteArray(begin, length);
+                length = 0;
+            }
+        }
+
+        if (length == 0) {
+            if (!onHeap)
+                _freeBuffers->tryPush(index);
+            continue;
+        }
+        if (onHeap) {
+            joined.truncate(length);
+            QMutexLocker locker(&_heapMutex);
+            _heapBlocks.insert(joined.constData(), joined);
+        }
+        // Место проверено waitForSpace, а производитель у кольца один - этот поток
+        pushDataBlock(QByteArrayView(onHeap ? joined.constData() : begin, length));
+        qCDebug(lcPipeline) << dataSize() << " blocks in ring";
+        emit chunkIsReady();
+    }
+}
+
+void AsyncFileReaderThread::fail(const QString& error)
+{
+    qCritical() << error;
+    _running = false;
+    closeData();
+    emit readingError(error);
+}
+
+void AsyncFileReaderThread::stopIo()
+{
+    _ioPool->waitForDone();
+#ifdef WORDPULSE_HAVE_URING
+    // Буферы и файл нельзя трогать, пока в них пишет ядро
+    while (_ring && _ring->pending > 0) {
+        io_uring_cqe* cqe = nullptr;
+        if (io_uring_wait_cqe(&_ring->ring, &cqe) < 0)
+            break;
+        io_uring_cqe_seen(&_ring->ring, cqe);
+        --_ring->pending;
+    }
+#endif
+}
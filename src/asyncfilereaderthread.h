@@ -0,0 +1,122 @@
+#ifndef ASYNCFILEREADERTHREAD_H
+#define ASYNCFILEREADERTHREAD_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QThreadPool>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include "config.h"
+#include "ringdataprovider.h"
+#include "byteclassifier.h"
+#include "blockring.h"
+
+// Источник блоков одного файла без отображения в память (read_backend = "async").
+// Файл читается в кольцо выровненных буферов, io_depth запросов одновременно:
+// через io_uring, если он собран (liburing) и его пускает ядро, иначе pread в пуле
+// потоков. Отображение окон на холодных данных упирается в page fault'ы по одному
+// на страницу, а однократный проход по файлу больше памяти вытесняет из page cache
+// всё остальное. С direct_io файл открывается с O_DIRECT и в кэш не попадает,
+// без него страницы буфера отдаются системе (POSIX_FADV_DONTNEED) перед его
+// следующим чтением.
+// Буфер - один блок очереди. Блок режется по последнему разделителю, хвост
+// копируется в запас перед данными следующего буфера, так что слово на стыке
+// остаётся целым. Запас равен chunk_size_bytes; хвост длиннее (слово больше
+// буфера) копится в куче, и блок с ним собирается там же.
+// Ответы приходят в любом порядке, но разбираются строго по порядку смещений.
+class AsyncFileReaderThread : public QThread, public RingDataProvider
+{
+    Q_OBJECT
+public:
+    AsyncFileReaderThread(const QString& filePath, const Config& config, QObject* parent = nullptr);
+    ~AsyncFileReaderThread();
+
+    // Нужны pread и open(2); на остальных платформах читает FileReaderThread
+    static bool isSupported();
+
+    void setFilePath(const QString& filePath);
+    // С какого байта начнёт следующий startReading (продолжение с контрольной точки)
+    void setStartPos(qint64 pos);
+    // Чем читал последний startReading: "io_uring" или "pread", с "+O_DIRECT", если он включился
+    QString backendName() const;
+
+    void releaseDataBlock(QByteArrayView block) override;
+
+    static constexpr qint64 kAlignment = 4096;
+
+public slots:
+    void startReading();
+    void cancelReading();
+    void readChunk();
+
+signals:
+    void chunkIsReady();
+    void readingFinished();
+    void readingError(const QString& error);
+    void totalSizeChanged(quint64 totalSize);
+
+protected:
+    void run() override;
+    void onSpaceFreed() override;
+
+private:
+    static constexpr qint64 kPending = -(1LL << 62);
+
+    // Буфер: [запас под хвост прошлого блока][данные]; обе части кратны kAlignment
+    struct Slot {
+        qint64 offset = 0;          // откуда читаются данные, кратно kAlignment
+        qint64 done = 0;            // сколько уже прочитано (io_uring может вернуть меньше)
+        qint64 skip = 0;            // сколько байт в начале данных до startPos
+        std::atomic<qint64> result{kPending};   // байт прочитано или -errno
+    };
+
+    void triggerRead();
+    bool openFile(QString& error);
+    void closeFile();
+    void submitReads();
+    void startRead(qint32 index);
+    void processReady();
+    void fail(const QString& error);
+    void stopIo();
+    char* dataOf(qint32 index) const;
+    void onUringEvent();
+
+    QString _filePath;
+    qint64 _startPos;
+    const Config& _config;
+    ByteClassifier _separators;
+
+    int _fd;
+    bool _direct;
+    bool _uring;
+    qint64 _fileSize;
+    qint64 _nextOffset;
+    qint64 _skipBytes;          // startPos не кратен kAlignment: столько пропустить в первом буфере
+    bool _running;
+
+    qint64 _reserveBytes;
+    qint64 _dataBytes;
+    qint32 _bufferCount;
+    std::unique_ptr<char, void (*)(char*)> _arena;
+    std::unique_ptr<Slot[]> _slots;
+    // Освобождают анализаторы, забирает поток читателя
+    std::unique_ptr<BlockRing<qint32, false>> _freeBuffers;
+    std::atomic<bool> _waitingForBuffer;
+
+    std::deque<qint32> _inFlight;   // в порядке смещений: читаются или ждут разбора
+    QByteArray _carry;
+    // Блоки, собранные в куче из хвоста длиннее запаса; ключ - начало блока
+    QMutex _heapMutex;
+    QHash<const char*, QByteArray> _heapBlocks;
+
+    QThreadPool* _ioPool;
+
+    // io_uring: кольцо и eventfd, на котором его ответы будят поток читателя
+    struct Uring;
+    std::unique_ptr<Uring> _ring;
+};
+
+#endif // ASYNCFILEREADERTHREAD_H
@@ -1,27 +1,87 @@
 #include "blockanalyzerthread.h"
+#include "topnselector.h"
+#include "logger.h"
+#include "tracer.h"
+#include <QFile>
+#include <QMetaMethod>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
 
 BlockAnalyzerThread::BlockAnalyzerThread(const Config &config, IDataProvider* dataProvider_ptr, QObject *parent)
-    : QThread{parent}, _config(config)
+    : QThread{parent}, _config(config), _tokenizer(config),
+      _ngramSize(config.ngram_size), _interner(qMax(1, config.analyzer_threads) * 4), _stitcher(config.ngram_size)
 {
     this->_dataProvider_ptr = dataProvider_ptr;
-    _word.reserve(50);
 
     _totalSize = 0;
     _processed = 0;
+    _lastUpdateProcessed = kNoUpdate;
+    _topVersion = 0;
+    _selectedTopVersion = kNoUpdate;
+    _snapshot = std::make_shared<const TopWordsSnapshot>();
+    _lastProgress = kNoProgress;
+
+    _workerCount = qMax(1, config.analyzer_threads);
+    // Пачка не больше доли очереди на воркер, иначе один воркер выгребет всё
+    _batchSize = qBound(1, config.max_chunks_in_mem_num / _workerCount, static_cast<qint32>(kMaxBatch));
+    _activeWorkers = 0;
+    _stopWorkers = false;
+
+    // Один воркер считает прямо в потоке анализатора, шардировать незачем
+    const qint32 shardCount = _workerCount == 1 ? 1 : _workerCount * 4;
+    _shards.reserve(shardCount);
+    for (qint32 i = 0; i < shardCount; ++i) {
+        _shards.push_back(std::make_unique<WordShard>());
+        if (_config.window_mode != Config::WindowMode::None) {
+            const bool sliding = _config.window_mode == Config::WindowMode::Sliding;
+            const qint64 spanMs = 1000LL * (sliding ? _config.window_seconds : _config.decay_half_life_seconds);
+            _shards.back()->window = std::make_unique<WindowedCounts>(
+                sliding ? WindowedCounts::Mode::Sliding : WindowedCounts::Mode::Decay,
+                spanMs, _config.window_buckets, _config.top_n);
+        } else if (_config.approximate_counting) {
+            // Шарды делят слова по хешу, поэтому ёмкость тоже делится между ними
+            const qint32 capacity = qMax(_config.top_n, (_config.approx_capacity + shardCount - 1) / shardCount);
+            _shards.back()->heavyHitters = std::make_unique<SpaceSavingCounter>(
+                capacity, _config.approx_sketch_width, _config.approx_sketch_depth);
+        } else {
+            _shards.back()->candidates = std::make_unique<TopCandidates>(_config.top_n);
+        }
+    }
+
+    _windowClock.start();
+
+    _workerPool = new QThreadPool(this);
+    _workerPool->setMaxThreadCount(_workerCount);
 
     _update_timer = new QTimer(this);
     connect(_update_timer, &QTimer::timeout, this, &BlockAnalyzerThread::emitUpdate, Qt::QueuedConnection);
 
-    _regex.setPattern(config.string_pattern);
-    if (!_config.case_sensitive) {
-        _regex.setPatternOptions(QRegularExpression::NoPatternOption);
-    } else {
-        _regex.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
-    }
+    _checkpointActive = false;
+    _takenBytes = 0;
+    _checkpointEpoch = 0;
+    _unflushedBlocks[0] = 0;
+    _unflushedBlocks[1] = 0;
+    _resumeOffset = 0;
+    _checkpointWriting = false;
+    _checkpointPool = new QThreadPool(this);
+    _checkpointPool->setMaxThreadCount(1);
+    _checkpoint_timer = new QTimer(this);
+    connect(_checkpoint_timer, &QTimer::timeout, this, &BlockAnalyzerThread::saveCheckpoint, Qt::QueuedConnection);
+
+    _blocksAnalyzed = 0;
+    _bytesAnalyzed = 0;
+    _tokens = 0;
+    _busyNs = 0;
+    _processedAtStart = 0;
+    _metricsClock.start();
+    _metrics_timer = new QTimer(this);
+    connect(_metrics_timer, &QTimer::timeout, this, &BlockAnalyzerThread::emitMetrics, Qt::QueuedConnection);
 
     this->moveToThread(this);
 
-    qDebug() << "BlockAnalyzerThread initialized.";
+    qDebug() << "BlockAnalyzerThread initialized. Workers:" << _workerCount;
 }
 
 BlockAnalyzerThread::~BlockAnalyzerThread()
@@ -45,16 +105,19 @@ void BlockAnalyzerThread::analyzingFinishing(void)
     if (!_dataProvider_ptr)
         return;
 
-    while (true) {
-        _dataProvider_ptr->lock();
-        bool b = !_dataProvider_ptr->isDataEmpty();
-        _dataProvider_ptr->unlock();
-        if (b)
-            analyzeBlock();
-        else
-            break;
-    }
+    waitForWorkers();
+
+    // Дочищаем то, что воркеры не успели забрать
+    while (processBatch(_localCounts))
+        ;
 
+    emitUpdate();
+    emitPerFileTops();
+    if (_config.metrics_interval_ms > 0) {
+        _metrics_timer->stop();
+        emitMetrics();
+    }
+    finishCheckpoint();
     emit analyzisFinished();
 }
 
@@ -65,59 +128,75 @@ void BlockAnalyzerThread::analyzeBlock(void)
         return;
     }
 
-    QByteArrayView block;
-    try
-    {
-        {
-            _dataProvider_ptr->lock();
-            qsizetype size = _dataProvider_ptr->dataSize();
-            if (_dataProvider_ptr->isDataEmpty()) {
-                _dataProvider_ptr->unlock();
-                return;
-            }
-
-            block = _dataProvider_ptr->getDataBlock();
-            _dataProvider_ptr->unlock();
-            if (size >= _config.max_chunks_in_mem_num
-                && _dataProvider_ptr->dataSize() < _config.max_chunks_in_mem_num) {
-                qInfo() << "threshold block freed";
-                emit thresholdBlockFreed();
-            }
-        }
-        QRegularExpressionMatchIterator it = _regex.globalMatch(QString::fromUtf8(block));
-
-        while (it.hasNext())
-        {
-            QRegularExpressionMatch match = it.next();
-            if (!match.hasMatch())
-                continue;
-
-            if (_regex.patternOptions() == QRegularExpression::NoPatternOption) {
-                _word = match.captured(0).toLower();
-            }
-            else {
-                _word = match.captured(0);
-            }
-            if (_word.isEmpty())
-                continue;
-
-            quint64 &count = _totalWordsMap[_word];
-            quint64 oldCount = count;
-            ++count;
+    if (_workerCount > 1) {
+        scheduleWorker();
+        return;
+    }
 
-            if (oldCount > 0) {
-                _topWordsSet.erase({oldCount, _word});
-            }
+    processBatch(_localCounts);
+}
 
-            _topWordsSet.insert({count, _word});
+qsizetype BlockAnalyzerThread::processBatch(LocalCounts& localCounts)
+{
+    if (_stopWorkers)
+        return 0;
+
+    std::array<QByteArrayView, kMaxBatch> batch;
+    std::array<NgramStitcher::Link, kMaxBatch> links;
+    qint64 epoch = -1;
+    qsizetype sizeBefore = 0;
+    qsizetype taken;
+    if (_ngramSize > 1) {
+        // Номера блоков раздаются в том порядке, в каком их отдала очередь
+        QMutexLocker locker(&_takeMutex);
+        taken = _dataProvider_ptr->takeDataBlocks(batch.data(), _batchSize, sizeBefore);
+        for (qsizetype i = 0; i < taken; ++i)
+            links[i] = _stitcher.next(_dataProvider_ptr->blockSource(batch[i]));
+    } else if (_checkpointActive) {
+        // Очередь отдаёт блоки по порядку файла: байты выданных - граница для среза
+        QMutexLocker locker(&_takeMutex);
+        taken = _dataProvider_ptr->takeDataBlocks(batch.data(), _batchSize, sizeBefore);
+        for (qsizetype i = 0; i < taken; ++i)
+            _takenBytes += _dataProvider_ptr->blockInputBytes(batch[i]);
+        epoch = _checkpointEpoch;
+        _unflushedBlocks[epoch & 1].fetch_add(taken);
+    } else {
+        taken = _dataProvider_ptr->takeDataBlocks(batch.data(), _batchSize, sizeBefore);
+    }
+    if (!taken)
+        return 0;
+
+    // Глубину очереди читатель может подстраивать на ходу
+    qsizetype limit = _dataProvider_ptr->queueLimit();
+    if (limit <= 0)
+        limit = _config.max_chunks_in_mem_num;
+    if (sizeBefore >= limit && sizeBefore - taken < limit) {
+        qCDebug(lcPipeline) << "threshold block freed";
+        emit thresholdBlockFreed();
+    }
 
-            while (_topWordsSet.size() > static_cast<size_t>(_config.top_n) )
-            {
-                _topWordsSet.erase(_topWordsSet.begin());
-            }
-        }
+    for (qsizetype i = 0; i < taken; ++i)
+        processBlock(batch[i], links[i], epoch, localCounts);
+    return taken;
+}
 
-        _processed += block.size();
+void BlockAnalyzerThread::processBlock(QByteArrayView block, NgramStitcher::Link link, qint64 epoch,
+                                       LocalCounts& localCounts)
+{
+    TraceSpan span("analyzeBlock", "bytes", block.size());
+    QElapsedTimer busy;
+    busy.start();
+    try
+    {
+        const quint64 tokens = _ngramSize > 1 ? countNgrams(block, link, localCounts)
+                                              : countBlock(block, localCounts);
+        if (_config.per_file_top)
+            countPerFile(block, localCounts);
+        flushCounts(localCounts, epoch);
+        _processed += _dataProvider_ptr->blockInputBytes(block);
+        _tokens.fetch_add(tokens, std::memory_order_relaxed);
+        _bytesAnalyzed.fetch_add(static_cast<quint64>(block.size()), std::memory_order_relaxed);
+        _blocksAnalyzed.fetch_add(1, std::memory_order_relaxed);
     }
     catch (const std::bad_alloc &e) {
          qCritical() << "bad alloc exception:" << e.what();
@@ -131,21 +210,292 @@ void BlockAnalyzerThread::analyzeBlock(void)
         qCritical() << "Unknown exception";
         emit analyzingError("Unknown exception");
     }
+
+    if (epoch >= 0)
+        _unflushedBlocks[epoch & 1].fetch_sub(1);
+    _dataProvider_ptr->releaseDataBlock(block);
+    _busyNs.fetch_add(busy.nsecsElapsed(), std::memory_order_relaxed);
+}
+
+quint64 BlockAnalyzerThread::countBlock(QByteArrayView block, LocalCounts& localCounts) const
+{
+    std::vector<WordCountTable>& tables = localCounts.tables;
+    tables.resize(_shards.size());
+    const size_t shardCount = tables.size();
+
+    TraceSpan span("tokenize");
+    quint64 tokens = 0;
+    _tokenizer.tokenize(block, [&tables, shardCount, &tokens](QByteArrayView word) {
+        const quint64 hash = WordCountTable::hash(word);
+        tables[shardIndex(hash, shardCount)].add(word, hash);
+        ++tokens;
+    });
+    return tokens;
+}
+
+quint64 BlockAnalyzerThread::countNgrams(QByteArrayView block, NgramStitcher::Link link, LocalCounts& localCounts)
+{
+    localCounts.tables.resize(_shards.size());
+    std::vector<quint32>& ids = localCounts.ids;
+    ids.clear();
+    {
+        TraceSpan span("tokenize");
+        WordCountTable& cache = localCounts.wordIds;
+        _tokenizer.tokenize(block, [this, &cache, &ids](QByteArrayView word) {
+            const quint64 hash = WordCountTable::hash(word);
+            quint64 id = cache.value(word, hash);
+            if (!id) {
+                if (cache.size() >= kWordIdCacheSize)
+                    cache.reset();
+                id = static_cast<quint64>(_interner.intern(word, hash)) + 1;
+                cache.add(word, hash, id);
+            }
+            ids.push_back(static_cast<quint32>(id - 1));
+        });
+    }
+
+    TraceSpan span("countNgrams");
+    const size_t n = static_cast<size_t>(_ngramSize);
+    for (size_t i = 0; i + n <= ids.size(); ++i)
+        addNgram(ids.data() + i, localCounts);
+
+    // Через стыки: начатые в прошлых блоках, в том числе ещё не досчитанных
+    std::vector<quint32>& crossing = localCounts.crossing;
+    crossing.clear();
+    _stitcher.stitch(link, ids, crossing);
+    for (size_t i = 0; i + n <= crossing.size(); i += n)
+        addNgram(crossing.data() + i, localCounts);
+    return ids.size();
+}
+
+void BlockAnalyzerThread::addNgram(const quint32* ids, LocalCounts& localCounts) const
+{
+    const QByteArrayView key(reinterpret_cast<const char*>(ids), _ngramSize * static_cast<qsizetype>(sizeof(quint32)));
+    const quint64 hash = WordCountTable::hash(key);
+    localCounts.tables[shardIndex(hash, localCounts.tables.size())].add(key, hash);
+}
+
+QString BlockAnalyzerThread::ngramText(QByteArrayView key) const
+{
+    QByteArray text;
+    for (qsizetype i = 0; i + static_cast<qsizetype>(sizeof(quint32)) <= key.size(); i += sizeof(quint32)) {
+        quint32 id;
+        std::memcpy(&id, key.data() + i, sizeof(id));
+        if (i)
+            text.append(' ');
+        text.append(_interner.word(id));
+    }
+    return QString::fromUtf8(text);
+}
+
+void BlockAnalyzerThread::flushCounts(LocalCounts& localCounts, qint64 epoch)
+{
+    TraceSpan span("mergeCounts");
+    bool topChanged = false;
+    for (size_t i = 0; i < localCounts.tables.size(); ++i) {
+        WordCountTable& local = localCounts.tables[i];
+        if (local.isEmpty())
+            continue;
+
+        WordShard& shard = *_shards[i];
+        QMutexLocker locker(&shard.mutex);
+        if (shard.window) {
+            const qint64 now = _windowClock.elapsed();
+            local.forEach([&shard, &topChanged, now](QByteArrayView word, quint64 hash, quint64 delta) {
+                if (shard.window->add(word, hash, delta, now))
+                    topChanged = true;
+            });
+        } else if (shard.heavyHitters) {
+            local.forEach([&shard](QByteArrayView word, quint64 hash, quint64 delta) {
+                shard.heavyHitters->add(word, hash, delta);
+            });
+            topChanged = true;
+        } else {
+            // Блок взят после среза, а шард ещё не скопирован: его прибавки в точку не идут
+            const bool afterCut = shard.checkpointPending && epoch == shard.checkpointEpoch;
+            local.forEach([&shard, &topChanged, afterCut](QByteArrayView word, quint64 hash, quint64 delta) {
+                if (afterCut)
+                    shard.checkpointAfter.add(word, hash, delta);
+                if (shard.candidates->update(word, hash, shard.totalWords.add(word, hash, delta)))
+                    topChanged = true;
+            });
+        }
+        locker.unlock();
+
+        local.reset();
+    }
+    if (topChanged)
+        _topVersion.fetch_add(1, std::memory_order_release);
+}
+
+void BlockAnalyzerThread::countPerFile(QByteArrayView block, const LocalCounts& localCounts)
+{
+    const qint32 source = _dataProvider_ptr->blockSource(block);
+    if (source < 0)
+        return;
+    const qint32 sourceBlocks = _dataProvider_ptr->sourceBlockCount(block);
+
+    std::shared_ptr<FileCounts> file;
+    {
+        QMutexLocker locker(&_perFileMutex);
+        std::shared_ptr<FileCounts>& entry = _perFile[source];
+        if (!entry)
+            entry = std::make_shared<FileCounts>();
+        file = entry;
+    }
+
+    QMutexLocker locker(&file->mutex);
+    WordCountTable& table = file->words;
+    for (const WordCountTable& local : localCounts.tables) {
+        local.forEach([&table](QByteArrayView word, quint64 hash, quint64 delta) {
+            table.add(word, hash, delta);
+        });
+    }
+    ++file->countedBlocks;
+    if (sourceBlocks)
+        file->totalBlocks = sourceBlocks;
+    if (!file->totalBlocks || file->countedBlocks < file->totalBlocks)
+        return;
+
+    // Все блоки файла посчитаны: его топ уходит сразу, а таблица освобождается
+    const WordCountTable words = std::move(file->words);
+    locker.unlock();
+    {
+        QMutexLocker mapLocker(&_perFileMutex);
+        _perFile.erase(source);
+    }
+    emitFileTop(source, words);
+}
+
+void BlockAnalyzerThread::emitFileTop(qint32 source, const WordCountTable& words)
+{
+    TopNSelector selector(_config.top_n);
+    if (_ngramSize > 1)
+        selector.setDecoder([this](QByteArrayView key) { return ngramText(key); });
+    words.forEach([&selector](QByteArrayView word, quint64, quint64 count) {
+        selector.offer(count, word);
+    });
+    emit fileTopWords(_dataProvider_ptr->sourceName(source), selector.takeAscending());
+}
+
+void BlockAnalyzerThread::emitPerFileTops(void)
+{
+    // Остались файлы, чей последний блок не дошёл (отмена, источник без sourceBlockCount)
+    std::unordered_map<qint32, std::shared_ptr<FileCounts>> perFile;
+    {
+        QMutexLocker locker(&_perFileMutex);
+        perFile.swap(_perFile);
+    }
+
+    std::vector<qint32> sources;
+    sources.reserve(perFile.size());
+    for (const auto& entry : perFile)
+        sources.push_back(entry.first);
+    std::sort(sources.begin(), sources.end());
+
+    for (qint32 source : sources)
+        emitFileTop(source, perFile[source]->words);
+}
+
+size_t BlockAnalyzerThread::shardIndex(quint64 hash, size_t shardCount) noexcept
+{
+    // Младшие биты хеша занимает сама таблица
+    return static_cast<size_t>(hash >> 32) % shardCount;
+}
+
+void BlockAnalyzerThread::scheduleWorker(void)
+{
+    qint32 active = _activeWorkers.load();
+    while (active < _workerCount) {
+        if (_activeWorkers.compare_exchange_weak(active, active + 1)) {
+            _workerPool->start([this]() { workerLoop(); });
+            return;
+        }
+    }
+}
+
+void BlockAnalyzerThread::workerLoop(void)
+{
+    LocalCounts localCounts;
+
+    while (true) {
+        while (processBatch(localCounts))
+            ;
+
+        _activeWorkers.fetch_sub(1);
+
+        // Блок мог прийти между последней проверкой очереди и уменьшением счётчика,
+        // а его chunkIsReady уже отработал при полном пуле. Заодно чуть ждём следующий блок,
+        // чтобы не отдавать поток пулу ради пары миллисекунд
+        bool hasData;
+        {
+            TraceSpan waitSpan("waitForData");
+            hasData = _dataProvider_ptr->waitForData(kWorkerLingerMs);
+        }
+        if (!hasData || _stopWorkers)
+            break;
+
+        if (_activeWorkers.fetch_add(1) >= _workerCount) {
+            _activeWorkers.fetch_sub(1);
+            break;
+        }
+    }
 }
 
-QVector<QPair<quint64, QString>> BlockAnalyzerThread::getTopWordsWithCount(void) const
+void BlockAnalyzerThread::waitForWorkers(void)
 {
-    QVector<QPair<quint64, QString>> result;
-    const size_t n = qMin(static_cast<size_t>(_config.top_n), _topWordsSet.size());
-    if (!n)
-        return result;
+    if (_workerPool)
+        _workerPool->waitForDone();
+}
 
-    result.reserve(n);
-    auto it = _topWordsSet.rbegin();
-    for (size_t i = 0; i < n; ++i, ++it) {
-        result.prepend({it->first, it->second});
+void BlockAnalyzerThread::clearShards(void)
+{
+    // Фоновая запись точки читает шарды
+    _checkpointPool->waitForDone();
+    for (auto& shard : _shards) {
+        QMutexLocker locker(&shard->mutex);
+        shard->totalWords.clear();
+        shard->checkpointPending = false;
+        shard->checkpointAfter.clear();
+        if (shard->candidates)
+            shard->candidates->clear();
+        if (shard->heavyHitters)
+            shard->heavyHitters->clear();
+        if (shard->window)
+            shard->window->clear();
     }
-    return result;
+
+    QMutexLocker locker(&_perFileMutex);
+    _perFile.clear();
+}
+
+QVector<QPair<quint64, QString>> BlockAnalyzerThread::getTopWordsWithCount(QVector<quint64>* errors) const
+{
+    TraceSpan span("selectTopN");
+    TopNSelector selector(_config.top_n);
+    if (_ngramSize > 1)
+        selector.setDecoder([this](QByteArrayView key) { return ngramText(key); });
+
+    for (const auto& shard : _shards) {
+        QMutexLocker locker(&shard->mutex);
+        if (shard->window) {
+            // Как и для точных счётчиков - только кандидаты шарда
+            shard->window->forEachTop([&selector](QByteArrayView word, quint64 count) {
+                selector.offer(count, word);
+            });
+        } else if (shard->heavyHitters) {
+            const auto entries = shard->heavyHitters->top(_config.top_n);
+            for (const SpaceSavingCounter::Entry& entry : entries)
+                selector.offer(entry.count, entry.word, entry.error);
+        } else {
+            // Топ шарда целиком среди его кандидатов, весь словарь обходить незачем
+            shard->candidates->forEach([&selector](QByteArrayView word, quint64 count) {
+                selector.offer(count, word);
+            });
+        }
+    }
+
+    return selector.takeAscending(errors);
 }
 
 void BlockAnalyzerThread::setTotalSize(quint64 totalSize)
@@ -160,8 +510,9 @@ void BlockAnalyzerThread::setProcessed(quint64 processed)
 
 void BlockAnalyzerThread::clearTops()
 {
-    _topWordsSet.clear();
-    _totalWordsMap.clear();
+    clearShards();
+    _lastUpdateProcessed = kNoUpdate;
+    resetSnapshot(true);
 }
 
 void BlockAnalyzerThread::cancelAnalyzis(void)
@@ -169,10 +520,37 @@ void BlockAnalyzerThread::cancelAnalyzis(void)
     qInfo() << "Analysis canceled.";
     if (_update_timer && _update_timer->isActive())
         _update_timer->stop();
+    if (_metrics_timer)
+        _metrics_timer->stop();
+
+    _stopWorkers = true;
+    waitForWorkers();
+    _stopWorkers = false;
+
+    if (_checkpointActive) {
+        // Отмена тоже сохраняет точку: следующий запуск продолжит с этого места
+        _checkpoint_timer->stop();
+        _checkpointPool->waitForDone();
+        QString error;
+        quint32 cutEpoch = 0;
+        std::shared_ptr<Checkpoint> checkpoint = snapshotCheckpoint(cutEpoch);
+        // Шарды обходим и без открытого файла: так с них снимается пометка среза
+        const bool opened = checkpoint->open(_config.checkpoint_path, &error);
+        appendShards(*checkpoint, cutEpoch);
+        if (opened)
+            checkpoint->commit(&error);
+        if (!error.isEmpty())
+            qWarning() << error;
+        _checkpointActive = false;
+    }
 
-    _topWordsSet.clear();
-    _totalWordsMap.clear();
+    clearShards();
+    _interner.clear();
+    _stitcher.clear();
+    _localCounts.wordIds.clear();
     _processed = 0;
+    _lastUpdateProcessed = kNoUpdate;
+    resetSnapshot(true);
 
     QMetaObject::invokeMethod(this, &BlockAnalyzerThread::emitUpdate, Qt::QueuedConnection);
 }
@@ -180,14 +558,243 @@ void BlockAnalyzerThread::cancelAnalyzis(void)
 void BlockAnalyzerThread::startAnalyzis(void)
 {
     qInfo() << "Analysis started.";
-    _topWordsSet.clear();
-    _totalWordsMap.clear();
+    waitForWorkers();
+    clearShards();
+    // Номера слов и порядок блоков сбрасываются только при стоящих воркерах:
+    // их кэши номеров живут до конца прохода
+    _interner.clear();
+    _stitcher.clear();
+    _localCounts.wordIds.clear();
     _processed = 0;
+    _lastUpdateProcessed = kNoUpdate;
+    resetSnapshot();
+    _windowClock.restart();
+
+    if (_checkpointActive) {
+        // Воркеры стоят, шарды пусты: раскладываем счётчики точки без блокировок
+        _resumeCounts.forEach([this](QByteArrayView word, quint64 hash, quint64 count) {
+            WordShard& shard = *_shards[shardIndex(hash, _shards.size())];
+            shard.candidates->update(word, hash, shard.totalWords.add(word, hash, count));
+        });
+        _resumeCounts.clear();
+        _processed = _resumeOffset;
+        _resumeOffset = 0;
+        _takenBytes = _processed;
+        _checkpoint_timer->start(_config.checkpoint_interval_ms);
+    }
+
+    resetMetrics();
+    if (_config.metrics_interval_ms > 0)
+        _metrics_timer->start(_config.metrics_interval_ms);
 
     if (_update_timer && !_update_timer->isActive())
         _update_timer->start(_config.update_interval_ms);
 }
 
+PipelineMetrics BlockAnalyzerThread::collectMetrics() const
+{
+    PipelineMetrics metrics;
+    metrics.elapsedMs = _metricsClock.elapsed();
+
+    if (_dataProvider_ptr) {
+        const IDataProvider::ProducerStats producer = _dataProvider_ptr->producerStats();
+        metrics.blocksRead = producer.blocks;
+        metrics.bytesRead = producer.bytes;
+        metrics.readerStalledMs = producer.stalledNs / 1000000;
+        metrics.queueDepth = _dataProvider_ptr->dataSize();
+        metrics.queueCapacity = _dataProvider_ptr->queueLimit();
+    }
+    if (metrics.queueCapacity <= 0)
+        metrics.queueCapacity = _config.max_chunks_in_mem_num;
+
+    metrics.blocksAnalyzed = _blocksAnalyzed.load(std::memory_order_relaxed);
+    metrics.bytesAnalyzed = _bytesAnalyzed.load(std::memory_order_relaxed);
+    metrics.tokens = _tokens.load(std::memory_order_relaxed);
+    metrics.analyzerThreads = _workerCount;
+    metrics.analyzerBusyMs = _busyNs.load(std::memory_order_relaxed) / 1000000;
+    // Воркер, который не считает блок, ждёт очередь: простой - это недополученное чтение
+    metrics.analyzerStarvedMs = qMax<qint64>(0, _workerCount * metrics.elapsedMs - metrics.analyzerBusyMs);
+
+    for (const auto& shard : _shards) {
+        QMutexLocker locker(&shard->mutex);
+        if (shard->window) {
+            metrics.tableWords += shard->window->size();
+            metrics.tableBytes += shard->window->memoryUsage();
+        } else if (shard->heavyHitters) {
+            metrics.tableWords += shard->heavyHitters->size();
+            metrics.tableBytes += shard->heavyHitters->memoryUsage();
+        } else {
+            metrics.tableWords += shard->totalWords.size();
+            metrics.tableBytes += shard->totalWords.memoryUsage() + shard->candidates->memoryUsage();
+        }
+    }
+    if (_ngramSize > 1)
+        metrics.tableBytes += _interner.memoryUsage();
+    return metrics;
+}
+
+void BlockAnalyzerThread::emitMetrics(void)
+{
+    PipelineMetrics metrics = collectMetrics();
+
+    const qint64 intervalMs = metrics.elapsedMs - _lastMetrics.elapsedMs;
+    if (intervalMs > 0) {
+        const double seconds = intervalMs / 1000.0;
+        metrics.readBytesPerSec = (metrics.bytesRead - _lastMetrics.bytesRead) / seconds;
+        metrics.analyzeBytesPerSec = (metrics.bytesAnalyzed - _lastMetrics.bytesAnalyzed) / seconds;
+        metrics.tokensPerSec = (metrics.tokens - _lastMetrics.tokens) / seconds;
+    }
+
+    // ETA - по средней скорости с начала: скорость за интервал слишком скачет.
+    // В режиме follow размер растёт, конца нет
+    const quint64 processed = _processed;
+    const quint64 done = processed > _processedAtStart ? processed - _processedAtStart : 0;
+    if (!_config.follow && _totalSize > 0) {
+        if (processed >= _totalSize)
+            metrics.etaMs = 0;
+        else if (done > 0 && metrics.elapsedMs > 0)
+            metrics.etaMs = static_cast<qint64>(static_cast<double>(_totalSize - processed)
+                                                * metrics.elapsedMs / static_cast<double>(done));
+    }
+
+    _lastMetrics = metrics;
+    emit metricsUpdated(metrics);
+}
+
+void BlockAnalyzerThread::resetMetrics(void)
+{
+    _blocksAnalyzed = 0;
+    _bytesAnalyzed = 0;
+    _tokens = 0;
+    _busyNs = 0;
+    _processedAtStart = _processed;
+    _lastMetrics = PipelineMetrics();
+    _metricsClock.restart();
+}
+
+quint64 BlockAnalyzerThread::prepareCheckpoint(const QString& inputPath)
+{
+    _checkpointActive = false;
+    _resumeCounts.clear();
+    _resumeOffset = 0;
+    if (_config.checkpoint_path.isEmpty())
+        return 0;
+    if (_config.window_mode != Config::WindowMode::None || _config.approximate_counting) {
+        qWarning() << "Checkpoints need exact counting, they are disabled";
+        return 0;
+    }
+    // Ключи n-грамм - номера слов, которые живут только в этом прогоне
+    if (_ngramSize > 1) {
+        qWarning() << "Checkpoints are not supported with ngram_size > 1, they are disabled";
+        return 0;
+    }
+
+    _checkpointIdentity = Checkpoint::identityOf(inputPath);
+    _checkpointActive = true;
+    if (!QFile::exists(_config.checkpoint_path))
+        return 0;
+
+    Checkpoint checkpoint;
+    WordCountTable counts;
+    QString error;
+    if (!checkpoint.load(_config.checkpoint_path, counts, &error)) {
+        qWarning() << error << "- starting from the beginning";
+        return 0;
+    }
+    if (!(checkpoint.identity == _checkpointIdentity) || checkpoint.configHash != Checkpoint::configHash(_config)
+        || checkpoint.offset > static_cast<quint64>(_checkpointIdentity.size)) {
+        qInfo() << "Checkpoint is for another file or other settings, starting from the beginning";
+        return 0;
+    }
+
+    qInfo() << "Resuming from checkpoint at byte" << checkpoint.offset << "with" << counts.size() << "words";
+    _resumeCounts = std::move(counts);
+    _resumeOffset = checkpoint.offset;
+    return _resumeOffset;
+}
+
+std::shared_ptr<Checkpoint> BlockAnalyzerThread::snapshotCheckpoint(quint32& cutEpoch)
+{
+    auto checkpoint = std::make_shared<Checkpoint>();
+    checkpoint->identity = _checkpointIdentity;
+    checkpoint->configHash = Checkpoint::configHash(_config);
+
+    // Пока держим _takeMutex, блоков не выдают: всё выданное - до среза, остальное - после
+    QMutexLocker locker(&_takeMutex);
+    checkpoint->offset = _takenBytes;
+    cutEpoch = ++_checkpointEpoch;
+    for (const auto& shard : _shards) {
+        QMutexLocker shardLocker(&shard->mutex);
+        shard->checkpointPending = true;
+        shard->checkpointEpoch = cutEpoch;
+    }
+    return checkpoint;
+}
+
+void BlockAnalyzerThread::appendShards(Checkpoint& checkpoint, quint32 cutEpoch)
+{
+    // Блоки до среза ещё досчитываются воркерами: их счётчики должны войти в точку
+    std::atomic<qint64>& before = _unflushedBlocks[(cutEpoch - 1) & 1];
+    while (before.load() > 0)
+        QThread::msleep(1);
+
+    for (const auto& shard : _shards) {
+        // Под блокировкой - только копия массива слотов; ключи в арене не двигаются
+        WordCountTable::Snapshot counts;
+        WordCountTable after;
+        {
+            QMutexLocker locker(&shard->mutex);
+            counts = shard->totalWords.snapshot();
+            std::swap(after, shard->checkpointAfter);
+            shard->checkpointPending = false;
+        }
+        counts.forEach([&checkpoint, &after](QByteArrayView word, quint64 hash, quint64 count) {
+            count -= after.value(word, hash);
+            if (count)
+                checkpoint.appendEntry(word, count);
+        });
+    }
+}
+
+void BlockAnalyzerThread::saveCheckpoint(void)
+{
+    // Прошлая точка ещё пишется: снимки не копятся в памяти, ждём следующего тика
+    if (!_checkpointActive || _checkpointWriting.load())
+        return;
+
+    // Воркеры не останавливаются: срез - это граница и пометка шардов
+    quint32 cutEpoch = 0;
+    std::shared_ptr<Checkpoint> checkpoint = snapshotCheckpoint(cutEpoch);
+    qDebug() << "Checkpoint cut at byte" << checkpoint->offset;
+
+    // Копия счётчиков и запись на диск - в фоне, анализ уже продолжается
+    _checkpointWriting = true;
+    const QString path = _config.checkpoint_path;
+    _checkpointPool->start([this, checkpoint, cutEpoch, path]() {
+        QString error;
+        const bool opened = checkpoint->open(path, &error);
+        appendShards(*checkpoint, cutEpoch);
+        if (opened)
+            checkpoint->commit(&error);
+        if (!error.isEmpty())
+            qWarning() << error;
+        _checkpointWriting = false;
+    });
+}
+
+void BlockAnalyzerThread::finishCheckpoint(void)
+{
+    if (!_checkpointActive)
+        return;
+
+    // Файл досчитан: точка больше не нужна, следующий запуск начнёт сначала
+    _checkpoint_timer->stop();
+    _checkpointPool->waitForDone();
+    _checkpointActive = false;
+    if (!QFile::remove(_config.checkpoint_path) && QFile::exists(_config.checkpoint_path))
+        qWarning() << "Cannot remove checkpoint" << _config.checkpoint_path;
+}
+
 void BlockAnalyzerThread::resumeAnalyzis(void)
 {
     qInfo() << "Analysis resumed.";
@@ -209,21 +816,120 @@ void BlockAnalyzerThread::run()
 
 void BlockAnalyzerThread::emitUpdate(void)
 {
+    TraceSpan span("emitUpdate");
     if (_totalSize == 0) {
-        if (_processed > 0)
+        if (_processed > 0 && _lastProgress != 0) {
+            _lastProgress = 0;
             emit progress(0);
+        }
         return;
     }
 
-    double ratio = static_cast<double>(_processed) / static_cast<double>(_totalSize);
-    quint8 progressPercent = static_cast<quint8>(qBound(0.0, ratio * 100.0, 100.0));
+    // Простой (например, в режиме follow без новых строк) не должен стоить пересчёта топа;
+    // окно пересчитывается без данных, только если оно сдвинулось
+    const bool windowMoved = advanceWindows();
+    const quint64 processed = _processed;
+    if (processed == _lastUpdateProcessed && !windowMoved)
+        return;
+    _lastUpdateProcessed = processed;
 
-    QVector<QPair<quint64, QString>> loc_topWords = getTopWordsWithCount();
+    double ratio = static_cast<double>(processed) / static_cast<double>(_totalSize);
+    quint8 progressPercent = static_cast<quint8>(qBound(0.0, ratio * 100.0, 100.0));
 
-    if (progressPercent == 100) {
-        qInfo() << "Analysis reached 100%";
+    if (progressPercent != _lastProgress) {
+        _lastProgress = progressPercent;
+        if (progressPercent == 100) {
+            qInfo() << "Analysis reached 100%";
+        }
+        emit progress(progressPercent);
     }
 
-    emit progress(progressPercent);
+    // Кандидаты в топ не менялись с прошлого отбора: отбирать нечего
+    const quint64 topVersion = _topVersion.load(std::memory_order_acquire);
+    if (topVersion == _selectedTopVersion)
+        return;
+    _selectedTopVersion = topVersion;
+
+    QVector<quint64> errors;
+    QVector<QPair<quint64, QString>> loc_topWords = getTopWordsWithCount(&errors);
+
+    // Байты пришли, а топ тот же: ни новой версии, ни сигналов
+    if (!publishSnapshot(loc_topWords, errors))
+        return;
+
     emit topWords(loc_topWords);
+    if (_config.approximate_counting)
+        emit topWordsErrorBounds(errors);
+    emit snapshotReady(latestSnapshot()->version);
+}
+
+bool BlockAnalyzerThread::advanceWindows(void)
+{
+    if (_config.window_mode == Config::WindowMode::None)
+        return false;
+
+    // Сдвиг без истёкших интервалов - сравнение номера интервала, окно не обходится
+    const qint64 now = _windowClock.elapsed();
+    bool moved = false;
+    for (const auto& shard : _shards) {
+        QMutexLocker locker(&shard->mutex);
+        if (shard->window->advance(now))
+            moved = true;
+    }
+    if (moved)
+        _topVersion.fetch_add(1, std::memory_order_release);
+    return moved;
+}
+
+TopWordsSnapshotPtr BlockAnalyzerThread::latestSnapshot() const
+{
+    QMutexLocker locker(&_snapshotMutex);
+    return _snapshot;
+}
+
+bool BlockAnalyzerThread::publishSnapshot(const TopWordsDiff::TopList& top, const QVector<quint64>& errors)
+{
+    const TopWordsSnapshotPtr previous = latestSnapshot();
+    if (previous->top == top && previous->errors == errors)
+        return false;
+
+    auto snapshot = std::make_shared<TopWordsSnapshot>();
+    snapshot->version = previous->version + 1;
+    snapshot->top = top;
+    snapshot->errors = errors;
+    // Разница нужна только GUI; CLI и тесты снимки не читают
+    static const QMetaMethod readySignal = QMetaMethod::fromSignal(&BlockAnalyzerThread::snapshotReady);
+    if (isSignalConnected(readySignal)) {
+        snapshot->diff = TopWordsDiff::compute(previous->top, top);
+        snapshot->diff.baseVersion = previous->version;
+        snapshot->diff.version = snapshot->version;
+    }
+
+    QMutexLocker locker(&_snapshotMutex);
+    _snapshot = std::move(snapshot);
+    return true;
+}
+
+void BlockAnalyzerThread::resetSnapshot(bool announce)
+{
+    // Новая версия пустого топа: читатель со старой версией сбросится, а не применит разницу
+    auto snapshot = std::make_shared<TopWordsSnapshot>();
+    const quint64 version = latestSnapshot()->version + 1;
+    snapshot->version = version;
+    snapshot->diff.version = version;
+
+    {
+        QMutexLocker locker(&_snapshotMutex);
+        _snapshot = std::move(snapshot);
+    }
+    _lastProgress = kNoProgress;
+    _selectedTopVersion = kNoUpdate;
+
+    if (!announce)
+        return;
+    // emitUpdate пустой топ не разошлёт: он совпадёт с пустым снимком
+    emit topWords({});
+    if (_config.approximate_counting)
+        emit topWordsErrorBounds({});
+    emit snapshotReady(version);
 }
@@ -8,7 +8,22 @@
 #include <QTimer>
 #include <QRegularExpression>
 #include <QMap>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
 #include "config.h"
+#include "wordtokenizer.h"
+#include "wordcounttable.h"
+#include "wordinterner.h"
+#include "ngramstitcher.h"
+#include "spacesaving.h"
+#include "topcandidates.h"
+#include "windowedcounts.h"
+#include "checkpoint.h"
+#include "pipelinemetrics.h"
+#include "topwordsdiff.h"
 #include "filereaderthread.h"
 /*#pragma push_macro("emit")
 #undef emit
@@ -25,6 +40,17 @@ public:
                                  QObject* parent = nullptr);
     ~BlockAnalyzerThread() override;
 
+    // Включает контрольные точки (config.checkpoint_path) для файла inputPath. Вызывать
+    // до startAnalyzis. Если на диске точка этого же файла с теми же настройками, её счётчики
+    // подхватит startAnalyzis, а возвращается байт, с которого читателю продолжить (иначе 0)
+    quint64 prepareCheckpoint(const QString& inputPath);
+
+    // Накопительные счётчики конвейера на сейчас; скорости и ETA считает только metricsUpdated
+    PipelineMetrics collectMetrics() const;
+
+    // Последний опубликованный топ, из любого потока. Никогда не nullptr
+    TopWordsSnapshotPtr latestSnapshot() const;
+
 public slots:
     void analyzingFinishing(void);
     void analyzeBlock(void);
@@ -42,25 +68,157 @@ signals:
     void thresholdBlockFreed();
     void blockProcessed(const QMap<QByteArray, int>& wordCount, qint64 bytesProcessed);
     void progress(quint8 progress);
+    // topWords и topWordsErrorBounds приходят, только когда топ изменился
     void topWords(const QVector<QPair<quint64, QString>>& list);
+    // Вышел снимок version; забирать через latestSnapshot(), к тому времени он может
+    // смениться более новым. Пока подключён, снимки несут TopWordsDiff от предыдущего
+    void snapshotReady(quint64 version);
+    // Только в режиме approximate_counting: погрешность count для каждой строки topWords
+    void topWordsErrorBounds(const QVector<quint64>& errors);
+    // per_file_top: по одному на каждый входной файл, как только посчитан последний его
+    // блок (из потока воркера); файлы, чей конец не дошёл, - в конце анализа
+    void fileTopWords(const QString& source, const QVector<QPair<quint64, QString>>& list);
+    // Раз в metrics_interval_ms и в конце анализа
+    void metricsUpdated(const PipelineMetrics& metrics);
 
 protected:
     void run() override;
 private:
+    // Часть общей таблицы счётчиков. Слово попадает в шард по старшим битам
+    // хеша, поэтому воркеры, сливающие локальные счётчики, редко ждут друг друга.
+    struct WordShard {
+        QMutex mutex;
+        WordCountTable totalWords;
+        std::unique_ptr<TopCandidates> candidates;          // возможный топ шарда из totalWords
+        std::unique_ptr<SpaceSavingCounter> heavyHitters;   // вместо totalWords в приближённом режиме
+        std::unique_ptr<WindowedCounts> window;             // вместо totalWords при window_mode
+        // Срез контрольной точки взят, а шард ещё не скопирован: блоки, взятые после
+        // среза (эпоха checkpointEpoch), копят свои прибавки ещё и здесь - точка их вычтет
+        bool checkpointPending = false;
+        quint32 checkpointEpoch = 0;
+        WordCountTable checkpointAfter;
+    };
+    // Состояние воркера между блоками
+    struct LocalCounts {
+        std::vector<WordCountTable> tables;     // по шардам
+        // Режим n-грамм
+        WordCountTable wordIds;                 // кэш номеров WordInterner: count = номер + 1
+        std::vector<quint32> ids;               // номера слов блока
+        std::vector<quint32> crossing;          // n-граммы через стыки от сшивателя
+    };
+
+    static constexpr qsizetype kMaxBatch = 8;
+    static constexpr qint32 kWorkerLingerMs = 2;
+    static constexpr quint64 kNoUpdate = ~quint64(0);
+    static constexpr quint8 kNoProgress = 0xFF;
+    // Кэш номеров у воркера сбрасывается, когда слов в нём больше
+    static constexpr qsizetype kWordIdCacheSize = 1 << 20;
+
     void emitUpdate(void);
-    QVector<QPair<quint64, QString>> getTopWordsWithCount(void) const;
+    // false - топ тот же, что в последнем снимке: новой версии нет
+    bool publishSnapshot(const TopWordsDiff::TopList& top, const QVector<quint64>& errors);
+    // announce - сразу разослать пустой топ (отмена, сброс по запросу)
+    void resetSnapshot(bool announce = false);
+    // window_mode: сдвигает окна шардов к текущему времени; true - какое-то сдвинулось
+    // и версия топа поднята
+    bool advanceWindows(void);
+    QVector<QPair<quint64, QString>> getTopWordsWithCount(QVector<quint64>* errors = nullptr) const;
 
-    QByteArrayView _block;
-    QString _word;
+    qsizetype processBatch(LocalCounts& localCounts);
+    // epoch - эпоха контрольных точек, в которой блок взят; -1 - точки выключены
+    void processBlock(QByteArrayView block, NgramStitcher::Link link, qint64 epoch, LocalCounts& localCounts);
+    // Возвращает число слов в блоке
+    quint64 countBlock(QByteArrayView block, LocalCounts& localCounts) const;
+    quint64 countNgrams(QByteArrayView block, NgramStitcher::Link link, LocalCounts& localCounts);
+    void addNgram(const quint32* ids, LocalCounts& localCounts) const;
+    // Ключ n-граммы - номера слов; для показа слова склеиваются через пробел
+    QString ngramText(QByteArrayView key) const;
+    void flushCounts(LocalCounts& localCounts, qint64 epoch = -1);
+    void countPerFile(QByteArrayView block, const LocalCounts& localCounts);
+    void emitFileTop(qint32 source, const WordCountTable& words);
+    void emitPerFileTops(void);
+    static size_t shardIndex(quint64 hash, size_t shardCount) noexcept;
+    void scheduleWorker(void);
+    void workerLoop(void);
+    void waitForWorkers(void);
+    void clearShards(void);
+    // Срез контрольной точки без остановки воркеров: граница - байты взятых блоков,
+    // взятые позже получают новую эпоху cutEpoch. Счётчики среза потом пишет appendShards
+    std::shared_ptr<Checkpoint> snapshotCheckpoint(quint32& cutEpoch);
+    // Ждёт блоки до среза, затем копирует слоты шардов по одному и пишет их вне блокировки
+    void appendShards(Checkpoint& checkpoint, quint32 cutEpoch);
+    void saveCheckpoint(void);
+    void finishCheckpoint(void);
+    void emitMetrics(void);
+    void resetMetrics(void);
 
     const Config& _config;
-    QRegularExpression _regex;
-    QMap<QString, quint64> _totalWordsMap;
-    std::set<QPair<quint64, QString>, std::less<QPair<quint64, QString>>> _topWordsSet;
+    WordTokenizer _tokenizer;
+    std::vector<std::unique_ptr<WordShard>> _shards;
     IDataProvider* _dataProvider_ptr;
+    // ngram_size > 1: ключи счётчиков - номера слов из _interner, блоки выдаются
+    // под _takeMutex, чтобы сшиватель знал их порядок
+    qint32 _ngramSize;
+    WordInterner _interner;
+    NgramStitcher _stitcher;
+    QMutex _takeMutex;
+    // Счётчики потока анализатора: один воркер и дочистка в analyzingFinishing.
+    // Между блоками живут таблицы и кэш номеров, чтобы не выделять их заново
+    LocalCounts _localCounts;
     quint64 _totalSize;
-    quint64 _processed;
+    std::atomic<quint64> _processed;
+    quint64 _lastUpdateProcessed;   // топ не пересчитывается, пока не пришли новые байты
+    // flushCounts поднимает версию, только если сменились кандидаты в топ;
+    // emitUpdate отбирает топ заново, лишь когда она ушла от отобранной
+    std::atomic<quint64> _topVersion;
+    quint64 _selectedTopVersion;
+    QElapsedTimer _windowClock;     // время для window_mode, отсчёт от startAnalyzis
+    // Пишет только поток анализатора, мьютекс - лишь на подмену указателя
+    mutable QMutex _snapshotMutex;
+    TopWordsSnapshotPtr _snapshot;
+    quint8 _lastProgress;
+
+    // per_file_top: точные счётчики файла, пока не досчитаны все его блоки.
+    // У каждого файла свой мьютекс; общий - только на поиск и удаление в _perFile
+    struct FileCounts {
+        QMutex mutex;
+        WordCountTable words;
+        qint32 countedBlocks = 0;
+        qint32 totalBlocks = 0;     // 0 - последний блок файла ещё не посчитан
+    };
+    std::unordered_map<qint32, std::shared_ptr<FileCounts>> _perFile;
+    QMutex _perFileMutex;
     QTimer* _update_timer;
+
+    // Контрольные точки: срез - граница под _takeMutex, счётчики копируются
+    // и пишутся в _checkpointPool, пока воркеры считают дальше
+    bool _checkpointActive;
+    quint64 _takenBytes;            // под _takeMutex: байты входа всех выданных блоков
+    quint32 _checkpointEpoch;       // под _takeMutex: эпоха, которую получают блоки
+    // Выданные и ещё не слитые блоки, по чётности эпохи: срез ждёт блоки своей прошлой эпохи
+    std::atomic<qint64> _unflushedBlocks[2];
+    Checkpoint::FileIdentity _checkpointIdentity;
+    WordCountTable _resumeCounts;   // счётчики из точки до startAnalyzis
+    quint64 _resumeOffset;
+    QTimer* _checkpoint_timer;
+    QThreadPool* _checkpointPool;
+    std::atomic<bool> _checkpointWriting;
+
+    // Метрики: счётчики пишут воркеры (relaxed), срез собирает emitMetrics
+    std::atomic<quint64> _blocksAnalyzed;
+    std::atomic<quint64> _bytesAnalyzed;
+    std::atomic<quint64> _tokens;
+    std::atomic<qint64> _busyNs;
+    QElapsedTimer _metricsClock;
+    quint64 _processedAtStart;      // с контрольной точки начинаем не с нуля
+    PipelineMetrics _lastMetrics;
+    QTimer* _metrics_timer;
+
+    qint32 _workerCount;
+    qint32 _batchSize;
+    QThreadPool* _workerPool;
+    std::atomic<qint32> _activeWorkers;
+    std::atomic<bool> _stopWorkers;
 };
 
 #endif // BLOCKANALYZERTHREAD_H
@@ -0,0 +1,125 @@
+#ifndef BLOCKRING_H
+#define BLOCKRING_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <memory>
+
+// Ограниченная lock-free очередь на кольцевом буфере (схема Вьюкова:
+// у каждой ячейки свой счётчик sequence). Потребителей сколько угодно,
+// производитель по умолчанию один - тогда запись обходится без CAS.
+// Ёмкость округляется вверх до степени двойки.
+template <typename T, bool SingleProducer = true>
+class BlockRing
+{
+public:
+    explicit BlockRing(qsizetype capacity)
+    {
+        size_t size = 2;
+        while (size < static_cast<size_t>(qMax<qsizetype>(1, capacity)))
+            size *= 2;
+        _mask = size - 1;
+        _cells = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; ++i)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        _enqueuePos.value.store(0, std::memory_order_relaxed);
+        _dequeuePos.value.store(0, std::memory_order_relaxed);
+    }
+
+    BlockRing(const BlockRing&) = delete;
+    BlockRing& operator=(const BlockRing&) = delete;
+
+    // false - кольцо заполнено
+    bool tryPush(const T& value)
+    {
+        size_t pos = _enqueuePos.value.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &_cells[pos & _mask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+            if (diff == 0) {
+                if constexpr (SingleProducer) {
+                    _enqueuePos.value.store(pos + 1, std::memory_order_relaxed);
+                    break;
+                } else {
+                    if (_enqueuePos.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _enqueuePos.value.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Забирает до max подряд готовых элементов одним CAS, возвращает сколько забрал
+    qsizetype tryPopBatch(T* out, qsizetype max)
+    {
+        const size_t limit = qMin(static_cast<size_t>(qMax<qsizetype>(0, max)), _mask + 1);
+        size_t pos = _dequeuePos.value.load(std::memory_order_relaxed);
+        while (limit) {
+            size_t n = 0;
+            while (n < limit
+                   && _cells[(pos + n) & _mask].sequence.load(std::memory_order_acquire) == pos + n + 1)
+                ++n;
+
+            if (!n) {
+                const size_t seq = _cells[pos & _mask].sequence.load(std::memory_order_acquire);
+                if (static_cast<std::ptrdiff_t>(seq - (pos + 1)) < 0)
+                    return 0;
+                // Другой потребитель успел раньше
+                pos = _dequeuePos.value.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (_dequeuePos.value.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < n; ++i) {
+                    Cell& cell = _cells[(pos + i) & _mask];
+                    out[i] = cell.value;
+                    cell.sequence.store(pos + i + _mask + 1, std::memory_order_release);
+                }
+                return static_cast<qsizetype>(n);
+            }
+        }
+        return 0;
+    }
+
+    bool tryPop(T& value) { return tryPopBatch(&value, 1) == 1; }
+
+    // Оценка: при параллельной работе может отставать на несколько элементов
+    qsizetype size() const noexcept
+    {
+        const size_t dequeued = _dequeuePos.value.load(std::memory_order_relaxed);
+        const size_t enqueued = _enqueuePos.value.load(std::memory_order_relaxed);
+        const auto diff = static_cast<std::ptrdiff_t>(enqueued - dequeued);
+        return static_cast<qsizetype>(qBound<std::ptrdiff_t>(0, diff, static_cast<std::ptrdiff_t>(_mask + 1)));
+    }
+
+    bool isEmpty() const noexcept { return size() == 0; }
+    qsizetype capacity() const noexcept { return static_cast<qsizetype>(_mask + 1); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value{};
+    };
+
+    // Позиции производителя и потребителей на разных кэш-линиях
+    struct PaddedPos {
+        std::atomic<size_t> value;
+        char pad[64 - sizeof(std::atomic<size_t>)];
+    };
+
+    std::unique_ptr<Cell[]> _cells;
+    size_t _mask;
+    PaddedPos _enqueuePos;
+    PaddedPos _dequeuePos;
+};
+
+#endif // BLOCKRING_H
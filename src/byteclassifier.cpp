@@ -0,0 +1,273 @@
+#include "byteclassifier.h"
+#include <bit>
+#include <cstring>
+
+#if defined(Q_PROCESSOR_X86) && (defined(Q_CC_GNU) || defined(Q_CC_CLANG) || defined(Q_CC_MSVC))
+#  define WORDPULSE_X86_SIMD 1
+#  include <immintrin.h>
+#  if defined(Q_CC_MSVC) && !defined(Q_CC_CLANG)
+#    define WORDPULSE_MSVC_CPUID 1
+#    include <intrin.h>
+#    define WORDPULSE_TARGET(x)
+#  else
+#    define WORDPULSE_TARGET(x) __attribute__((target(x)))
+#  endif
+#endif
+
+namespace {
+
+using MaskFn = quint64 (*)(const std::array<bool, 256>&, const ByteClassifier::Tables&, const uchar*);
+
+quint64 maskScalar(const std::array<bool, 256>& table, const ByteClassifier::Tables&, const uchar* p)
+{
+    quint64 mask = 0;
+    for (int i = 0; i < 64; ++i)
+        mask |= static_cast<quint64>(table[p[i]]) << i;
+    return mask;
+}
+
+#ifdef WORDPULSE_X86_SIMD
+
+// Поиск по битовой карте 16x16: младший полубайт выбирает строку через pshufb,
+// старший - бит в этой строке.
+WORDPULSE_TARGET("ssse3")
+quint32 mask16Ssse3(const ByteClassifier::Tables& t, const uchar* p)
+{
+    const __m128i lowNibble = _mm_set1_epi8(0x0F);
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                       1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i tableLow = _mm_load_si128(reinterpret_cast<const __m128i*>(t.low));
+    const __m128i tableHigh = _mm_load_si128(reinterpret_cast<const __m128i*>(t.high));
+
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i lo = _mm_and_si128(v, lowNibble);
+    const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), lowNibble);
+
+    const __m128i rowLow = _mm_shuffle_epi8(tableLow, lo);
+    const __m128i rowHigh = _mm_shuffle_epi8(tableHigh, lo);
+    const __m128i isLowHalf = _mm_cmplt_epi8(hi, _mm_set1_epi8(8));
+    const __m128i row = _mm_or_si128(_mm_and_si128(isLowHalf, rowLow),
+                                     _mm_andnot_si128(isLowHalf, rowHigh));
+    const __m128i hit = _mm_and_si128(row, _mm_shuffle_epi8(bits, hi));
+
+    const int miss = _mm_movemask_epi8(_mm_cmpeq_epi8(hit, _mm_setzero_si128()));
+    return static_cast<quint32>(~miss) & 0xFFFFu;
+}
+
+WORDPULSE_TARGET("ssse3")
+quint64 maskSsse3(const std::array<bool, 256>&, const ByteClassifier::Tables& t, const uchar* p)
+{
+    return static_cast<quint64>(mask16Ssse3(t, p))
+         | static_cast<quint64>(mask16Ssse3(t, p + 16)) << 16
+         | static_cast<quint64>(mask16Ssse3(t, p + 32)) << 32
+         | static_cast<quint64>(mask16Ssse3(t, p + 48)) << 48;
+}
+
+WORDPULSE_TARGET("avx2")
+quint32 mask32Avx2(const ByteClassifier::Tables& t, const uchar* p)
+{
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+    const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                          1, 2, 4, 8, 16, 32, 64, -128,
+                                          1, 2, 4, 8, 16, 32, 64, -128,
+                                          1, 2, 4, 8, 16, 32, 64, -128);
+    // vpshufb работает внутри 128-битных половин, поэтому таблицы дублируются
+    const __m256i tableLow = _mm256_broadcastsi128_si256(
+        _mm_load_si128(reinterpret_cast<const __m128i*>(t.low)));
+    const __m256i tableHigh = _mm256_broadcastsi128_si256(
+        _mm_load_si128(reinterpret_cast<const __m128i*>(t.high)));
+
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const __m256i lo = _mm256_and_si256(v, lowNibble);
+    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibble);
+
+    const __m256i rowLow = _mm256_shuffle_epi8(tableLow, lo);
+    const __m256i rowHigh = _mm256_shuffle_epi8(tableHigh, lo);
+    const __m256i isLowHalf = _mm256_cmpgt_epi8(_mm256_set1_epi8(8), hi);
+    const __m256i row = _mm256_blendv_epi8(rowHigh, rowLow, isLowHalf);
+    const __m256i hit = _mm256_and_si256(row, _mm256_shuffle_epi8(bits, hi));
+
+    const int miss = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hit, _mm256_setzero_si256()));
+    return ~static_cast<quint32>(miss);
+}
+
+WORDPULSE_TARGET("avx2")
+quint64 maskAvx2(const std::array<bool, 256>&, const ByteClassifier::Tables& t, const uchar* p)
+{
+    return static_cast<quint64>(mask32Avx2(t, p))
+         | static_cast<quint64>(mask32Avx2(t, p + 32)) << 32;
+}
+
+bool cpuHasSsse3()
+{
+#ifdef WORDPULSE_MSVC_CPUID
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+bool cpuHasAvx2()
+{
+#ifdef WORDPULSE_MSVC_CPUID
+    int info[4];
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // WORDPULSE_X86_SIMD
+
+MaskFn kernelFunction(ByteClassifier::Kernel kernel)
+{
+    switch (kernel) {
+#ifdef WORDPULSE_X86_SIMD
+    case ByteClassifier::Kernel::Avx2:
+        return maskAvx2;
+    case ByteClassifier::Kernel::Ssse3:
+        return maskSsse3;
+#endif
+    default:
+        return maskScalar;
+    }
+}
+
+ByteClassifier::Kernel detectKernel()
+{
+#ifdef WORDPULSE_X86_SIMD
+    if (cpuHasAvx2())
+        return ByteClassifier::Kernel::Avx2;
+    if (cpuHasSsse3())
+        return ByteClassifier::Kernel::Ssse3;
+#endif
+    return ByteClassifier::Kernel::Scalar;
+}
+
+struct KernelSlot {
+    ByteClassifier::Kernel kernel;
+    MaskFn fn;
+};
+
+KernelSlot& kernelSlot()
+{
+    static KernelSlot slot = [] {
+        const ByteClassifier::Kernel kernel = detectKernel();
+        return KernelSlot{kernel, kernelFunction(kernel)};
+    }();
+    return slot;
+}
+
+} // namespace
+
+ByteClassifier::ByteClassifier()
+{
+    _table.fill(false);
+    std::memset(&_nibbles, 0, sizeof(_nibbles));
+}
+
+ByteClassifier::ByteClassifier(const std::set<char>& bytes) : ByteClassifier()
+{
+    for (char c : bytes)
+        add(static_cast<uchar>(c));
+}
+
+void ByteClassifier::add(uchar byte) noexcept
+{
+    _table[byte] = true;
+    const uchar lo = static_cast<uchar>(byte & 0x0F);
+    const uchar hi = static_cast<uchar>(byte >> 4);
+    uchar* row = hi < 8 ? _nibbles.low : _nibbles.high;
+    row[lo] = static_cast<uchar>(row[lo] | (1u << (hi & 7)));
+}
+
+void ByteClassifier::addRange(uchar from, uchar to) noexcept
+{
+    for (int c = from; c <= to; ++c)
+        add(static_cast<uchar>(c));
+}
+
+quint64 ByteClassifier::mask64(const char* data, qsizetype len) const noexcept
+{
+    const uchar* p = reinterpret_cast<const uchar*>(data);
+    if (len >= 64)
+        return kernelSlot().fn(_table, _nibbles, p);
+
+    // Хвост короче 64 байт: добиваем нулями и отрезаем лишние биты
+    uchar tail[64] = {};
+    std::memcpy(tail, p, static_cast<size_t>(len));
+    const quint64 valid = (quint64(1) << len) - 1;
+    return kernelSlot().fn(_table, _nibbles, tail) & valid;
+}
+
+qsizetype ByteClassifier::findFirst(QByteArrayView data, qsizetype from) const noexcept
+{
+    for (qsizetype base = from; base < data.size(); base += 64) {
+        const quint64 mask = mask64(data.data() + base, qMin<qsizetype>(64, data.size() - base));
+        if (mask)
+            return base + std::countr_zero(mask);
+    }
+    return -1;
+}
+
+qsizetype ByteClassifier::findFirstNot(QByteArrayView data, qsizetype from) const noexcept
+{
+    for (qsizetype base = from; base < data.size(); base += 64) {
+        const qsizetype len = qMin<qsizetype>(64, data.size() - base);
+        const quint64 valid = len == 64 ? ~quint64(0) : (quint64(1) << len) - 1;
+        const quint64 mask = ~mask64(data.data() + base, len) & valid;
+        if (mask)
+            return base + std::countr_zero(mask);
+    }
+    return -1;
+}
+
+qsizetype ByteClassifier::findLast(QByteArrayView data) const noexcept
+{
+    qsizetype end = data.size();
+    while (end > 0) {
+        const qsizetype base = qMax<qsizetype>(0, end - 64);
+        const quint64 mask = mask64(data.data() + base, end - base);
+        if (mask)
+            return base + 63 - std::countl_zero(mask);
+        end = base;
+    }
+    return -1;
+}
+
+ByteClassifier::Kernel ByteClassifier::activeKernel() noexcept
+{
+    return kernelSlot().kernel;
+}
+
+bool ByteClassifier::isKernelSupported(Kernel kernel) noexcept
+{
+    switch (kernel) {
+#ifdef WORDPULSE_X86_SIMD
+    case Kernel::Avx2:
+        return cpuHasAvx2();
+    case Kernel::Ssse3:
+        return cpuHasSsse3();
+#endif
+    case Kernel::Scalar:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool ByteClassifier::setKernel(Kernel kernel) noexcept
+{
+    if (!isKernelSupported(kernel))
+        return false;
+    kernelSlot() = KernelSlot{kernel, kernelFunction(kernel)};
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef BYTECLASSIFIER_H
+#define BYTECLASSIFIER_H
+
+#include <QByteArrayView>
+#include <QtGlobal>
+#include <array>
+#include <set>
+
+// Множество байт, скомпилированное в таблицы для векторной классификации.
+// mask64() строит битовую маску принадлежности сразу для 64 байт:
+// AVX2 (32 байта за инструкцию) или SSSE3 (16), выбор при первом вызове
+// по возможностям процессора; без них - скалярная таблица на 256 элементов.
+class ByteClassifier
+{
+public:
+    enum class Kernel {
+        Scalar,
+        Ssse3,
+        Avx2
+    };
+
+    ByteClassifier();
+    explicit ByteClassifier(const std::set<char>& bytes);
+
+    void add(uchar byte) noexcept;
+    void addRange(uchar from, uchar to) noexcept;
+    bool contains(uchar byte) const noexcept { return _table[byte]; }
+
+    // Бит i установлен, если data[i] входит в множество; i < len <= 64
+    quint64 mask64(const char* data, qsizetype len) const noexcept;
+
+    qsizetype findFirst(QByteArrayView data, qsizetype from = 0) const noexcept;
+    qsizetype findFirstNot(QByteArrayView data, qsizetype from = 0) const noexcept;
+    qsizetype findLast(QByteArrayView data) const noexcept;
+
+    static Kernel activeKernel() noexcept;
+    // Для тестов и бенчмарков; false, если процессор не умеет
+    static bool setKernel(Kernel kernel) noexcept;
+    static bool isKernelSupported(Kernel kernel) noexcept;
+
+    // Таблицы для pshufb: low - строки для старших полубайт 0..7, high - для 8..15
+    struct Tables {
+        alignas(16) uchar low[16];
+        alignas(16) uchar high[16];
+    };
+
+private:
+    std::array<bool, 256> _table;
+    Tables _nibbles;
+};
+
+#endif // BYTECLASSIFIER_H
@@ -0,0 +1,186 @@
+#include "checkpoint.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include "mappedfilewindows.h"
+
+namespace {
+
+void putVarint(QByteArray& out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+bool getVarint(const char*& p, const char* end, quint64& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const quint8 byte = static_cast<quint8>(*p++);
+        value |= static_cast<quint64>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
+Checkpoint::FileIdentity Checkpoint::identityOf(const QString& path)
+{
+    FileIdentity identity;
+    const QFileInfo info(path);
+    if (!info.isFile())
+        return identity;
+    identity.size = info.size();
+    identity.mtimeMs = info.lastModified().toMSecsSinceEpoch();
+    identity.fileId = MappedFileWindows::fileIdOf(path);
+    return identity;
+}
+
+quint64 Checkpoint::configHash(const Config& config)
+{
+    QByteArray key = config.string_pattern.toUtf8();
+    key.append('\0');
+    key.append(config.case_sensitive ? '1' : '0');
+    for (char separator : config.word_separators)
+        key.append(separator);
+    return WordCountTable::hash(key);
+}
+
+bool Checkpoint::open(const QString& path, QString* error)
+{
+    _path = path;
+    _file = std::make_unique<QSaveFile>(path);
+    _buffer.clear();
+    _entryBytes = 0;
+    _entryCount = 0;
+    _writeFailed = false;
+    if (!_file->open(QIODevice::WriteOnly)) {
+        if (error)
+            *error = "Cannot write checkpoint " + path + ": " + _file->errorString();
+        _file.reset();
+        return false;
+    }
+
+    // Число записей и их байт пока неизвестны: commit перепишет их на месте
+    QDataStream out(_file.get());
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << kMagic << kVersion
+        << identity.size << identity.mtimeMs << identity.fileId
+        << configHash << offset;
+    _countsPos = _file->pos();
+    out << quint64(0) << quint64(0);
+    _writeFailed = out.status() != QDataStream::Ok;
+    _buffer.reserve(kWriteBufferBytes + 64);
+    return true;
+}
+
+void Checkpoint::appendTable(const WordCountTable& table)
+{
+    table.forEach([this](QByteArrayView word, quint64, quint64 count) {
+        appendEntry(word, count);
+    });
+}
+
+void Checkpoint::appendEntry(QByteArrayView word, quint64 count)
+{
+    if (!_file || _writeFailed)
+        return;
+    const qsizetype before = _buffer.size();
+    putVarint(_buffer, static_cast<quint64>(word.size()));
+    putVarint(_buffer, count);
+    _buffer.append(word.data(), word.size());
+    _entryBytes += static_cast<quint64>(_buffer.size() - before);
+    ++_entryCount;
+    if (_buffer.size() >= kWriteBufferBytes)
+        flushBuffer();
+}
+
+bool Checkpoint::flushBuffer()
+{
+    if (!_file || _writeFailed)
+        return false;
+    if (!_buffer.isEmpty() && _file->write(_buffer) != _buffer.size())
+        _writeFailed = true;
+    _buffer.resize(0);
+    return !_writeFailed;
+}
+
+bool Checkpoint::commit(QString* error)
+{
+    if (!_file) {
+        if (error)
+            *error = "Checkpoint " + _path + " is not open";
+        return false;
+    }
+
+    bool written = flushBuffer() && _file->seek(_countsPos);
+    if (written) {
+        QDataStream out(_file.get());
+        out.setByteOrder(QDataStream::LittleEndian);
+        out << static_cast<quint64>(_entryCount) << _entryBytes;
+        written = out.status() == QDataStream::Ok;
+    }
+    if (!written || !_file->commit()) {
+        if (error)
+            *error = "Cannot write checkpoint " + _path + ": " + _file->errorString();
+        _file.reset();
+        return false;
+    }
+    _file.reset();
+    return true;
+}
+
+bool Checkpoint::load(const QString& path, WordCountTable& counts, QString* error)
+{
+    const auto fail = [error, &path](const QString& reason) {
+        if (error)
+            *error = "Checkpoint " + path + ": " + reason;
+        return false;
+    };
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(file.errorString());
+
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint64 entryCount = 0;
+    quint64 entryBytes = 0;
+    in >> magic >> version;
+    if (magic != kMagic || version != kVersion)
+        return fail("unknown format");
+    in >> identity.size >> identity.mtimeMs >> identity.fileId
+       >> configHash >> offset >> entryCount >> entryBytes;
+    if (in.status() != QDataStream::Ok || entryBytes != static_cast<quint64>(file.size() - file.pos()))
+        return fail("truncated header");
+
+    const QByteArray entries = file.read(static_cast<qint64>(entryBytes));
+    if (entries.size() != static_cast<qsizetype>(entryBytes))
+        return fail("truncated entries");
+
+    const char* p = entries.constData();
+    const char* end = p + entries.size();
+    quint64 decoded = 0;
+    while (p < end) {
+        quint64 length = 0;
+        quint64 count = 0;
+        if (!getVarint(p, end, length) || !getVarint(p, end, count)
+            || length > static_cast<quint64>(end - p))
+            return fail("corrupted entry");
+        counts.add(QByteArrayView(p, static_cast<qsizetype>(length)),
+                   WordCountTable::hash(QByteArrayView(p, static_cast<qsizetype>(length))), count);
+        p += length;
+        ++decoded;
+    }
+    if (decoded != entryCount)
+        return fail("entry count mismatch");
+    return true;
+}
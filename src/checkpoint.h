@@ -0,0 +1,63 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <QByteArray>
+#include <QSaveFile>
+#include <QString>
+#include <memory>
+#include "config.h"
+#include "wordcounttable.h"
+
+// Контрольная точка анализа одного файла: до какого байта файл досчитан и
+// счётчики слов ровно этого префикса. offset всегда на границе блока.
+// Формат двоичный: заголовок, затем записи "длина слова, счётчик, байты слова"
+// с длиной и счётчиком в varint. Файл пишется через QSaveFile, так что после
+// падения на диске остаётся либо старая точка, либо новая целиком. Записи идут
+// в файл потоком по мере обхода счётчиков, в памяти копится только небольшой буфер.
+struct Checkpoint {
+    // Тот ли это файл: при несовпадении точка игнорируется
+    struct FileIdentity {
+        qint64 size = -1;
+        qint64 mtimeMs = 0;
+        quint64 fileId = 0;     // устройство + inode, 0 там, где их нет
+
+        bool operator==(const FileIdentity& other) const = default;
+    };
+
+    FileIdentity identity;
+    quint64 configHash = 0;
+    quint64 offset = 0;
+
+    static FileIdentity identityOf(const QString& path);
+    // Настройки, от которых зависят счётчики: точку с другими настройками продолжать нельзя
+    static quint64 configHash(const Config& config);
+
+    // Запись: open пишет заголовок (поля выше должны быть заполнены), appendEntry -
+    // по слову, commit дописывает число записей и подменяет файл целиком
+    bool open(const QString& path, QString* error = nullptr);
+    // Дописывает слова таблицы; таблицу в это время никто не должен менять
+    void appendTable(const WordCountTable& table);
+    void appendEntry(QByteArrayView word, quint64 count);
+    bool commit(QString* error = nullptr);
+    qsizetype entryCount() const noexcept { return _entryCount; }
+
+    // Заголовок - в поля, слова - в counts
+    bool load(const QString& path, WordCountTable& counts, QString* error = nullptr);
+
+private:
+    static constexpr quint32 kMagic = 0x4B435057;   // "WPCK"
+    static constexpr quint32 kVersion = 1;
+    static constexpr qsizetype kWriteBufferBytes = 256 * 1024;
+
+    bool flushBuffer();
+
+    std::unique_ptr<QSaveFile> _file;
+    QString _path;
+    qint64 _countsPos = 0;      // где в заголовке число записей и их байт
+    QByteArray _buffer;
+    quint64 _entryBytes = 0;
+    qsizetype _entryCount = 0;
+    bool _writeFailed = false;
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,125 @@
+#include "chunktuner.h"
+#include "config.h"
+
+ChunkTuner::ChunkTuner(const Config& config)
+    : _enabled(config.adaptive_chunking),
+      _minChunk(config.chunk_size_min_bytes), _maxChunk(config.chunk_size_max_bytes),
+      _minDepth(config.queue_depth_min), _maxDepth(config.queue_depth_max),
+      _consumers(qMax(1, config.analyzer_threads))
+{
+    if (!_enabled) {
+        _minChunk = _maxChunk = config.chunk_size_bytes;
+        _minDepth = _maxDepth = config.max_chunks_in_mem_num;
+    }
+    _startChunk = qBound(_minChunk, config.chunk_size_bytes, _maxChunk);
+    _startDepth = qBound(_minDepth, config.max_chunks_in_mem_num, _maxDepth);
+    reset();
+}
+
+void ChunkTuner::reset()
+{
+    _chunk = _startChunk;
+    _depth = _startDepth;
+    _hold = 0;
+    _prevChunk = _chunk;
+    _prevDepth = _depth;
+    _rateBefore = 0;
+    _decision.clear();
+    skipPeriod();
+}
+
+void ChunkTuner::skipPeriod()
+{
+    startPeriod(-1, 0);
+    _stepPending = false;
+}
+
+void ChunkTuner::startPeriod(qint64 nowNs, qint64 stalledNs)
+{
+    _periodStartNs = nowNs;
+    _periodStalledNs = stalledNs;
+    _bytes = 0;
+    _blocks = 0;
+    _emptyPushes = 0;
+    _mapNs = 0;
+    _maxMapNs = 0;
+}
+
+void ChunkTuner::onBlock(qint64 bytes, qint64 mapNs, qsizetype queued)
+{
+    _bytes += bytes;
+    ++_blocks;
+    if (queued == 0)
+        ++_emptyPushes;
+    _mapNs += mapNs;
+    _maxMapNs = qMax(_maxMapNs, mapNs);
+}
+
+bool ChunkTuner::update(qint64 nowNs, qint64 stalledNs)
+{
+    if (!_enabled)
+        return false;
+    if (_periodStartNs < 0) {
+        startPeriod(nowNs, stalledNs);
+        return false;
+    }
+    const qint64 elapsedNs = nowNs - _periodStartNs;
+    if (elapsedNs < kPeriodNs || _blocks < kMinBlocks)
+        return false;
+
+    const double rate = double(_bytes) / double(elapsedNs);    // байт в нс = ГБ/с
+    const double stalled = double(stalledNs - _periodStalledNs) / double(elapsedNs);
+    const double empty = double(_emptyPushes) / _blocks;
+    const qint64 blockNs = elapsedNs / _blocks;
+    // Столько воркер считает один блок, если заняты все
+    const qint64 workerNs = blockNs * _consumers;
+
+    const qint64 oldChunk = _chunk;
+    const qint32 oldDepth = _depth;
+    QString reason;
+
+    if (_stepPending && rate < _rateBefore * kRevertRatio) {
+        _chunk = _prevChunk;
+        _depth = _prevDepth;
+        _hold = kHoldPeriods;
+        reason = QString("throughput fell from %1 MB/s, step reverted").arg(_rateBefore * 1000, 0, 'f', 1);
+    } else if (_hold > 0) {
+        --_hold;
+    } else if (empty > 0.5 && stalled < 0.1) {
+        reason = "analyzers starve";
+        _chunk = qMin(_chunk * 2, _maxChunk);
+        if (_maxMapNs > 2 * blockNs) {
+            _depth = qMin(_depth + qMax(1, _depth / 2), _maxDepth);
+            reason += ", map latency spikes";
+        }
+    } else if (stalled > 0.5) {
+        reason = "reader waits for analyzers";
+        if (workerNs > kMaxBlockNs)
+            _chunk = qMax(_chunk / 2, _minChunk);
+        else if (workerNs < kMinBlockNs)
+            _chunk = qMin(_chunk * 2, _maxChunk);
+        // Очередь ни разу не опустела: лишние блоки только держат память
+        const qint32 floor = qBound(_minDepth, _consumers + 1, _maxDepth);
+        if (!_emptyPushes && stalled > 0.75 && _depth > floor)
+            --_depth;
+    }
+    _stepPending = false;
+
+    const bool changed = _chunk != oldChunk || _depth != oldDepth;
+    if (changed && _hold == 0) {
+        _stepPending = true;
+        _prevChunk = oldChunk;
+        _prevDepth = oldDepth;
+        _rateBefore = rate;
+    }
+    if (changed) {
+        _decision = QString("chunk %1 -> %2 KiB, depth %3 -> %4: %5 (%6 MB/s, reader stalled %7%,"
+                            " queue empty on %8% of blocks, map avg %9 us, max %10 us)")
+                        .arg(oldChunk / 1024).arg(_chunk / 1024).arg(oldDepth).arg(_depth)
+                        .arg(reason).arg(rate * 1000, 0, 'f', 1)
+                        .arg(qRound(stalled * 100)).arg(qRound(empty * 100))
+                        .arg(_mapNs / _blocks / 1000).arg(_maxMapNs / 1000);
+    }
+    startPeriod(nowNs, stalledNs);
+    return changed;
+}
@@ -0,0 +1,80 @@
+#ifndef CHUNKTUNER_H
+#define CHUNKTUNER_H
+
+#include <QString>
+#include <QtGlobal>
+
+struct Config;
+
+// Подбор размера блока и глубины очереди читателя на ходу, в границах из Config.
+// Раз в период читатель отдаёт накопленное: байты, время отображения, пустой ли
+// была очередь на каждом push и сколько он сам простоял на полной очереди.
+//  - очередь пустеет, читатель не стоит: не успевает чтение. Блок растёт, чтобы
+//    накладные расходы на блок делились на больше байт; если отдельные acquire
+//    дольше нескольких блоков (сетевой диск), растёт и очередь, чтобы их пережить;
+//  - читатель стоит на полной очереди: не хватает CPU. Очередь ужимается, блок
+//    подгоняется так, чтобы воркер считал его kMinBlockNs..kMaxBlockNs.
+// Каждый шаг проверяется следующим периодом: если скорость упала, шаг откатывается
+// и настройка замирает на kHoldPeriods.
+class ChunkTuner
+{
+public:
+    explicit ChunkTuner(const Config& config);
+
+    // Начальные значения, новый прогон
+    void reset();
+    // Пауза или ожидание дописывания: период с простоем не годится для сравнения
+    void skipPeriod();
+
+    qint64 chunkSize() const noexcept { return _chunk; }
+    qint32 depth() const noexcept { return _depth; }
+    qint32 maxDepth() const noexcept { return _maxDepth; }
+
+    // queued - сколько блоков ждало в очереди перед этим push
+    void onBlock(qint64 bytes, qint64 mapNs, qsizetype queued);
+    // nowNs - монотонные часы, stalledNs - суммарный простой читателя.
+    // true - размер или глубина изменились, причина в lastDecision()
+    bool update(qint64 nowNs, qint64 stalledNs);
+    const QString& lastDecision() const noexcept { return _decision; }
+
+    static constexpr qint64 kPeriodNs = 250LL * 1000 * 1000;
+    static constexpr qint32 kMinBlocks = 8;
+    static constexpr qint64 kMinBlockNs = 2LL * 1000 * 1000;
+    static constexpr qint64 kMaxBlockNs = 50LL * 1000 * 1000;
+    static constexpr double kRevertRatio = 0.85;
+    static constexpr qint32 kHoldPeriods = 8;
+
+private:
+    void startPeriod(qint64 nowNs, qint64 stalledNs);
+
+    bool _enabled;
+    qint64 _startChunk;
+    qint32 _startDepth;
+    qint64 _minChunk;
+    qint64 _maxChunk;
+    qint32 _minDepth;
+    qint32 _maxDepth;
+    qint32 _consumers;
+
+    qint64 _chunk;
+    qint32 _depth;
+
+    qint64 _periodStartNs;      // -1 - период ещё не начат
+    qint64 _periodStalledNs;
+    qint64 _bytes;
+    qint32 _blocks;
+    qint32 _emptyPushes;
+    qint64 _mapNs;
+    qint64 _maxMapNs;
+
+    // Последний шаг ждёт проверки следующим периодом
+    bool _stepPending;
+    qint64 _prevChunk;
+    qint32 _prevDepth;
+    double _rateBefore;
+    qint32 _hold;
+
+    QString _decision;
+};
+
+#endif // CHUNKTUNER_H
@@ -0,0 +1,154 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QTimer>
+#include <cstdio>
+#include "config.h"
+#include "headlessrunner.h"
+#include "multifilereaderthread.h"
+#include "streamdecoder.h"
+
+namespace {
+
+// "key=value": value разбирается как JSON-литерал (число, true/false), иначе берётся строкой
+bool applyOverride(QJsonObject& obj, const QString& assignment)
+{
+    const qsizetype eq = assignment.indexOf('=');
+    if (eq <= 0)
+        return false;
+
+    const QString key = assignment.left(eq).trimmed();
+    const QString raw = assignment.mid(eq + 1);
+    const QJsonDocument literal = QJsonDocument::fromJson(("[" + raw + "]").toUtf8());
+    if (literal.isArray() && literal.array().size() == 1)
+        obj[key] = literal.array().first();
+    else
+        obj[key] = raw;
+    return true;
+}
+
+int usageError(const QString& message)
+{
+    std::fprintf(stderr, "wordpulse_cli: %s\n", qPrintable(message));
+    return HeadlessRunner::ExitUsageError;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("wordpulse_cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Counts the most frequent words in files and prints them to stdout.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("inputs", "Files, directories, masks like logs/*.log or @list.txt.", "inputs...");
+
+    const QCommandLineOption configOption({"c", "config"}, "JSON config file.", "path");
+    const QCommandLineOption formatOption({"f", "format"}, "Output format: json, csv or tsv.", "format", "json");
+    const QCommandLineOption topOption({"n", "top"}, "Number of words to print (top_n).", "count");
+    const QCommandLineOption threadsOption({"t", "threads"}, "Analyzer threads, 0 - one per core.", "count");
+    const QCommandLineOption setOption({"s", "set"}, "Override a config key, e.g. -s case_sensitive=true.", "key=value");
+    const QCommandLineOption perFileOption("per-file", "Also print the top of every input file.");
+    const QCommandLineOption filterOption("name-filter", "File name masks for directories, e.g. \"*.log;*.txt\".", "masks");
+    const QCommandLineOption checkpointOption("checkpoint", "Save progress to this file periodically and resume from it on the next run.", "path");
+    const QCommandLineOption followOption({"F", "follow"}, "Keep watching the file for appended data, print the top on every change.");
+    const QCommandLineOption traceOption("trace", "Record reader and analyzer spans as Chrome trace JSON (Perfetto).", "path");
+    const QCommandLineOption metricsOption("metrics", "Print pipeline metrics to stderr as JSON lines every metrics_interval_ms.");
+    const QCommandLineOption verboseOption({"v", "verbose"}, "Log progress to stderr.");
+    parser.addOptions({configOption, formatOption, topOption, threadsOption, setOption, perFileOption, filterOption,
+                       checkpointOption, followOption, traceOption, metricsOption, verboseOption});
+
+    parser.process(app);
+
+    if (!parser.isSet(verboseOption))
+        QLoggingCategory::setFilterRules("*.debug=false\n*.info=false");
+
+    const QStringList inputs = parser.positionalArguments();
+    if (inputs.isEmpty())
+        return usageError("at least one input is required (see --help)");
+
+    HeadlessRunner::OutputFormat format;
+    if (!HeadlessRunner::parseFormat(parser.value(formatOption), format))
+        return usageError("unknown format: " + parser.value(formatOption));
+
+    // Конфиг: файл (если задан), поверх него ключи из командной строки
+    QJsonObject configObj;
+    if (parser.isSet(configOption)) {
+        QFile configFile(parser.value(configOption));
+        if (!configFile.open(QIODevice::ReadOnly))
+            return usageError("cannot open config: " + configFile.errorString());
+        QJsonParseError parseError;
+        const QJsonDocument doc = QJsonDocument::fromJson(configFile.readAll(), &parseError);
+        if (parseError.error != QJsonParseError::NoError || !doc.isObject())
+            return usageError("config is not a JSON object: " + parseError.errorString());
+        configObj = doc.object();
+    }
+    if (parser.isSet(topOption))
+        applyOverride(configObj, "top_n=" + parser.value(topOption));
+    if (parser.isSet(threadsOption))
+        applyOverride(configObj, "analyzer_threads=" + parser.value(threadsOption));
+    if (parser.isSet(followOption))
+        configObj["follow"] = true;
+    if (parser.isSet(checkpointOption))
+        configObj["checkpoint_path"] = parser.value(checkpointOption);
+    if (parser.isSet(traceOption))
+        configObj["trace_path"] = parser.value(traceOption);
+    if (parser.isSet(perFileOption))
+        configObj["per_file_top"] = true;
+    if (parser.isSet(filterOption))
+        configObj["input_name_filters"] = parser.value(filterOption);
+    for (const QString& assignment : parser.values(setOption)) {
+        if (!applyOverride(configObj, assignment))
+            return usageError("expected key=value, got: " + assignment);
+    }
+
+    // Промежуточные обновления топа никто не увидит, считаем его реже
+    if (!configObj.contains("update_interval_ms"))
+        configObj["update_interval_ms"] = 1000;
+    // Метрики печатаются только по --metrics, интервал - из конфига
+    if (!parser.isSet(metricsOption))
+        configObj["metrics_interval_ms"] = 0;
+    else if (configObj.value("metrics_interval_ms").toInt() <= 0)
+        configObj["metrics_interval_ms"] = 1000;
+
+    QString configError;
+    const Config config = Config::fromJsonObject(configObj, &configError);
+    if (!configError.isEmpty())
+        return usageError(configError);
+
+    if (config.follow && (inputs.size() != 1 || !QFileInfo(inputs.first()).isFile()
+                          || StreamDecoder::detect(inputs.first()) != StreamDecoder::Format::Plain))
+        return usageError("--follow needs exactly one uncompressed file");
+
+    // Входы проверяются сразу, чтобы опечатка в пути давала код 3, а не ошибку чтения
+    QString inputError;
+    const QStringList filters = config.input_name_filters.split(';', Qt::SkipEmptyParts);
+    const QStringList files = MultiFileReaderThread::expandInputs(inputs, filters, &inputError);
+    if (inputError.isEmpty() && files.isEmpty())
+        inputError = "no input files found";
+    if (inputError.isEmpty() && files.size() == 1) {
+        QFile input(files.first());
+        if (!input.open(QIODevice::ReadOnly))
+            inputError = "cannot open " + files.first() + ": " + input.errorString();
+        else if (!StreamDecoder::isSupported(StreamDecoder::detect(input)))
+            inputError = files.first() + ": " + StreamDecoder::formatName(StreamDecoder::detect(input))
+                         + " input is not supported by this build";
+    }
+    if (!inputError.isEmpty()) {
+        std::fprintf(stderr, "wordpulse_cli: %s\n", qPrintable(inputError));
+        return HeadlessRunner::ExitInputError;
+    }
+
+    QTextStream out(stdout);
+    HeadlessRunner runner(config, inputs, format, out);
+    QTimer::singleShot(0, &runner, &HeadlessRunner::start);
+
+    return app.exec();
+}
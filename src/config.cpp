@@ -1,10 +1,32 @@
 #include "config.h"
+#include "logger.h"
 #include <QFile>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QRegularExpression>
 #include <QDebug>
 #include <QDir>
+#include <QThread>
+
+namespace {
+
+// Значение ключа вне допустимого. Строгий режим (error != nullptr) - ошибка с именем
+// ключа, иначе по умолчанию берётся только это поле, остальные остаются как в файле
+template <typename T>
+bool checkField(const char* key, T& value, T fallback, bool valid, QString* error)
+{
+    if (valid)
+        return true;
+    if (error) {
+        *error = QString("Invalid %1 in config: %2").arg(key).arg(value);
+        return false;
+    }
+    qWarning() << "Invalid" << key << "in config:" << value << ". Using" << fallback;
+    value = fallback;
+    return true;
+}
+
+} // namespace
 
 Config Config::fromJson(const QString& path) {
     QFile file(path);
@@ -25,7 +47,31 @@ Config Config::fromJson(const QString& path) {
     if (!doc.isObject())
         return defaultConfig();
 
-    auto obj = doc.object();
+    return fromJsonObject(doc.object());
+}
+
+Config Config::fromJsonObject(const QJsonObject& obj, QString* error)
+{
+    if (error) {
+        // Строгий режим (CLI): опечатка в ключе не должна тихо превращаться в значение по умолчанию
+        static const QStringList knownKeys = {
+            "top_n", "max_chunks_in_mem_num", "update_interval_ms", "chunk_size_bytes",
+            "adaptive_chunking", "chunk_size_min_bytes", "chunk_size_max_bytes",
+            "queue_depth_min", "queue_depth_max", "read_backend", "direct_io", "io_depth",
+            "mmap_window_bytes", "max_mapped_bytes", "analyzer_threads",
+            "approximate_counting", "approx_capacity", "approx_sketch_width", "approx_sketch_depth",
+            "word_pattern", "case_sensitive", "ngram_size", "word_separators", "follow", "follow_poll_ms",
+            "window_mode", "window_seconds", "window_buckets", "decay_half_life_seconds",
+            "file_reader_threads", "small_file_bytes", "input_name_filters", "per_file_top",
+            "checkpoint_path", "checkpoint_interval_ms", "metrics_interval_ms", "trace_path", "log_level"
+        };
+        for (const QString& key : obj.keys()) {
+            if (!knownKeys.contains(key)) {
+                *error = "Unknown config key: " + key;
+                return defaultConfig();
+            }
+        }
+    }
 
     Config cfg;
     cfg.top_n = obj.value("top_n").toInt(15);
@@ -33,8 +79,79 @@ Config Config::fromJson(const QString& path) {
     cfg.update_interval_ms = obj.value("update_interval_ms").toInt(1);
     qDebug() << "upd int" << cfg.update_interval_ms;
     cfg.chunk_size_bytes = obj.value("chunk_size_bytes").toInteger(1024 * 128);
+    cfg.adaptive_chunking = obj.value("adaptive_chunking").toBool(false);
+    cfg.chunk_size_min_bytes = obj.value("chunk_size_min_bytes").toInteger(64 * 1024);
+    cfg.chunk_size_max_bytes = obj.value("chunk_size_max_bytes").toInteger(16LL * 1024 * 1024);
+    cfg.queue_depth_min = obj.value("queue_depth_min").toInt(2);
+    cfg.queue_depth_max = obj.value("queue_depth_max").toInt(64);
+    const QString readBackend = obj.value("read_backend").toString("mmap").toLower();
+    if (readBackend == "async") {
+        cfg.read_backend = ReadBackend::Async;
+    } else if (readBackend == "ranges") {
+        cfg.read_backend = ReadBackend::Ranges;
+    } else {
+        if (readBackend != "mmap") {
+            qWarning() << "Unknown read_backend in config:" << readBackend;
+            if (error) {
+                *error = "read_backend must be mmap, async or ranges";
+                return defaultConfig();
+            }
+        }
+        cfg.read_backend = ReadBackend::Mmap;
+    }
+    cfg.direct_io = obj.value("direct_io").toBool(false);
+    cfg.io_depth = obj.value("io_depth").toInt(4);
+    cfg.mmap_window_bytes = obj.value("mmap_window_bytes").toInteger(64LL * 1024 * 1024);
+    cfg.max_mapped_bytes = obj.value("max_mapped_bytes").toInteger(256LL * 1024 * 1024);
+    cfg.analyzer_threads = obj.value("analyzer_threads").toInt(1);
+    if (cfg.analyzer_threads <= 0) {
+        // 0 (или меньше) - по числу ядер
+        cfg.analyzer_threads = qMax(1, QThread::idealThreadCount());
+    }
+    cfg.approximate_counting = obj.value("approximate_counting").toBool(false);
+    cfg.approx_capacity = obj.value("approx_capacity").toInt(10000);
+    cfg.approx_sketch_width = obj.value("approx_sketch_width").toInt(0);
+    cfg.approx_sketch_depth = obj.value("approx_sketch_depth").toInt(0);
+    const QString windowMode = obj.value("window_mode").toString("none").toLower();
+    if (windowMode == "sliding") {
+        cfg.window_mode = WindowMode::Sliding;
+    } else if (windowMode == "decay") {
+        cfg.window_mode = WindowMode::Decay;
+    } else {
+        if (windowMode != "none") {
+            qWarning() << "Unknown window_mode in config:" << windowMode;
+            if (error) {
+                *error = "window_mode must be none, sliding or decay";
+                return defaultConfig();
+            }
+        }
+        cfg.window_mode = WindowMode::None;
+    }
+    cfg.window_seconds = obj.value("window_seconds").toInt(60);
+    cfg.window_buckets = obj.value("window_buckets").toInt(12);
+    cfg.decay_half_life_seconds = obj.value("decay_half_life_seconds").toInt(60);
     cfg.string_pattern = obj.value("word_pattern").toString("\\w+");
     cfg.case_sensitive = obj.value("case_sensitive").toBool(false);
+    cfg.ngram_size = obj.value("ngram_size").toInt(1);
+    cfg.follow = obj.value("follow").toBool(false);
+    cfg.follow_poll_ms = obj.value("follow_poll_ms").toInt(1000);
+    cfg.file_reader_threads = obj.value("file_reader_threads").toInt(4);
+    cfg.small_file_bytes = obj.value("small_file_bytes").toInteger(256 * 1024);
+    cfg.input_name_filters = obj.value("input_name_filters").toString();
+    cfg.per_file_top = obj.value("per_file_top").toBool(false);
+    cfg.checkpoint_path = obj.value("checkpoint_path").toString();
+    cfg.checkpoint_interval_ms = obj.value("checkpoint_interval_ms").toInt(30000);
+    cfg.metrics_interval_ms = obj.value("metrics_interval_ms").toInt(1000);
+    cfg.trace_path = obj.value("trace_path").toString();
+    const QString logLevel = obj.value("log_level").toString("info");
+    if (!Logger::parseLevel(logLevel, cfg.log_level)) {
+        qWarning() << "Unknown log_level in config:" << logLevel;
+        if (error) {
+            *error = "log_level must be debug, info, warning or critical";
+            return defaultConfig();
+        }
+        cfg.log_level = QtInfoMsg;
+    }
     QString sepStr = obj.value("word_separators").toString(" \t\n\r.,!?;:'\"()[]{}<>-—–/\\|&*@#%^+=~`");
     cfg.word_separators.clear();
     for (QChar ch : sepStr) {
@@ -44,18 +161,83 @@ Config Config::fromJson(const QString& path) {
     }
 
     // Валидация
-    if (cfg.top_n <= 0 || cfg.chunk_size_bytes <= 0
-        || cfg.max_chunks_in_mem_num <= 0 || cfg.update_interval_ms <= 0)
-    {
-        qWarning() << "Invalid top_n in config:" << cfg.top_n << ". Using default.";
+    const Config defaults = defaultConfig();
+    const bool valid =
+        checkField("top_n", cfg.top_n, defaults.top_n, cfg.top_n > 0, error)
+        && checkField("max_chunks_in_mem_num", cfg.max_chunks_in_mem_num, defaults.max_chunks_in_mem_num,
+                      cfg.max_chunks_in_mem_num > 0, error)
+        && checkField("update_interval_ms", cfg.update_interval_ms, defaults.update_interval_ms,
+                      cfg.update_interval_ms > 0, error)
+        && checkField("chunk_size_bytes", cfg.chunk_size_bytes, defaults.chunk_size_bytes,
+                      cfg.chunk_size_bytes > 0, error)
+        && checkField("mmap_window_bytes", cfg.mmap_window_bytes, defaults.mmap_window_bytes,
+                      cfg.mmap_window_bytes > 0, error)
+        && checkField("max_mapped_bytes", cfg.max_mapped_bytes, defaults.max_mapped_bytes,
+                      cfg.max_mapped_bytes > 0, error)
+        && checkField("follow_poll_ms", cfg.follow_poll_ms, defaults.follow_poll_ms, cfg.follow_poll_ms >= 0, error)
+        && checkField("window_seconds", cfg.window_seconds, defaults.window_seconds, cfg.window_seconds > 0, error)
+        && checkField("window_buckets", cfg.window_buckets, defaults.window_buckets, cfg.window_buckets > 0, error)
+        && checkField("decay_half_life_seconds", cfg.decay_half_life_seconds, defaults.decay_half_life_seconds,
+                      cfg.decay_half_life_seconds > 0, error)
+        && checkField("file_reader_threads", cfg.file_reader_threads, defaults.file_reader_threads,
+                      cfg.file_reader_threads > 0, error)
+        && checkField("small_file_bytes", cfg.small_file_bytes, defaults.small_file_bytes,
+                      cfg.small_file_bytes >= 0, error)
+        && checkField("checkpoint_interval_ms", cfg.checkpoint_interval_ms, defaults.checkpoint_interval_ms,
+                      cfg.checkpoint_interval_ms > 0, error)
+        && checkField("metrics_interval_ms", cfg.metrics_interval_ms, defaults.metrics_interval_ms,
+                      cfg.metrics_interval_ms >= 0, error)
+        && checkField("ngram_size", cfg.ngram_size, defaults.ngram_size, cfg.ngram_size > 0, error)
+        && checkField("io_depth", cfg.io_depth, defaults.io_depth, cfg.io_depth > 0, error)
+        && checkField("approx_capacity", cfg.approx_capacity, defaults.approx_capacity, cfg.approx_capacity > 0, error)
+        // Скетч выключен, если хоть одно из измерений 0
+        && checkField("approx_sketch_width", cfg.approx_sketch_width, defaults.approx_sketch_width,
+                      cfg.approx_sketch_width >= 0, error)
+        && checkField("approx_sketch_depth", cfg.approx_sketch_depth, defaults.approx_sketch_depth,
+                      cfg.approx_sketch_depth >= 0, error)
+        && checkField("chunk_size_min_bytes", cfg.chunk_size_min_bytes, defaults.chunk_size_min_bytes,
+                      cfg.chunk_size_min_bytes > 0, error)
+        // Верхняя граница проверяется после нижней и без неё меньше не становится
+        && checkField("chunk_size_max_bytes", cfg.chunk_size_max_bytes,
+                      qMax(defaults.chunk_size_max_bytes, cfg.chunk_size_min_bytes),
+                      cfg.chunk_size_max_bytes >= cfg.chunk_size_min_bytes, error)
+        && checkField("queue_depth_min", cfg.queue_depth_min, defaults.queue_depth_min, cfg.queue_depth_min > 0, error)
+        && checkField("queue_depth_max", cfg.queue_depth_max, qMax(defaults.queue_depth_max, cfg.queue_depth_min),
+                      cfg.queue_depth_max >= cfg.queue_depth_min, error);
+    if (!valid)
         return defaultConfig();
+
+    // Окно больше бюджета отображения не поместится никогда
+    if (cfg.mmap_window_bytes > cfg.max_mapped_bytes)
+        cfg.mmap_window_bytes = cfg.max_mapped_bytes;
+    // Блок больше окна каждый раз требовал бы своего отображения
+    if (cfg.chunk_size_max_bytes > cfg.mmap_window_bytes)
+        cfg.chunk_size_max_bytes = qMax(cfg.chunk_size_min_bytes, cfg.mmap_window_bytes);
+
+    // Space-Saving должен удерживать хотя бы top_n слов
+    if (cfg.approx_capacity < cfg.top_n)
+        cfg.approx_capacity = cfg.top_n;
+    // Окно считается точно; Space-Saving к нему не применяется
+    if (cfg.window_mode != WindowMode::None && cfg.approximate_counting) {
+        qWarning() << "approximate_counting is ignored with window_mode";
+        cfg.approximate_counting = false;
+    }
+
+    if (cfg.ngram_size > kMaxNgramSize) {
+        qWarning() << "ngram_size" << cfg.ngram_size << "is too large, using" << kMaxNgramSize;
+        cfg.ngram_size = kMaxNgramSize;
     }
 
     // Проверка regex
     QRegularExpression re(cfg.string_pattern);
     if (!re.isValid()) {
-        qInfo() << "Config loaded successfully. Pattern:" << cfg.string_pattern << "TopN:" << cfg.top_n;
-        return defaultConfig();
+        if (error) {
+            *error = "Invalid word_pattern: " + re.errorString();
+            return defaultConfig();
+        }
+        qWarning() << "Invalid word_pattern in config:" << cfg.string_pattern << "-" << re.errorString()
+                   << ". Using" << defaults.string_pattern;
+        cfg.string_pattern = defaults.string_pattern;
     }
 
     return cfg;
@@ -68,8 +250,39 @@ Config Config::defaultConfig()
     cfg.max_chunks_in_mem_num = 10;
     cfg.update_interval_ms = 1;
     cfg.chunk_size_bytes = 1024 * 128;
+    cfg.adaptive_chunking = false;
+    cfg.chunk_size_min_bytes = 64 * 1024;
+    cfg.chunk_size_max_bytes = 16LL * 1024 * 1024;
+    cfg.queue_depth_min = 2;
+    cfg.queue_depth_max = 64;
+    cfg.read_backend = ReadBackend::Mmap;
+    cfg.direct_io = false;
+    cfg.io_depth = 4;
+    cfg.mmap_window_bytes = 64LL * 1024 * 1024;
+    cfg.max_mapped_bytes = 256LL * 1024 * 1024;
+    cfg.analyzer_threads = 1;
+    cfg.approximate_counting = false;
+    cfg.approx_capacity = 10000;
+    cfg.approx_sketch_width = 0;
+    cfg.approx_sketch_depth = 0;
+    cfg.window_mode = WindowMode::None;
+    cfg.window_seconds = 60;
+    cfg.window_buckets = 12;
+    cfg.decay_half_life_seconds = 60;
     cfg.string_pattern = "\\w+";
     cfg.case_sensitive = false;
+    cfg.ngram_size = 1;
+    cfg.follow = false;
+    cfg.follow_poll_ms = 1000;
+    cfg.file_reader_threads = 4;
+    cfg.small_file_bytes = 256 * 1024;
+    cfg.input_name_filters.clear();
+    cfg.per_file_top = false;
+    cfg.checkpoint_path.clear();
+    cfg.checkpoint_interval_ms = 30000;
+    cfg.metrics_interval_ms = 1000;
+    cfg.trace_path.clear();
+    cfg.log_level = QtInfoMsg;
     const char* defaults = " \t\n\r.,!?;:'\"()[]{}<>-—–/\\|&*@#%^+=~`";
     cfg.word_separators.clear();
     for (const char* p = defaults; *p; ++p) {
@@ -1,19 +1,74 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <QJsonObject>
 #include <QString>
 #include <set>
 
 struct Config {
+    // Что считает topWords: всё с начала анализа или только недавнее
+    enum class WindowMode {
+        None,       // накопительно
+        Sliding,    // последние window_seconds, кольцо из window_buckets интервалов
+        Decay       // экспоненциальное затухание с полупериодом decay_half_life_seconds
+    };
+
+    // Чем читается один несжатый файл в CLI; GUI всегда читает Mmap
+    enum class ReadBackend {
+        Mmap,       // FileReaderThread: скользящие окна отображения
+        Async,      // AsyncFileReaderThread: io_uring или pread в свои буферы
+        Ranges      // RangeFileReaderThread: воркеры сами берут выровненные диапазоны
+    };
+
     qint32 top_n;
     qint32 update_interval_ms;
     qint32 max_chunks_in_mem_num;
     qint64 chunk_size_bytes;
+    // Подстройка блока и очереди читателя на ходу (ChunkTuner); chunk_size_bytes
+    // и max_chunks_in_mem_num тогда - начальные значения
+    bool adaptive_chunking;
+    qint64 chunk_size_min_bytes;
+    qint64 chunk_size_max_bytes;
+    qint32 queue_depth_min;
+    qint32 queue_depth_max;
+    ReadBackend read_backend;
+    bool direct_io;             // async: O_DIRECT, мимо page cache
+    qint32 io_depth;            // async: чтений в полёте одновременно
+    qint64 mmap_window_bytes;
+    qint64 max_mapped_bytes;
+    qint32 analyzer_threads;
+    bool approximate_counting;
+    qint32 approx_capacity;
+    qint32 approx_sketch_width;
+    qint32 approx_sketch_depth;
+    WindowMode window_mode;
+    qint32 window_seconds;
+    qint32 window_buckets;
+    qint32 decay_half_life_seconds;
     QString string_pattern;
     bool case_sensitive;
+    // Считать последовательности из ngram_size слов подряд (фразы); 1 - отдельные слова
+    qint32 ngram_size;
+    bool follow;                // дописываемый файл (лог): после конца ждать новых данных
+    qint32 follow_poll_ms;      // запасной опрос размера, если inotify молчит (NFS); 0 - выключен
+    // Несколько входных файлов (MultiFileReaderThread)
+    qint32 file_reader_threads; // файлов читается одновременно
+    qint64 small_file_bytes;    // файлы не больше этого упаковываются по нескольку в один буфер
+    QString input_name_filters; // маски имён при обходе каталогов через ';', пусто - все файлы
+    bool per_file_top;          // кроме общего топа, топ каждого файла
+    // Контрольные точки: только точный подсчёт одного несжатого файла без follow
+    QString checkpoint_path;        // пусто - выключены
+    qint32 checkpoint_interval_ms;
+    qint32 metrics_interval_ms;     // как часто анализатор шлёт metricsUpdated; 0 - никогда
+    QString trace_path;             // Chrome trace JSON, пусто - трассировка выключена
+    QtMsgType log_level;            // сообщения ниже отбрасываются: debug, info, warning, critical
     std::set<char> word_separators;
 
+    static constexpr qint32 kMaxNgramSize = 8;
+
     static Config fromJson(const QString& path);
+    // error != nullptr - неизвестные ключи и невалидные значения сообщаются, а не молча заменяются
+    static Config fromJsonObject(const QJsonObject& obj, QString* error = nullptr);
     static Config defaultConfig();
 };
 
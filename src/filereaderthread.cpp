@@ -1,13 +1,19 @@
 #include "filereaderthread.h"
-#include <QFileDialog>
+#include "logger.h"
+#include "tracer.h"
 #include <QTimer>
 #include <QFileInfo>
 #include <QDir>
 
-FileReaderThread::FileReaderThread(const QString &filePath, const Config& config, QObject *parent) : QThread{parent}, config_cref(config)
+FileReaderThread::FileReaderThread(const QString &filePath, const Config& config, QObject *parent)
+    : QThread{parent},
+      // Кольцо сразу под наибольшую глубину: подстройка меняет только предел заполнения
+      RingDataProvider(config.adaptive_chunking ? config.queue_depth_max : config.max_chunks_in_mem_num),
+      windows(config.mmap_window_bytes, config.max_mapped_bytes,
+              config.chunk_size_bytes * config.max_chunks_in_mem_num),
+      readPos(0), startPos(0), config_cref(config), separators(config.word_separators), tuner(config),
+      watcher(nullptr), pollTimer(nullptr), baseBytes(0), waitingForAppend(false)
 {
-    stream = std::make_unique<QTextStream>(&file);
-    file.setFileName(filePath);
     this->filePath = filePath;
 
     running = false;
@@ -34,7 +40,6 @@ FileReaderThread::~FileReaderThread()
 void FileReaderThread::setFilePath(const QString &filepath)
 {
     this->filePath = filepath;
-    file.setFileName(filePath);
 }
 
 const QString& FileReaderThread::getFilePath(void) const noexcept
@@ -42,43 +47,158 @@ const QString& FileReaderThread::getFilePath(void) const noexcept
     return filePath;
 }
 
+void FileReaderThread::setStartPos(qint64 pos)
+{
+    startPos = pos;
+}
+
 void FileReaderThread::triggerRead()
 {
     QMetaObject::invokeMethod(this, &FileReaderThread::readChunk, Qt::QueuedConnection);
 }
 
-void FileReaderThread::lock()
+void FileReaderThread::releaseDataBlock(QByteArrayView block)
+{
+    if (releaseOwned(block))
+        return;
+    // Освободилось окно - читатель мог стоять на бюджете отображения
+    if (windows.release(block))
+        triggerRead();
+}
+
+bool FileReaderThread::releaseOwned(QByteArrayView block)
+{
+    if (!config_cref.follow)
+        return false;
+    QMutexLocker locker(&ownedMutex);
+    return ownedBlocks.remove(block.data());
+}
+
+void FileReaderThread::dropBlock(QByteArrayView block)
+{
+    if (!releaseOwned(block))
+        windows.release(block, false);
+}
+
+void FileReaderThread::onSpaceFreed()
+{
+    triggerRead();
+}
+
+void FileReaderThread::tuneChunks(qint64 bytes, qint64 mapNs, qsizetype queued)
 {
-    mutex.lock();
+    tuner.onBlock(bytes, mapNs, queued);
+    if (!tuner.update(tunerClock.nsecsElapsed(), producerStats().stalledNs))
+        return;
+    qInfo() << "Chunk tuner:" << tuner.lastDecision();
+    windows.setReadAhead(tuner.chunkSize() * tuner.depth());
 }
 
-void FileReaderThread::unlock()
+void FileReaderThread::clearQueue()
 {
-    mutex.unlock();
+    QByteArrayView blocks[8];
+    qsizetype sizeBefore = 0;
+    while (const qsizetype taken = takeDataBlocks(blocks, 8, sizeBefore)) {
+        for (qsizetype i = 0; i < taken; ++i)
+            dropBlock(blocks[i]);
+    }
 }
 
-bool FileReaderThread::isDataEmpty() const noexcept
+void FileReaderThread::watchFile()
 {
-    return blockQueue.isEmpty();
+    if (!watcher) {
+        watcher = new QFileSystemWatcher(this);
+        // Файл - дописывание и усечение, каталог - появление нового файла после ротации
+        connect(watcher, &QFileSystemWatcher::fileChanged, this, &FileReaderThread::onFileChanged);
+        connect(watcher, &QFileSystemWatcher::directoryChanged, this, &FileReaderThread::onFileChanged);
+    }
+    if (!pollTimer && config_cref.follow_poll_ms > 0) {
+        pollTimer = new QTimer(this);
+        connect(pollTimer, &QTimer::timeout, this, &FileReaderThread::onFileChanged);
+    }
+
+    stopWatching();
+    watcher->addPath(filePath);
+    watcher->addPath(QFileInfo(filePath).absolutePath());
+    if (pollTimer)
+        pollTimer->start(config_cref.follow_poll_ms);
 }
 
-qsizetype FileReaderThread::dataSize() const noexcept
+void FileReaderThread::stopWatching()
 {
-    return blockQueue.size();
+    if (watcher) {
+        const QStringList paths = watcher->files() + watcher->directories();
+        if (!paths.isEmpty())
+            watcher->removePaths(paths);
+    }
+    if (pollTimer)
+        pollTimer->stop();
 }
 
-QByteArrayView FileReaderThread::getDataBlock()
+void FileReaderThread::onFileChanged()
 {
-    return blockQueue.dequeue();
+    if (!running || paused)
+        return;
+    // Пока читаем, следующий readChunk и так увидит новый размер. Но при полной
+    // очереди его может не быть долго, а об усечении сообщаем сразу
+    if (!waitingForAppend && windows.refreshSize() >= readPos)
+        return;
+    waitingForAppend = false;
+    triggerRead();
 }
 
-const QQueue<QByteArrayView>& FileReaderThread::getBlockQueue(void) const noexcept
+qint64 FileReaderThread::checkFollowedFile()
 {
-    return blockQueue;
+    const qint64 previousSize = windows.fileSize();
+    const qint64 size = windows.refreshSize();
+    if (size < readPos) {
+        // copytruncate: файл обрезали и пишут заново с начала. Блоки в режиме follow -
+        // копии, так что и выданные анализаторам, и стоящие в очереди остаются целы
+        qInfo() << "Followed file truncated from" << readPos << "to" << size << "bytes";
+        baseBytes += readPos;
+        readPos = 0;
+        emit fileTruncated();
+        emit totalSizeChanged(static_cast<quint64>(baseBytes + size));
+        return size;
+    }
+    if (size > readPos) {
+        if (size != previousSize)
+            emit totalSizeChanged(static_cast<quint64>(baseBytes + size));
+        return size;
+    }
+
+    // Старый файл дочитан. Если по пути уже другой файл - его переименовали и создали новый
+    const quint64 currentId = MappedFileWindows::fileIdOf(filePath);
+    if (currentId == 0 || currentId == windows.fileId())
+        return size;
+    // Неудачный open() закрыл бы и старый файл, поэтому сначала пробуем отдельно
+    QFile probe(filePath);
+    if (!probe.open(QIODevice::ReadOnly)) {
+        qWarning() << "Rotated file is not readable yet:" << probe.errorString();
+        return size;
+    }
+    probe.close();
+    if (!windows.open(filePath)) {
+        qWarning() << "Rotated file is not readable yet:" << windows.errorString();
+        return size;
+    }
+
+    qInfo() << "Followed file rotated, reading the new one from the beginning";
+    baseBytes += readPos;
+    readPos = 0;
+    watchFile();
+    emit fileRotated();
+    emit totalSizeChanged(static_cast<quint64>(baseBytes + windows.fileSize()));
+    return windows.fileSize();
+}
+
+const MappedFileWindows& FileReaderThread::getWindows(void) const noexcept
+{
+    return windows;
 }
 
 void FileReaderThread::startReading() {
-    if (running && file.isOpen()) {
+    if (running && windows.isOpen()) {
         qWarning() << "Attempt to start reading while already running.";
         return;
     }
@@ -93,30 +213,31 @@ void FileReaderThread::startReading() {
         cancelReading();
     }
 
-    if (file.isOpen()) {
-        file.close();
-    }
+    clearQueue();
 
     qInfo() << "Opening file for reading:" << filePath;
-    if (!file.open(QIODevice::ReadOnly/* | QIODevice::Text*/)) {
-        QString err = "Failed to open file: " + file.errorString();
+    if (!windows.open(filePath)) {
+        QString err = "Failed to open file: " + windows.errorString();
         qCritical() << err;
         emit error(err);
         running = false;
         emit readingError(std::move(err));//  isRunningChanged(running);
-        {
-            QMutexLocker locker(&mutex);
-            blockQueue.clear();
-        }
         return;
     }
 
     running = true;
     paused = false;
-
-    {
-        QMutexLocker locker(&mutex);
-        blockQueue.clear();
+    readPos = qBound<qint64>(0, startPos, windows.fileSize());
+    baseBytes = 0;
+    waitingForAppend = false;
+    reopenData();
+    tuner.reset();
+    tunerClock.start();
+    windows.setReadAhead(tuner.chunkSize() * tuner.depth());
+
+    if (config_cref.follow) {
+        watchFile();
+        emit totalSizeChanged(static_cast<quint64>(windows.fileSize()));
     }
 
     qInfo() << "Reading started successfully.";
@@ -129,6 +250,7 @@ void FileReaderThread::pauseReading() {
     if (!running || paused)
         return;
     paused = true;
+    tuner.skipPeriod();
 }
 
 void FileReaderThread::resumeReading() {
@@ -144,15 +266,13 @@ void FileReaderThread::cancelReading() {
     qInfo() << "Canceling reading operation.";
     running = false;
     paused = false;
+    waitingForAppend = false;
+    stopWatching();
 
-    {
-        QMutexLocker locker(&mutex);
-        blockQueue.clear();
-    }
-
-    if (file.isOpen()) {
-        file.close();
-    }
+    // Блоки, которые уже разбирают анализаторы, вернут свои окна сами
+    clearQueue();
+    closeData();
+    windows.close();
 }
 
 /*void FileReaderThread::readChunk() {
@@ -215,78 +335,123 @@ void FileReaderThread::cancelReading() {
 }*/
 void FileReaderThread::readChunk() {
     if (!running || paused) {
-         qDebug() << "Attempt to read while not running or pause. paused: " << paused << "; running: " << running << ".";
+         qCDebug(lcPipeline) << "Attempt to read while not running or pause. paused: " << paused << "; running: " << running << ".";
         return;
     }
 
+    TraceSpan span("readChunk", "offset", readPos);
     try {
-        {
-            QMutexLocker locker(&mutex);
-            if (blockQueue.size() >= static_cast<int>(config_cref.max_chunks_in_mem_num)) {
-                qInfo() << "Block queue is full, skip reading";
-                return;
-            }
+        // В режиме follow размер перечитывается на каждом куске: fstat дешевле
+        // промаха мимо усечения, после которого старый размер указывал бы за конец файла.
+        // Проверка идёт и при полной очереди: об усечении сообщается сразу
+        qint64 fileSize = config_cref.follow ? checkFollowedFile() : windows.fileSize();
+
+        // При полной очереди чтение продолжит onSpaceFreed()
+        if (!waitForSpace(tuner.depth())) {
+            qCDebug(lcPipeline) << "Block queue is full, skip reading";
+            return;
         }
 
-        if (file.atEnd()) {
+        if (readPos >= fileSize) {
+            if (config_cref.follow) {
+                // Дальше разбудит watcher: пока файл не меняется, читатель не тратит CPU
+                waitingForAppend = true;
+                tuner.skipPeriod();
+                return;
+            }
             running = false;
             qInfo() << "File reading completed (EOF reached).";
+            closeData();
             emit readingFinished();// isRunningChanged(running);
             return;
         }
-        bool isEnd = false;
-        QByteArrayView currentBlockView;
-        qint64 currentPos = file.pos();
-        qsizetype cutPos = currentPos;
-        qint64 chunkSize = 0;
-        while (!isEnd) {
-            if (file.size() == currentBlockView.size() || file.atEnd() || file.size() <= chunkSize)
-                break;
 
-            chunkSize += qMin(config_cref.chunk_size_bytes, file.size() - currentPos);
-            chunkSize = qMin(chunkSize, file.size());
-            uchar* mapped = file.map(currentPos, chunkSize);
-            if (!mapped) {
+        // Блок режется по последнему разделителю; если его нет, кусок удваивается.
+        // В режиме follow кусок копируется (pread), а не отображается: файл могут
+        // усечь, пока анализатор его разбирает
+        QByteArrayView currentBlockView;
+        QByteArray copy;
+        qsizetype cutPos = -1;
+        qint64 chunkSize = qMin(tuner.chunkSize(), fileSize - readPos);
+        qint64 mapNs = 0;
+        while (true) {
+            MappedFileWindows::Status status = MappedFileWindows::Status::Ok;
+            if (config_cref.follow) {
+                TraceSpan copySpan("pread", "bytes", chunkSize);
+                const qint64 mapStart = tunerClock.nsecsElapsed();
+                const qint64 copied = windows.copy(readPos, chunkSize, copy);
+                mapNs += tunerClock.nsecsElapsed() - mapStart;
+                if (copied < 0)
+                    status = MappedFileWindows::Status::Failed;
+                else if (copied == 0) {
+                    // Файл усекли после проверки размера: разберётся следующий readChunk
+                    waitingForAppend = true;
+                    return;
+                } else {
+                    // Короткое чтение - файл стал короче, его конец теперь здесь
+                    if (copied < chunkSize)
+                        fileSize = readPos + copied;
+                    chunkSize = copied;
+                    currentBlockView = QByteArrayView(copy);
+                }
+            } else {
+                TraceSpan mapSpan("mmapAcquire", "bytes", chunkSize);
+                const qint64 mapStart = tunerClock.nsecsElapsed();
+                status = windows.acquire(readPos, chunkSize, currentBlockView);
+                mapNs += tunerClock.nsecsElapsed() - mapStart;
+            }
+            if (status == MappedFileWindows::Status::OverBudget) {
+                qCDebug(lcPipeline) << "Mapping budget is full, waiting for analyzers";
+                markProducerStalled();
+                return;
+            }
+            if (status == MappedFileWindows::Status::Failed) {
                 running = false;
-                QString err = "Critical: File mapping failed. Possibly out of memory or OS limit.";
+                QString err = "Critical: File mapping failed. " + windows.errorString();
                 qCritical() << err;
                 emit error(err);
                 emit readingError(std::move(err));//  isRunningChanged(running);
                 return;
             }
 
-            currentBlockView = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), chunkSize);
-
-            file.seek(currentPos + chunkSize);
-
-            isEnd = true;
-            for (cutPos = currentBlockView.size() - 1; isEnd/* && cutPos >= 0*/; --cutPos) {
-                char c = currentBlockView.at(cutPos);
-                if (config_cref.word_separators.contains(c)) {
-                    break;
-                }
-                if (cutPos == 0)
-                    isEnd = false;
+            {
+                TraceSpan boundarySpan("findBoundary", "bytes", currentBlockView.size());
+                cutPos = separators.findLast(currentBlockView);
             }
-
-            if (isEnd) {
+            if (cutPos >= 0)
                 break;
+            if (readPos + chunkSize >= fileSize) {
+                if (!config_cref.follow)
+                    break;
+                // Недописанное слово в конце лога: ждём его окончания
+                waitingForAppend = true;
+                tuner.skipPeriod();
+                return;
             }
+
+            // Копия просто перечитывается длиннее, окно надо вернуть
+            if (!config_cref.follow)
+                windows.release(currentBlockView, false);
+            chunkSize = qMin(chunkSize * 2, fileSize - readPos);
         }
-        if (isEnd) {
-            qint64 targetSize = currentBlockView.size();
+        if (cutPos >= 0)
             currentBlockView = currentBlockView.first(cutPos + 1);
-
-            qint64 rollback = static_cast<qint64>((targetSize - 1) - cutPos);
-            file.seek(currentPos + chunkSize - rollback);
+        if (config_cref.follow) {
+            copy.truncate(currentBlockView.size());
+            currentBlockView = QByteArrayView(copy);
+            QMutexLocker locker(&ownedMutex);
+            ownedBlocks.insert(copy.constData(), copy);
         }
-
-        if (!currentBlockView.isEmpty())
-        {
-            QMutexLocker locker(&mutex);
-            blockQueue.enqueue(currentBlockView);
-            qDebug() << blockQueue.size() <<" blockQueue enqueue";
+        const qsizetype queued = dataSize();
+        if (!pushDataBlock(currentBlockView)) {
+            dropBlock(currentBlockView);
+            if (waitForSpace(tuner.depth()))
+                triggerRead();
+            return;
         }
+        readPos += currentBlockView.size();
+        tuneChunks(currentBlockView.size(), mapNs, queued);
+        qCDebug(lcPipeline) << dataSize() << " blocks in ring";
 
         emit chunkIsReady();
         triggerRead();
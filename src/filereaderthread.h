@@ -8,8 +8,14 @@
 #include <QQueue>
 #include <QTimer>
 #include <QFile>
+#include <QFileSystemWatcher>
+#include <QHash>
 #include "config.h"
-#include "idataprovider.h"
+#include "ringdataprovider.h"
+#include "byteclassifier.h"
+#include "mappedfilewindows.h"
+#include "chunktuner.h"
+#include <QElapsedTimer>
 
 //#pragma push_macro("emit")
 //#undef emit
@@ -17,7 +23,7 @@
 //#pragma pop_macro("emit")
 
 
-class FileReaderThread : public QThread, public  IDataProvider
+class FileReaderThread : public QThread, public RingDataProvider
 {
     Q_OBJECT
 public:
@@ -27,15 +33,13 @@ public:
 
     void setFilePath(const QString &filepath);
     const QString& getFilePath(void) const noexcept;
+    // С какого байта начнёт следующий startReading (продолжение с контрольной точки)
+    void setStartPos(qint64 pos);
     void triggerRead();
 
-    void lock() override;
-    void unlock() override;
-    bool isDataEmpty() const noexcept override;
-    qsizetype dataSize() const noexcept override;
-    QByteArrayView getDataBlock() override;
+    void releaseDataBlock(QByteArrayView block) override;
 
-    const QQueue<QByteArrayView>& getBlockQueue(void) const noexcept;
+    const MappedFileWindows& getWindows(void) const noexcept;
     bool getRunning() const noexcept;
     bool getPaused() const noexcept;
 
@@ -46,6 +50,9 @@ public slots:
     void cancelReading();
     void readChunk();
 
+private slots:
+    void onFileChanged();
+
 signals:
     void chunkIsReady();
     void readingFinished(void);
@@ -54,23 +61,49 @@ signals:
     void error(const QString &error_str);
     void isRunningChanged(bool isRunning);
     void isPausedChanged(bool isPaused);
+    // Режим follow: сколько байт видно с начала слежения, с учётом усечений и ротаций
+    void totalSizeChanged(quint64 totalSize);
+    void fileTruncated();
+    void fileRotated();
 
 protected:
     void run() override;
+    void onSpaceFreed() override;
 
 private:
-    QFile file;
-    QString filePath;
-    std::unique_ptr<QTextStream> stream;
+    void clearQueue();
+    // Вернуть блок, который анализаторы не разбирали
+    void dropBlock(QByteArrayView block);
+    // Режим follow: блок - собственная копия, её снимает releaseDataBlock
+    bool releaseOwned(QByteArrayView block);
+    void watchFile();
+    void stopWatching();
+    qint64 checkFollowedFile();
+    void tuneChunks(qint64 bytes, qint64 mapNs, qsizetype queued);
 
-    QQueue<QByteArrayView> blockQueue;
-    QMutex mutex;
+    QString filePath;
+    MappedFileWindows windows;
+    qint64 readPos;
+    qint64 startPos;
 
     const Config& config_cref;
+    ByteClassifier separators;
+    ChunkTuner tuner;
+    QElapsedTimer tunerClock;
 
     bool running;
     bool paused;
 
+    // Режим follow: watcher и таймер создаются в потоке читателя при первом старте
+    QFileSystemWatcher* watcher;
+    QTimer* pollTimer;
+    qint64 baseBytes;       // байт в предыдущих версиях файла (до усечения или ротации)
+    bool waitingForAppend;  // дочитали до конца и ждём события
+    // Режим follow: блоки копируются из файла, а не отображаются - после copytruncate
+    // страницы за новым концом дали бы SIGBUS у анализатора. Ключ - начало блока
+    QMutex ownedMutex;
+    QHash<const char*, QByteArray> ownedBlocks;
+
     friend class BlockAnalyzerThread;
 };
 
@@ -0,0 +1,350 @@
+#include "headlessrunner.h"
+#include "streamdecoder.h"
+#include "tracer.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+QString csvField(const QString& value)
+{
+    if (!value.contains(',') && !value.contains('"') && !value.contains('\n') && !value.contains('\r'))
+        return value;
+    QString quoted = value;
+    quoted.replace("\"", "\"\"");
+    return '"' + quoted + '"';
+}
+
+QString tsvField(QString value)
+{
+    value.replace("\\", "\\\\");
+    value.replace("\t", "\\t");
+    value.replace("\n", "\\n");
+    value.replace("\r", "\\r");
+    return value;
+}
+
+} // namespace
+
+HeadlessRunner::HeadlessRunner(const Config& config, const QStringList& inputs, OutputFormat format,
+                               QTextStream& out, QObject* parent)
+    : QObject{parent}, _config(config), _inputs(inputs), _totalBytes(0), _format(format), _out(out), _done(false)
+{
+    if (useAsyncReader()) {
+        auto reader = std::make_unique<AsyncFileReaderThread>(_inputs.first(), _config);
+        _provider = reader.get();
+        _analyzer = std::make_unique<BlockAnalyzerThread>(_config, _provider);
+        connectReader(reader.get());
+        _reader = std::move(reader);
+    } else if (useRangeReader()) {
+        auto reader = std::make_unique<RangeFileReaderThread>(_inputs.first(), _config);
+        _provider = reader.get();
+        _analyzer = std::make_unique<BlockAnalyzerThread>(_config, _provider);
+        connectReader(reader.get());
+        _reader = std::move(reader);
+    } else if (isSingleMappedFile()) {
+        auto reader = std::make_unique<FileReaderThread>(_inputs.first(), _config);
+        _provider = reader.get();
+        _analyzer = std::make_unique<BlockAnalyzerThread>(_config, _provider);
+        connectReader(reader.get());
+        connect(_analyzer.get(), &BlockAnalyzerThread::thresholdBlockFreed,
+                reader.get(), &FileReaderThread::readChunk, Qt::QueuedConnection);
+        _reader = std::move(reader);
+    } else {
+        auto reader = std::make_unique<MultiFileReaderThread>(_inputs, _config);
+        _provider = reader.get();
+        _analyzer = std::make_unique<BlockAnalyzerThread>(_config, _provider);
+        connectReader(reader.get());
+        _reader = std::move(reader);
+    }
+
+    connect(_analyzer.get(), &BlockAnalyzerThread::topWords,
+            this, &HeadlessRunner::storeTopWords, Qt::QueuedConnection);
+    connect(_analyzer.get(), &BlockAnalyzerThread::topWordsErrorBounds,
+            this, &HeadlessRunner::storeErrorBounds, Qt::QueuedConnection);
+    connect(_analyzer.get(), &BlockAnalyzerThread::fileTopWords,
+            this, &HeadlessRunner::storeFileTopWords, Qt::QueuedConnection);
+    connect(_analyzer.get(), &BlockAnalyzerThread::analyzisFinished,
+            this, &HeadlessRunner::finish, Qt::QueuedConnection);
+    connect(_analyzer.get(), &BlockAnalyzerThread::analyzingError,
+            this, &HeadlessRunner::fail, Qt::QueuedConnection);
+    if (_config.metrics_interval_ms > 0) {
+        connect(_analyzer.get(), &BlockAnalyzerThread::metricsUpdated,
+                this, &HeadlessRunner::printMetrics, Qt::QueuedConnection);
+    }
+}
+
+template <typename Reader>
+void HeadlessRunner::connectReader(Reader* reader)
+{
+    connect(reader, &Reader::chunkIsReady,
+            _analyzer.get(), &BlockAnalyzerThread::analyzeBlock, Qt::QueuedConnection);
+    connect(reader, &Reader::readingFinished,
+            _analyzer.get(), &BlockAnalyzerThread::analyzingFinishing, Qt::QueuedConnection);
+    connect(reader, &Reader::totalSizeChanged,
+            _analyzer.get(), &BlockAnalyzerThread::setTotalSize, Qt::QueuedConnection);
+    connect(reader, &Reader::totalSizeChanged, this, [this](quint64 totalSize) {
+        _totalBytes = totalSize;
+    }, Qt::QueuedConnection);
+    connect(reader, &Reader::readingError,
+            this, &HeadlessRunner::fail, Qt::QueuedConnection);
+}
+
+bool HeadlessRunner::isSingleMappedFile() const
+{
+    return _inputs.size() == 1 && QFileInfo(_inputs.first()).isFile()
+           && StreamDecoder::detect(_inputs.first()) == StreamDecoder::Format::Plain;
+}
+
+bool HeadlessRunner::useAsyncReader() const
+{
+    if (_config.read_backend != Config::ReadBackend::Async || !isSingleMappedFile())
+        return false;
+    // Дописываемый файл следит за размером через окна отображения
+    if (_config.follow) {
+        qWarning() << "read_backend async does not support follow, reading with mmap";
+        return false;
+    }
+    if (!AsyncFileReaderThread::isSupported()) {
+        qWarning() << "read_backend async is not supported on this platform, reading with mmap";
+        return false;
+    }
+    return true;
+}
+
+bool HeadlessRunner::useRangeReader() const
+{
+    if (_config.read_backend != Config::ReadBackend::Ranges || !isSingleMappedFile())
+        return false;
+    if (_config.follow) {
+        qWarning() << "read_backend ranges does not support follow, reading with mmap";
+        return false;
+    }
+    // Файл отображается целиком; на 32-битных системах это упрётся в адресное пространство
+    if (sizeof(void*) < 8 && QFileInfo(_inputs.first()).size() > _config.max_mapped_bytes) {
+        qWarning() << "File is too large to map at once, reading with mmap windows";
+        return false;
+    }
+    return true;
+}
+
+HeadlessRunner::~HeadlessRunner()
+{
+    stopThreads();
+}
+
+bool HeadlessRunner::parseFormat(const QString& name, OutputFormat& format)
+{
+    const QString lower = name.toLower();
+    if (lower == "json")
+        format = OutputFormat::Json;
+    else if (lower == "csv")
+        format = OutputFormat::Csv;
+    else if (lower == "tsv")
+        format = OutputFormat::Tsv;
+    else
+        return false;
+    return true;
+}
+
+void HeadlessRunner::start()
+{
+    // Для нескольких файлов размер сообщит сам читатель через totalSizeChanged
+    if (isSingleMappedFile()) {
+        _totalBytes = static_cast<quint64>(QFileInfo(_inputs.first()).size());
+        _analyzer->setTotalSize(_totalBytes);
+    }
+
+    // Смещение в файле есть только у одного несжатого файла, дописываемый лог его меняет
+    if (!_config.checkpoint_path.isEmpty()) {
+        if (isSingleMappedFile() && !_config.follow) {
+            const quint64 offset = _analyzer->prepareCheckpoint(_inputs.first());
+            if (auto* reader = qobject_cast<FileReaderThread*>(_reader.get()))
+                reader->setStartPos(static_cast<qint64>(offset));
+            else if (auto* asyncReader = qobject_cast<AsyncFileReaderThread*>(_reader.get()))
+                asyncReader->setStartPos(static_cast<qint64>(offset));
+            else if (auto* rangeReader = qobject_cast<RangeFileReaderThread*>(_reader.get()))
+                rangeReader->setStartPos(static_cast<qint64>(offset));
+        } else {
+            qWarning() << "Checkpoints need a single uncompressed file without follow, they are disabled";
+        }
+    }
+
+    if (!_config.trace_path.isEmpty())
+        Tracer::start();
+
+    _reader->start();
+    _analyzer->start();
+
+    QMetaObject::invokeMethod(_analyzer.get(), "startAnalyzis", Qt::QueuedConnection);
+    QMetaObject::invokeMethod(_reader.get(), "startReading", Qt::QueuedConnection);
+}
+
+void HeadlessRunner::printMetrics(const PipelineMetrics& metrics)
+{
+    // stdout занят топом, метрики - отдельными строками JSON в stderr
+    const QByteArray line = QJsonDocument(metrics.toJson()).toJson(QJsonDocument::Compact);
+    std::fprintf(stderr, "%s\n", line.constData());
+    std::fflush(stderr);
+}
+
+void HeadlessRunner::storeTopWords(const QVector<QPair<quint64, QString>>& list)
+{
+    _topWords = list;
+    // В режиме follow конца нет: печатаем каждое обновление (погрешности приходят следом)
+    if (_config.follow && !_config.approximate_counting)
+        print();
+}
+
+void HeadlessRunner::storeErrorBounds(const QVector<quint64>& errors)
+{
+    _errors = errors;
+    if (_config.follow)
+        print();
+}
+
+void HeadlessRunner::storeFileTopWords(const QString& source, const QVector<QPair<quint64, QString>>& list)
+{
+    _fileTops.append({source, list});
+}
+
+void HeadlessRunner::finish()
+{
+    if (_done)
+        return;
+    _done = true;
+
+    std::sort(_fileTops.begin(), _fileTops.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    print();
+    stopThreads();
+    writeTrace();
+    QCoreApplication::exit(ExitOk);
+}
+
+void HeadlessRunner::fail(const QString& error)
+{
+    if (_done)
+        return;
+    _done = true;
+
+    qCritical() << "Analysis failed:" << error;
+    stopThreads();
+    writeTrace();
+    QCoreApplication::exit(ExitRuntimeError);
+}
+
+void HeadlessRunner::print()
+{
+    const bool withErrors = _config.approximate_counting && _errors.size() == _topWords.size();
+    const bool perFile = _config.per_file_top && !_fileTops.isEmpty();
+
+    // Анализатор отдаёт топ по возрастанию, печатаем по убыванию
+    switch (_format) {
+    case OutputFormat::Json: {
+        const auto toJson = [](const QVector<QPair<quint64, QString>>& list, const QVector<quint64>* errors) {
+            QJsonArray top;
+            for (qsizetype i = list.size() - 1; i >= 0; --i) {
+                QJsonObject entry;
+                entry["word"] = list[i].second;
+                entry["count"] = static_cast<qint64>(list[i].first);
+                if (errors)
+                    entry["error"] = static_cast<qint64>((*errors)[i]);
+                top.append(entry);
+            }
+            return top;
+        };
+
+        QJsonObject root;
+        if (_inputs.size() == 1)
+            root["file"] = _inputs.first();
+        else
+            root["inputs"] = QJsonArray::fromStringList(_inputs);
+        root["bytes"] = static_cast<qint64>(_totalBytes);
+        root["approximate"] = _config.approximate_counting;
+        root["top"] = toJson(_topWords, withErrors ? &_errors : nullptr);
+        if (perFile) {
+            QJsonArray files;
+            for (const auto& fileTop : _fileTops) {
+                QJsonObject entry;
+                entry["file"] = fileTop.first;
+                entry["top"] = toJson(fileTop.second, nullptr);
+                files.append(entry);
+            }
+            root["files"] = files;
+        }
+        // follow: одно обновление - одна строка JSON
+        _out << QJsonDocument(root).toJson(_config.follow ? QJsonDocument::Compact : QJsonDocument::Indented);
+        if (_config.follow)
+            _out << '\n';
+        break;
+    }
+    case OutputFormat::Csv:
+    case OutputFormat::Tsv: {
+        const bool csv = _format == OutputFormat::Csv;
+        const QChar sep = csv ? QChar(',') : QChar('\t');
+        const auto field = [csv](const QString& value) { return csv ? csvField(value) : tsvField(value); };
+
+        // С per_file_top первая колонка - файл, общий топ помечен "*"
+        if (perFile)
+            _out << "file" << sep;
+        _out << "word" << sep << "count";
+        if (withErrors)
+            _out << sep << "error";
+        _out << '\n';
+        for (qsizetype i = _topWords.size() - 1; i >= 0; --i) {
+            if (perFile)
+                _out << '*' << sep;
+            _out << field(_topWords[i].second) << sep << _topWords[i].first;
+            if (withErrors)
+                _out << sep << _errors[i];
+            _out << '\n';
+        }
+        if (perFile) {
+            for (const auto& fileTop : _fileTops) {
+                const QString file = field(fileTop.first);
+                for (qsizetype i = fileTop.second.size() - 1; i >= 0; --i) {
+                    _out << file << sep << field(fileTop.second[i].second) << sep << fileTop.second[i].first;
+                    if (withErrors)
+                        _out << sep;
+                    _out << '\n';
+                }
+            }
+        }
+        if (_config.follow)
+            _out << '\n';
+        break;
+    }
+    }
+    _out.flush();
+}
+
+void HeadlessRunner::writeTrace()
+{
+    // Потоки уже остановлены: все интервалы закрыты
+    if (_config.trace_path.isEmpty())
+        return;
+    QString error;
+    if (!Tracer::stop(_config.trace_path, &error))
+        qWarning() << error;
+}
+
+void HeadlessRunner::stopThreads()
+{
+    // Потоки сами себя перенесли в свой QThread: возвращаем их сюда перед остановкой
+    QThread* current = QThread::currentThread();
+    for (QThread* thread : {static_cast<QThread*>(_analyzer.get()), static_cast<QThread*>(_reader.get())}) {
+        if (!thread || !thread->isRunning())
+            continue;
+        QMetaObject::invokeMethod(thread, [thread, current]() {
+            thread->moveToThread(current);
+        }, Qt::BlockingQueuedConnection);
+        thread->quit();
+        thread->wait();
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+#include <memory>
+#include "config.h"
+#include "filereaderthread.h"
+#include "asyncfilereaderthread.h"
+#include "rangefilereaderthread.h"
+#include "multifilereaderthread.h"
+#include "blockanalyzerthread.h"
+
+// Тот же конвейер FileReaderThread -> BlockAnalyzerThread, что и в WordPulseViewModel,
+// но без UI: по окончании печатает топ в поток вывода и завершает QCoreApplication.
+// В режиме follow файл не кончается: топ печатается при каждом изменении.
+// Если входов несколько (или вход - каталог, маска, список), читает MultiFileReaderThread,
+// один файл с read_backend = "async" - AsyncFileReaderThread, с "ranges" - RangeFileReaderThread.
+class HeadlessRunner : public QObject
+{
+    Q_OBJECT
+public:
+    enum ExitCode {
+        ExitOk = 0,
+        ExitRuntimeError = 1,   // ошибка чтения или анализа
+        ExitUsageError = 2,     // аргументы или конфиг
+        ExitInputError = 3      // входной файл не открывается
+    };
+
+    enum class OutputFormat {
+        Json,
+        Csv,
+        Tsv
+    };
+
+    HeadlessRunner(const Config& config, const QStringList& inputs, OutputFormat format,
+                   QTextStream& out, QObject* parent = nullptr);
+    ~HeadlessRunner();
+
+    static bool parseFormat(const QString& name, OutputFormat& format);
+
+public slots:
+    void start();
+
+private slots:
+    void storeTopWords(const QVector<QPair<quint64, QString>>& list);
+    void storeErrorBounds(const QVector<quint64>& errors);
+    void storeFileTopWords(const QString& source, const QVector<QPair<quint64, QString>>& list);
+    void printMetrics(const PipelineMetrics& metrics);
+    void finish();
+    void fail(const QString& error);
+
+private:
+    template <typename Reader>
+    void connectReader(Reader* reader);
+    // Один несжатый файл читается отображением окон, всё остальное - MultiFileReaderThread
+    bool isSingleMappedFile() const;
+    // read_backend = "async" и файл можно читать им (не follow, Unix)
+    bool useAsyncReader() const;
+    // read_backend = "ranges": не follow, и файл целиком помещается в адресное пространство
+    bool useRangeReader() const;
+    void print();
+    void stopThreads();
+    void writeTrace();
+
+    Config _config;
+    QStringList _inputs;
+    quint64 _totalBytes;
+    OutputFormat _format;
+    QTextStream& _out;
+
+    // FileReaderThread, AsyncFileReaderThread или RangeFileReaderThread для одного обычного файла,
+    // иначе MultiFileReaderThread
+    std::unique_ptr<QThread> _reader;
+    IDataProvider* _provider;
+    std::unique_ptr<BlockAnalyzerThread> _analyzer;
+
+    QVector<QPair<quint64, QString>> _topWords;
+    QVector<quint64> _errors;
+    QVector<QPair<QString, QVector<QPair<quint64, QString>>>> _fileTops;
+    bool _done;
+};
+
+#endif // HEADLESSRUNNER_H
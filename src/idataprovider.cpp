@@ -1 +1,21 @@
 #include "idataprovider.h"
+
+qsizetype IDataProvider::takeDataBlocks(QByteArrayView* blocks, qsizetype max, qsizetype& sizeBefore)
+{
+    lock();
+    sizeBefore = dataSize();
+    qsizetype taken = 0;
+    while (taken < max && !isDataEmpty())
+        blocks[taken++] = getDataBlock();
+    unlock();
+    return taken;
+}
+
+bool IDataProvider::waitForData(qint32 timeoutMs)
+{
+    Q_UNUSED(timeoutMs);
+    lock();
+    const bool hasData = !isDataEmpty();
+    unlock();
+    return hasData;
+}
@@ -3,9 +3,17 @@
 
 #include <QByteArray>
 #include <QMutex>
+#include <QString>
 
 class IDataProvider {
 public:
+    // Счётчики производителя для метрик конвейера
+    struct ProducerStats {
+        quint64 blocks = 0;
+        quint64 bytes = 0;
+        qint64 stalledNs = 0;   // сколько производитель ждал места (обратное давление)
+    };
+
     virtual ~IDataProvider() = default;
 
     virtual void lock() = 0;
@@ -13,6 +21,27 @@ public:
     virtual bool isDataEmpty() const noexcept = 0;
     virtual qsizetype dataSize() const noexcept = 0;
     virtual QByteArrayView getDataBlock() = 0;
+    // Вызывается, когда блок из getDataBlock разобран и view больше не нужен
+    virtual void releaseDataBlock(QByteArrayView block) { Q_UNUSED(block); }
+
+    // Забирает до max блоков за один заход, в sizeBefore - размер очереди до выдачи.
+    // По умолчанию - под одной парой lock()/unlock().
+    virtual qsizetype takeDataBlocks(QByteArrayView* blocks, qsizetype max, qsizetype& sizeBefore);
+    // Ждёт данных не дольше timeoutMs. По умолчанию не ждёт, а только проверяет очередь.
+    virtual bool waitForData(qint32 timeoutMs);
+
+    // Из какого входного файла блок (вызывать до releaseDataBlock); -1 - источник один
+    virtual qint32 blockSource(QByteArrayView block) const { Q_UNUSED(block); return -1; }
+    virtual QString sourceName(qint32 source) const { Q_UNUSED(source); return QString(); }
+    // Последний блок источника возвращает, сколько всего блоков у источника; остальные - 0.
+    // Блоки одного источника могут досчитываться в любом порядке, так что конец файла -
+    // это когда досчитано столько блоков
+    virtual qint32 sourceBlockCount(QByteArrayView block) const { Q_UNUSED(block); return 0; }
+    // Сколько байт входного файла покрывает блок; для сжатых файлов это сжатые байты
+    virtual qint64 blockInputBytes(QByteArrayView block) const { return block.size(); }
+    virtual ProducerStats producerStats() const { return {}; }
+    // Сколько блоков производитель держит в очереди сейчас (может меняться на ходу); 0 - не знает
+    virtual qsizetype queueLimit() const noexcept { return 0; }
 };
 
 #endif // IDATAPROVIDER_H
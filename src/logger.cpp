@@ -1,64 +1,277 @@
 #include "logger.h"
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QStringEncoder>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
+Q_LOGGING_CATEGORY(lcPipeline, "wordpulse.pipeline")
+
 Logger* Logger::self = nullptr;
 
-void Logger::init(const QString &logPath)
+void Logger::init(const QString &logPath, QtMsgType level)
 {
     static Logger instance(logPath);
+    setLevel(level);
     qInstallMessageHandler(Logger::messageHandler);
 }
 
 Logger::Logger(const QString &path)
+    : _free(kRecordCount), _ready(kRecordCount), _level(0), _dropped(0), _accepted(0), _written(0),
+      _stopping(false)
 {
     logFile.setFileName(path);
     if (!logFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
         std::cerr << "Could not open log file: " << path.toStdString() << std::endl;
     }
+
+    _records = std::make_unique<Record[]>(kRecordCount);
+    for (qsizetype i = 0; i < kRecordCount; ++i)
+        _free.tryPush(static_cast<quint32>(i));
+
+    _writer = QThread::create([this]() { writerLoop(); });
+    _writer->setObjectName("LoggerWriter");
+    _writer->start(QThread::LowPriority);
     self = this;
 }
 
 Logger::~Logger()
 {
+    qInstallMessageHandler(nullptr);
+    self = nullptr;
+
+    _stopping = true;
+    _wake.wakeOne();
+    _writer->wait();
+    delete _writer;
+
     if (logFile.isOpen())
         logFile.close();
 }
 
+void Logger::setLevel(QtMsgType level)
+{
+    if (self)
+        self->_level = rank(level);
+    applyCategoryFilter(level);
+}
 
-void Logger::messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+QtMsgType Logger::level()
 {
     if (!self)
+        return QtDebugMsg;
+    switch (self->_level.load(std::memory_order_relaxed)) {
+    case 0:  return QtDebugMsg;
+    case 1:  return QtInfoMsg;
+    case 2:  return QtWarningMsg;
+    default: return QtCriticalMsg;
+    }
+}
+
+bool Logger::parseLevel(const QString& name, QtMsgType& level)
+{
+    const QString lower = name.toLower();
+    if (lower == "debug")
+        level = QtDebugMsg;
+    else if (lower == "info")
+        level = QtInfoMsg;
+    else if (lower == "warning")
+        level = QtWarningMsg;
+    else if (lower == "critical")
+        level = QtCriticalMsg;
+    else
+        return false;
+    return true;
+}
+
+void Logger::flush()
+{
+    Logger* logger = self;
+    if (!logger || QThread::currentThread() == logger->_writer)
         return;
 
-    QMutexLocker locker(&self->mutex);
+    const quint64 target = logger->_accepted.load();
+    QMutexLocker locker(&logger->_wakeMutex);
+    while (logger->_written.load() < target && logger->_writer->isRunning()) {
+        logger->_wake.wakeOne();
+        logger->_flushed.wait(&logger->_wakeMutex, kWriterIdleMs);
+    }
+}
+
+int Logger::rank(QtMsgType type) noexcept
+{
+    // Значения QtMsgType не упорядочены по важности (QtInfoMsg - самое большое)
+    switch (type) {
+    case QtDebugMsg:    return 0;
+    case QtInfoMsg:     return 1;
+    case QtWarningMsg:  return 2;
+    case QtCriticalMsg: return 3;
+    case QtFatalMsg:    return 4;
+    }
+    return 4;
+}
+
+void Logger::applyCategoryFilter(QtMsgType level)
+{
+    // Выключенная категория отсекает qCDebug/qCInfo ещё до построения QDebug
+    QString rules;
+    const int minRank = rank(level);
+    if (minRank > 0)
+        rules += "*.debug=false\n";
+    if (minRank > 1)
+        rules += "*.info=false\n";
+    if (minRank > 2)
+        rules += "*.warning=false\n";
+    QLoggingCategory::setFilterRules(rules);
+}
+
+qsizetype Logger::format(char* buffer, qsizetype capacity, QtMsgType type,
+                         const QMessageLogContext& context, const QString& msg)
+{
+    // Дата до секунды меняется раз в секунду - строим её заново только тогда
+    struct SecondStamp {
+        qint64 second = -1;
+        char text[24] = {};
+    };
+    thread_local SecondStamp stamp;
+    thread_local std::array<char, kRecordBytes * 3> utf8;
+
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    if (nowMs / 1000 != stamp.second) {
+        stamp.second = nowMs / 1000;
+        const QByteArray text = QDateTime::fromSecsSinceEpoch(stamp.second)
+                                    .toString("yyyy-MM-dd HH:mm:ss").toLatin1();
+        qstrncpy(stamp.text, text.constData(), sizeof(stamp.text));
+    }
 
-    QString level;
+    const char* level = "FATAL";
     switch (type) {
     case QtDebugMsg:    level = "DEBUG"; break;
     case QtInfoMsg:     level = "INFO "; break;
     case QtWarningMsg:  level = "WARN "; break;
     case QtCriticalMsg: level = "CRIT "; break;
-    case QtFatalMsg:    level = "FATAL"; break;
+    case QtFatalMsg:    break;
+    }
+
+    // Оставляем место под пробел и перевод строки
+    const qsizetype limit = capacity - 2;
+    qsizetype size = std::snprintf(buffer, static_cast<size_t>(capacity), "[%s.%03d] [Thread: %llu] [%s]",
+                                   stamp.text, static_cast<int>(nowMs % 1000),
+                                   static_cast<unsigned long long>(reinterpret_cast<quintptr>(QThread::currentThreadId())),
+                                   level);
+    size = qBound<qsizetype>(0, size, limit);
+    if (context.file && context.line && size < limit) {
+        const int written = std::snprintf(buffer + size, static_cast<size_t>(capacity - size), " [%s:%d]",
+                                          context.file, context.line);
+        size = qBound<qsizetype>(size, size + written, limit);
+    }
+    buffer[size++] = ' ';
+
+    // Сообщение длиннее записи обрезается, не разрывая символ UTF-8
+    QStringView text(msg);
+    if (text.size() > kRecordBytes) {
+        text = text.first(kRecordBytes);
+        if (text.back().isHighSurrogate())
+            text.chop(1);
+    }
+    QStringEncoder encoder(QStringEncoder::Utf8);
+    qsizetype length = encoder.appendToBuffer(utf8.data(), text) - utf8.data();
+    const qsizetype room = capacity - 1 - size;
+    if (length > room) {
+        length = room;
+        while (length > 0 && (static_cast<quint8>(utf8[length]) & 0xC0) == 0x80)
+            --length;
+    }
+    std::memcpy(buffer + size, utf8.data(), static_cast<size_t>(length));
+    size += length;
+    buffer[size++] = '\n';
+    return size;
+}
+
+void Logger::writerLoop()
+{
+    QByteArray batch;
+    batch.reserve(kWriteBatchBytes + kRecordBytes);
+    quint64 pending = 0;
+    std::array<quint32, 64> indices;
+
+    while (true) {
+        const qsizetype taken = _ready.tryPopBatch(indices.data(), static_cast<qsizetype>(indices.size()));
+        for (qsizetype i = 0; i < taken; ++i) {
+            const Record& record = _records[indices[i]];
+            batch.append(record.text, record.size);
+            _free.tryPush(indices[i]);
+        }
+        pending += static_cast<quint64>(taken);
+
+        if (!taken) {
+            const quint64 dropped = _dropped.exchange(0);
+            if (dropped)
+                batch.append("[Logger] " + QByteArray::number(dropped) + " messages dropped, queue was full\n");
+        }
+
+        // Пишем, когда набралась пачка или очередь опустела
+        if (batch.size() >= kWriteBatchBytes || (!taken && !batch.isEmpty())) {
+            writeBatch(batch);
+            batch.resize(0);
+            _written += pending;
+            pending = 0;
+            QMutexLocker locker(&_wakeMutex);
+            _flushed.wakeAll();
+        }
+
+        if (!taken) {
+            if (_stopping && _ready.isEmpty())
+                break;
+            QMutexLocker locker(&_wakeMutex);
+            _wake.wait(&_wakeMutex, kWriterIdleMs);
+        }
     }
+}
 
-    QString contextInfo;
-    if (context.file && context.line) {
-        contextInfo = QString(" [%1:%2]").arg(context.file).arg(context.line);
+void Logger::writeBatch(const QByteArray& batch)
+{
+    if (logFile.isOpen()) {
+        logFile.write(batch);
+        logFile.flush();
     }
+    std::fwrite(batch.constData(), 1, static_cast<size_t>(batch.size()), stdout);
+    std::fflush(stdout);
+}
 
-    QString txt = QString("[%1] [Thread: %2] [%3]%4 %5")
-                      .arg(QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss.zzz"))
-                      .arg(reinterpret_cast<quint64>(QThread::currentThreadId()))
-                      .arg(level)
-                      .arg(contextInfo)
-                      .arg(msg);
+void Logger::messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    Logger* logger = self;
+    if (!logger)
+        return;
 
-    if (self->logFile.isOpen()) {
-        QTextStream stream(&self->logFile);
-        stream << txt << "\n";
+    if (type == QtFatalMsg) {
+        // Сначала всё, что уже в очереди, затем само сообщение - синхронно, поток записи может не успеть
+        flush();
+        Record record;
+        record.size = static_cast<qint32>(format(record.text, kRecordBytes, type, context, msg));
+        logger->writeBatch(QByteArray::fromRawData(record.text, record.size));
+        abort();
     }
 
-    std::cout << txt.toLocal8Bit().constData() << std::endl;
+    if (rank(type) < logger->_level.load(std::memory_order_relaxed))
+        return;
+
+    quint32 index = 0;
+    if (!logger->_free.tryPop(index)) {
+        logger->_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Record& record = logger->_records[index];
+    record.size = static_cast<qint32>(format(record.text, kRecordBytes, type, context, msg));
+    // Номеров столько же, сколько мест в очереди: push не может не пройти
+    logger->_ready.tryPush(index);
+    logger->_accepted.fetch_add(1);
 
-    if (type == QtFatalMsg) abort();
+    // Важное - сразу, остальное поток записи заберёт сам в пределах kWriterIdleMs
+    if (rank(type) >= rank(QtWarningMsg) || logger->_ready.size() >= kRecordCount / 2)
+        logger->_wake.wakeOne();
 }
@@ -2,23 +2,74 @@
 #define LOGGER_H
 
 #include <QFile>
-#include <QTextStream>
-#include <QDateTime>
+#include <QLoggingCategory>
 #include <QMutex>
+#include <QString>
 #include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+#include "blockring.h"
 
+// Сообщения горячего пути (по блоку и чаще): qCDebug(lcPipeline) при выключенном
+// уровне не вычисляет даже аргументы, в отличие от qDebug()
+Q_DECLARE_LOGGING_CATEGORY(lcPipeline)
+
+// Асинхронный обработчик qDebug/qInfo/...: поток, который логирует, только
+// форматирует строку в заранее выделенную запись и кладёт её номер в lock-free
+// очередь. Фоновый поток пишет записи пачками в файл и stdout.
+// Если очередь полна, сообщение отбрасывается (в лог попадает их число), кроме fatal.
 class Logger {
 public:
-    static void init(const QString& logPath);
+    static void init(const QString& logPath, QtMsgType level = QtDebugMsg);
+
+    // Сообщения ниже level отбрасываются до форматирования; можно менять на лету
+    static void setLevel(QtMsgType level);
+    static QtMsgType level();
+    // debug, info, warning, critical
+    static bool parseLevel(const QString& name, QtMsgType& level);
+
+    // Дожидается, пока всё принятое к этому моменту окажется в файле
+    static void flush();
 
 private:
+    static constexpr qsizetype kRecordBytes = 512;      // длиннее - обрезается
+    static constexpr qsizetype kRecordCount = 1024;
+    static constexpr qsizetype kWriteBatchBytes = 64 * 1024;
+    static constexpr qint32 kWriterIdleMs = 20;
+
+    struct Record {
+        qint32 size = 0;
+        char text[kRecordBytes];
+    };
+
     QFile logFile;
     static Logger* self;
-    QMutex mutex;
+
+    std::unique_ptr<Record[]> _records;
+    BlockRing<quint32> _free;               // пишет только фоновый поток
+    BlockRing<quint32, false> _ready;       // пишут все логирующие потоки
+    std::atomic<int> _level;                // ранг, см. rank()
+    std::atomic<quint64> _dropped;
+    std::atomic<quint64> _accepted;
+    std::atomic<quint64> _written;
+    std::atomic<bool> _stopping;
+    QMutex _wakeMutex;
+    QWaitCondition _wake;
+    QWaitCondition _flushed;
+    QThread* _writer;
 
     Logger(const QString& path);
     ~Logger();
 
+    static int rank(QtMsgType type) noexcept;
+    static void applyCategoryFilter(QtMsgType level);
+    // Пишет в buffer одну строку лога с переводом строки, возвращает её длину
+    static qsizetype format(char* buffer, qsizetype capacity, QtMsgType type,
+                            const QMessageLogContext& context, const QString& msg);
+    void writerLoop();
+    void writeBatch(const QByteArray& batch);
+
     static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg);
 };
 
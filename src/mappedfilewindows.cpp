@@ -0,0 +1,307 @@
+#include "mappedfilewindows.h"
+#include <QDebug>
+#include <QMutexLocker>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+enum class Advice {
+    Sequential,
+    WillNeed,
+    DontNeed
+};
+
+// На платформах без madvise подсказки просто не даются
+void advise(const uchar* data, qint64 length, Advice advice)
+{
+#ifdef Q_OS_UNIX
+    static const quintptr pageSize = static_cast<quintptr>(sysconf(_SC_PAGESIZE));
+    if (length <= 0)
+        return;
+
+    quintptr from = reinterpret_cast<quintptr>(data);
+    quintptr to = from + static_cast<quintptr>(length);
+    if (advice == Advice::DontNeed) {
+        // Только страницы целиком внутри куска: крайние делим с соседями
+        from = (from + pageSize - 1) & ~(pageSize - 1);
+        to &= ~(pageSize - 1);
+    } else {
+        // QFile::map отображает с начала страницы, так что выравнивание вниз безопасно
+        from &= ~(pageSize - 1);
+    }
+    if (to <= from)
+        return;
+
+    int flag = MADV_SEQUENTIAL;
+    if (advice == Advice::WillNeed)
+        flag = MADV_WILLNEED;
+    else if (advice == Advice::DontNeed)
+        flag = MADV_DONTNEED;
+
+    if (madvise(reinterpret_cast<void*>(from), to - from, flag) != 0)
+        qDebug() << "madvise failed, advice" << static_cast<int>(advice);
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(length);
+    Q_UNUSED(advice);
+#endif
+}
+
+#ifdef Q_OS_UNIX
+quint64 statId(const struct stat& st)
+{
+    return (static_cast<quint64>(st.st_dev) << 40) ^ static_cast<quint64>(st.st_ino);
+}
+#endif
+
+} // namespace
+
+MappedFileWindows::MappedFileWindows(qint64 windowSize, qint64 budget, qint64 readAhead)
+    : _fileSize(0), _fileId(0), _windowSize(qMax<qint64>(1, windowSize)),
+      _budget(qMax<qint64>(1, budget)), _readAhead(qMax<qint64>(0, readAhead)),
+      _mapped(0), _peakMapped(0)
+{
+}
+
+MappedFileWindows::~MappedFileWindows()
+{
+    QMutexLocker locker(&_mutex);
+    while (!_windows.empty())
+        unmapWindow(_windows.size() - 1);
+}
+
+bool MappedFileWindows::open(const QString& path)
+{
+    QMutexLocker locker(&_mutex);
+    retireWindows();
+
+    auto file = std::make_shared<QFile>(path);
+    if (!file->open(QIODevice::ReadOnly)) {
+        _error = file->errorString();
+        _file.reset();
+        _fileSize = 0;
+        _fileId = 0;
+        return false;
+    }
+
+    _file = std::move(file);
+    _fileSize = _file->size();
+    _fileId = 0;
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (fstat(_file->handle(), &st) == 0)
+        _fileId = statId(st);
+#endif
+    _error.clear();
+    _peakMapped = _mapped;
+    return true;
+}
+
+void MappedFileWindows::close()
+{
+    QMutexLocker locker(&_mutex);
+    _file.reset();
+    _fileSize = 0;
+    _fileId = 0;
+    retireWindows();
+}
+
+bool MappedFileWindows::isOpen() const
+{
+    QMutexLocker locker(&_mutex);
+    return _file != nullptr;
+}
+
+qint64 MappedFileWindows::fileSize() const
+{
+    QMutexLocker locker(&_mutex);
+    return _fileSize;
+}
+
+qint64 MappedFileWindows::refreshSize()
+{
+    QMutexLocker locker(&_mutex);
+    if (_file)
+        _fileSize = _file->size();
+    return _fileSize;
+}
+
+quint64 MappedFileWindows::fileId() const
+{
+    QMutexLocker locker(&_mutex);
+    return _fileId;
+}
+
+quint64 MappedFileWindows::fileIdOf(const QString& path)
+{
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (stat(QFile::encodeName(path).constData(), &st) == 0)
+        return statId(st);
+#else
+    Q_UNUSED(path);
+#endif
+    return 0;
+}
+
+QString MappedFileWindows::errorString() const
+{
+    QMutexLocker locker(&_mutex);
+    return _error;
+}
+
+MappedFileWindows::Status MappedFileWindows::acquire(qint64 offset, qint64 length, QByteArrayView& view)
+{
+    QMutexLocker locker(&_mutex);
+    if (!_file || offset < 0 || offset >= _fileSize) {
+        _error = "Mapping requested outside of the file";
+        return Status::Failed;
+    }
+    length = qMin(length, _fileSize - offset);
+
+    if (!_windows.empty() && !_windows.back().retired) {
+        Window& current = _windows.back();
+        if (offset >= current.offset && offset + length <= current.offset + current.size) {
+            ++current.refs;
+            const uchar* data = current.data + (offset - current.offset);
+            view = QByteArrayView(reinterpret_cast<const char*>(data), length);
+
+            const qint64 windowEnd = current.offset + current.size;
+            advise(data + length, qMin(_readAhead, windowEnd - offset - length), Advice::WillNeed);
+            return Status::Ok;
+        }
+
+        // Читатель вышел за окно и назад не вернётся
+        current.retired = true;
+        if (!current.refs)
+            unmapWindow(_windows.size() - 1);
+    }
+
+    const qint64 size = qMin(qMax(_windowSize, length), _fileSize - offset);
+    if (_mapped > 0 && _mapped + size > _budget)
+        return Status::OverBudget;
+
+    uchar* data = _file->map(offset, size);
+    if (!data) {
+        _error = _file->errorString();
+        return Status::Failed;
+    }
+
+    advise(data, size, Advice::Sequential);
+    advise(data + length, qMin(_readAhead, size - length), Advice::WillNeed);
+
+    _windows.push_back({_file, data, offset, size, 1, false});
+    _mapped += size;
+    _peakMapped = qMax(_peakMapped, _mapped);
+
+    view = QByteArrayView(reinterpret_cast<const char*>(data), length);
+    return Status::Ok;
+}
+
+bool MappedFileWindows::release(QByteArrayView view, bool dropPages)
+{
+    QMutexLocker locker(&_mutex);
+    const uchar* data = reinterpret_cast<const uchar*>(view.data());
+
+    for (size_t i = 0; i < _windows.size(); ++i) {
+        Window& window = _windows[i];
+        if (data < window.data || data >= window.data + window.size)
+            continue;
+
+        if (--window.refs == 0 && window.retired) {
+            unmapWindow(i);
+            return true;
+        }
+        if (dropPages)
+            advise(data, view.size(), Advice::DontNeed);
+        return false;
+    }
+
+    qWarning() << "Released block does not belong to any mapped window";
+    return false;
+}
+
+qint64 MappedFileWindows::copy(qint64 offset, qint64 length, QByteArray& out)
+{
+    std::shared_ptr<QFile> file;
+    {
+        QMutexLocker locker(&_mutex);
+        file = _file;
+    }
+    if (!file || offset < 0 || length < 0) {
+        QMutexLocker locker(&_mutex);
+        _error = "Read requested outside of the file";
+        return -1;
+    }
+
+    out.resize(length);
+    qint64 total = 0;
+#ifdef Q_OS_UNIX
+    // pread за текущим концом файла просто вернёт меньше, в отличие от страниц отображения
+    while (total < length) {
+        const ssize_t n = ::pread(file->handle(), out.data() + total, static_cast<size_t>(length - total),
+                                  offset + total);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            QMutexLocker locker(&_mutex);
+            _error = QString::fromLocal8Bit(std::strerror(errno));
+            return -1;
+        }
+        if (n == 0)
+            break;
+        total += n;
+    }
+#else
+    total = file->seek(offset) ? file->read(out.data(), length) : -1;
+    if (total < 0) {
+        QMutexLocker locker(&_mutex);
+        _error = file->errorString();
+        return -1;
+    }
+#endif
+    out.truncate(total);
+    return total;
+}
+
+void MappedFileWindows::setReadAhead(qint64 readAhead)
+{
+    QMutexLocker locker(&_mutex);
+    _readAhead = qMax<qint64>(0, readAhead);
+}
+
+qint64 MappedFileWindows::mappedBytes() const
+{
+    QMutexLocker locker(&_mutex);
+    return _mapped;
+}
+
+qint64 MappedFileWindows::peakMappedBytes() const
+{
+    QMutexLocker locker(&_mutex);
+    return _peakMapped;
+}
+
+void MappedFileWindows::unmapWindow(size_t index)
+{
+    Window& window = _windows[index];
+    window.file->unmap(window.data);
+    _mapped -= window.size;
+    _windows.erase(_windows.begin() + static_cast<std::ptrdiff_t>(index));
+}
+
+void MappedFileWindows::retireWindows()
+{
+    for (size_t i = _windows.size(); i > 0; --i) {
+        _windows[i - 1].retired = true;
+        if (!_windows[i - 1].refs)
+            unmapWindow(i - 1);
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef MAPPEDFILEWINDOWS_H
+#define MAPPEDFILEWINDOWS_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <memory>
+#include <vector>
+
+// Отображение файла в память большими скользящими окнами.
+// Читатель берёт куски через acquire(), каждый кусок целиком лежит в одном окне.
+// Окно отмапливается, когда читатель ушёл дальше и все выданные из него куски
+// вернули через release(). Суммарный объём отображённых окон не превышает budget
+// (если только одиночный кусок не больше бюджета). Страницы уже разобранных
+// кусков сразу отдаются системе через MADV_DONTNEED, так что RSS не растёт
+// и внутри одного большого окна.
+class MappedFileWindows
+{
+public:
+    enum class Status {
+        Ok,
+        OverBudget,     // нужно новое окно, но бюджет занят - ждать release()
+        Failed
+    };
+
+    MappedFileWindows(qint64 windowSize, qint64 budget, qint64 readAhead);
+    ~MappedFileWindows();
+
+    MappedFileWindows(const MappedFileWindows&) = delete;
+    MappedFileWindows& operator=(const MappedFileWindows&) = delete;
+
+    bool open(const QString& path);
+    // Окна, из которых ещё не вернули куски, отмапятся при последнем release()
+    void close();
+    bool isOpen() const;
+    qint64 fileSize() const;
+    QString errorString() const;
+
+    // Для дописываемых файлов: перечитать размер открытого файла.
+    // Уже выданные куски не меняются; окна за старым концом маппятся при следующем acquire()
+    qint64 refreshSize();
+    // Идентификатор открытого файла (устройство + inode), 0 - неизвестен.
+    // Отличие от fileIdOf(path) значит, что по пути уже лежит другой файл (ротация)
+    quint64 fileId() const;
+    static quint64 fileIdOf(const QString& path);
+
+    Status acquire(qint64 offset, qint64 length, QByteArrayView& view);
+    // dropPages = false - кусок не разбирали, его страницы ещё понадобятся.
+    // Возвращает true, если освободилось окно.
+    bool release(QByteArrayView view, bool dropPages = true);
+
+    // Копия куска в out без отображения (режим follow): файл могут усечь, пока кусок
+    // разбирают. Возвращает число прочитанных байт (меньше length у конца файла), -1 - ошибка
+    qint64 copy(qint64 offset, qint64 length, QByteArray& out);
+
+    // Сколько байт после выданного куска подсказывать ядру заранее (MADV_WILLNEED)
+    void setReadAhead(qint64 readAhead);
+
+    qint64 mappedBytes() const;
+    qint64 peakMappedBytes() const;
+
+private:
+    struct Window {
+        std::shared_ptr<QFile> file;    // файл закрывается вместе с последним окном
+        uchar* data;
+        qint64 offset;
+        qint64 size;
+        qint32 refs;
+        bool retired;                   // читатель из него больше не берёт
+    };
+
+    void unmapWindow(size_t index);
+    void retireWindows();
+
+    mutable QMutex _mutex;
+    std::shared_ptr<QFile> _file;
+    qint64 _fileSize;
+    quint64 _fileId;
+    QString _error;
+
+    std::vector<Window> _windows;
+    qint64 _windowSize;
+    qint64 _budget;
+    qint64 _readAhead;
+    qint64 _mapped;
+    qint64 _peakMapped;
+};
+
+#endif // MAPPEDFILEWINDOWS_H
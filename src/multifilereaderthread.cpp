@@ -0,0 +1,499 @@
+#include "multifilereaderthread.h"
+#include "tracer.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+MultiFileReaderThread::MultiFileReaderThread(const QStringList& inputs, const Config& config, QObject* parent)
+    : QThread{parent}, RingDataProvider(config.max_chunks_in_mem_num),
+      _inputs(inputs), _totalBytes(0), _config(config), _separators(config.word_separators),
+      _nextFile(0), _activeIo(0), _cancel(false), _running(false)
+{
+    _ioPool = new QThreadPool(this);
+    _ioPool->setMaxThreadCount(_config.file_reader_threads);
+
+    this->moveToThread(this);
+}
+
+MultiFileReaderThread::~MultiFileReaderThread()
+{
+    qInfo() << "MultiFileReaderThread is being destroyed";
+    stopWorkers();
+    if (isRunning()) {
+        quit();
+        if (!wait(3000)) {
+            qCritical() << "MultiFileReaderThread did not stop gracefully, terminating.";
+            terminate();
+        }
+    }
+}
+
+QStringList MultiFileReaderThread::expandInputs(const QStringList& inputs, const QStringList& nameFilters,
+                                                QString* error)
+{
+    QStringList files;
+    QSet<QString> seen;
+    const auto addFile = [&files, &seen](const QFileInfo& info) {
+        const QString path = info.canonicalFilePath();
+        if (!path.isEmpty() && !seen.contains(path)) {
+            seen.insert(path);
+            files << path;
+        }
+    };
+
+    for (const QString& input : inputs) {
+        if (input.startsWith('@')) {
+            QFile list(input.mid(1));
+            if (!list.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                if (error)
+                    *error = "Cannot open file list " + list.fileName() + ": " + list.errorString();
+                return {};
+            }
+            // Пустые строки, комментарии и вложенные списки пропускаются
+            QStringList listed;
+            while (!list.atEnd()) {
+                const QString line = QString::fromUtf8(list.readLine()).trimmed();
+                if (!line.isEmpty() && !line.startsWith('#') && !line.startsWith('@'))
+                    listed << line;
+            }
+            const QStringList nested = expandInputs(listed, nameFilters, error);
+            if (error && !error->isEmpty())
+                return {};
+            for (const QString& path : nested)
+                addFile(QFileInfo(path));
+            continue;
+        }
+
+        const QFileInfo info(input);
+        if (info.isDir()) {
+            QDirIterator it(info.absoluteFilePath(), nameFilters, QDir::Files | QDir::NoDotAndDotDot,
+                            QDirIterator::Subdirectories);
+            QStringList found;
+            while (it.hasNext())
+                found << it.next();
+            // Порядок обхода зависит от файловой системы
+            found.sort();
+            for (const QString& path : found)
+                addFile(QFileInfo(path));
+        } else if (info.isFile()) {
+            addFile(info);
+        } else if (input.contains('*') || input.contains('?') || input.contains('[')) {
+            const QDir dir(info.path());
+            const QFileInfoList matches = dir.entryInfoList({info.fileName()}, QDir::Files, QDir::Name);
+            for (const QFileInfo& match : matches)
+                addFile(match);
+        } else {
+            if (error)
+                *error = "No such file or directory: " + input;
+            return {};
+        }
+    }
+    return files;
+}
+
+const QStringList& MultiFileReaderThread::getFiles() const noexcept
+{
+    return _files;
+}
+
+quint64 MultiFileReaderThread::getTotalBytes() const noexcept
+{
+    return _totalBytes;
+}
+
+void MultiFileReaderThread::releaseDataBlock(QByteArrayView block)
+{
+    qint32 buffer = -1;
+    {
+        QMutexLocker locker(&_segmentMutex);
+        const auto it = _segments.find(block.data());
+        if (it == _segments.end()) {
+            qWarning() << "Released block does not belong to any buffer";
+            return;
+        }
+        buffer = it->buffer;
+        _segments.erase(it);
+    }
+    releaseBuffer(buffer);
+}
+
+qint32 MultiFileReaderThread::blockSource(QByteArrayView block) const
+{
+    QMutexLocker locker(&_segmentMutex);
+    const auto it = _segments.constFind(block.data());
+    return it == _segments.cend() ? -1 : it->source;
+}
+
+QString MultiFileReaderThread::sourceName(qint32 source) const
+{
+    return _files.value(source);
+}
+
+qint32 MultiFileReaderThread::sourceBlockCount(QByteArrayView block) const
+{
+    QMutexLocker locker(&_segmentMutex);
+    const auto it = _segments.constFind(block.data());
+    return it == _segments.cend() ? 0 : it->sourceBlocks;
+}
+
+qint64 MultiFileReaderThread::blockInputBytes(QByteArrayView block) const
+{
+    QMutexLocker locker(&_segmentMutex);
+    const auto it = _segments.constFind(block.data());
+    return it == _segments.cend() ? block.size() : it->inputBytes;
+}
+
+void MultiFileReaderThread::startReading()
+{
+    if (_running) {
+        qWarning() << "Attempt to start reading while already running.";
+        return;
+    }
+    stopWorkers();
+
+    QStringList filters;
+    for (const QString& filter : _config.input_name_filters.split(';', Qt::SkipEmptyParts))
+        filters << filter.trimmed();
+
+    QString error;
+    QStringList files = expandInputs(_inputs, filters, &error);
+    if (error.isEmpty() && files.isEmpty())
+        error = "No input files found";
+    if (!error.isEmpty()) {
+        qCritical() << error;
+        emit readingError(error);
+        return;
+    }
+
+    // Большие файлы первыми: к концу остаются мелкие, и воркеры заканчивают почти одновременно
+    std::vector<qint64> sizes(static_cast<size_t>(files.size()));
+    for (qsizetype i = 0; i < files.size(); ++i)
+        sizes[static_cast<size_t>(i)] = QFileInfo(files[i]).size();
+    std::vector<qsizetype> order(sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sizes](qsizetype a, qsizetype b) {
+        return sizes[static_cast<size_t>(a)] > sizes[static_cast<size_t>(b)];
+    });
+
+    _files.clear();
+    _totalBytes = 0;
+    for (qsizetype index : order) {
+        _files << files[index];
+        _totalBytes += static_cast<quint64>(sizes[static_cast<size_t>(index)]);
+    }
+    qInfo() << "Reading" << _files.size() << "files," << _totalBytes << "bytes";
+    emit totalSizeChanged(_totalBytes);
+
+    const qsizetype bufferCount = _config.max_chunks_in_mem_num + _config.file_reader_threads;
+    {
+        QMutexLocker locker(&_bufferMutex);
+        _buffers.resize(static_cast<size_t>(bufferCount));
+        for (QByteArray& buffer : _buffers) {
+            if (buffer.size() < _config.chunk_size_bytes)
+                buffer = QByteArray(_config.chunk_size_bytes, Qt::Uninitialized);
+        }
+        _bufferRefs.assign(static_cast<size_t>(bufferCount), 0);
+        _freeBuffers.resize(static_cast<size_t>(bufferCount));
+        std::iota(_freeBuffers.begin(), _freeBuffers.end(), 0);
+    }
+    {
+        QMutexLocker locker(&_segmentMutex);
+        _ready.clear();
+        _segments.clear();
+    }
+
+    _nextFile = 0;
+    _cancel = false;
+    _running = true;
+    reopenData();
+
+    const qint32 workers = static_cast<qint32>(qMin<qsizetype>(_config.file_reader_threads, _files.size()));
+    _activeIo = workers;
+    for (qint32 i = 0; i < workers; ++i)
+        _ioPool->start([this]() { ioWorker(); });
+}
+
+void MultiFileReaderThread::cancelReading()
+{
+    qInfo() << "Canceling multi-file reading.";
+    stopWorkers();
+    _running = false;
+
+    // Блоки, которые уже разбирают анализаторы, вернут свои буферы сами
+    QByteArrayView blocks[8];
+    qsizetype sizeBefore = 0;
+    while (const qsizetype taken = takeDataBlocks(blocks, 8, sizeBefore)) {
+        for (qsizetype i = 0; i < taken; ++i)
+            releaseDataBlock(blocks[i]);
+    }
+    std::deque<Segment> ready;
+    {
+        QMutexLocker locker(&_segmentMutex);
+        ready.swap(_ready);
+    }
+    for (const Segment& segment : ready)
+        releaseDataBlock(segment.view);
+    closeData();
+}
+
+void MultiFileReaderThread::readChunk()
+{
+    if (!_running)
+        return;
+
+    TraceSpan span("readChunk");
+    while (true) {
+        // При полной очереди чтение продолжит onSpaceFreed()
+        if (!waitForSpace(_config.max_chunks_in_mem_num))
+            return;
+
+        Segment segment;
+        {
+            QMutexLocker locker(&_segmentMutex);
+            if (_ready.empty())
+                break;
+            segment = _ready.front();
+            _ready.pop_front();
+        }
+        // Место проверено waitForSpace, а производитель у кольца один - этот поток
+        pushDataBlock(segment.view);
+        emit chunkIsReady();
+    }
+
+    // Последний воркер вызывает triggerRead() уже после своей последней публикации
+    if (_activeIo.load() != 0)
+        return;
+    {
+        QMutexLocker locker(&_segmentMutex);
+        if (!_ready.empty())
+            return;
+    }
+
+    _running = false;
+    qInfo() << "All input files read.";
+    closeData();
+    emit readingFinished();
+}
+
+void MultiFileReaderThread::run()
+{
+    exec();
+}
+
+void MultiFileReaderThread::onSpaceFreed()
+{
+    triggerRead();
+}
+
+void MultiFileReaderThread::triggerRead()
+{
+    QMetaObject::invokeMethod(this, &MultiFileReaderThread::readChunk, Qt::QueuedConnection);
+}
+
+void MultiFileReaderThread::ioWorker()
+{
+    // Мелкие файлы копятся в одном буфере, каждый отдельным сегментом
+    std::vector<Segment> pack;
+    qint32 packBuffer = -1;
+    qint64 packUsed = 0;
+    const auto flushPack = [this, &pack, &packBuffer, &packUsed]() {
+        if (packBuffer < 0)
+            return;
+        if (pack.empty())
+            releaseBuffer(packBuffer);
+        else
+            publish(pack);
+        pack.clear();
+        packBuffer = -1;
+        packUsed = 0;
+    };
+
+    while (!_cancel) {
+        const qint32 source = _nextFile.fetch_add(1);
+        if (source >= _files.size())
+            break;
+
+        QFile file(_files[source]);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Skipping unreadable file" << file.fileName() << file.errorString();
+            continue;
+        }
+        const qint64 size = file.size();
+        if (size == 0)
+            continue;
+
+        // Сжатый файл всегда читается потоком: его настоящий размер заранее не известен
+        const StreamDecoder::Format format = StreamDecoder::detect(file);
+        std::unique_ptr<StreamDecoder> decoder;
+        if (format != StreamDecoder::Format::Plain) {
+            QString error;
+            decoder = StreamDecoder::create(format, file, &error);
+            if (!decoder) {
+                qWarning() << "Skipping" << file.fileName() << error;
+                continue;
+            }
+        }
+
+        if (decoder || size > _config.small_file_bytes) {
+            flushPack();
+            if (!readLargeFile(file, source, decoder.get()))
+                break;
+            continue;
+        }
+
+        if (packBuffer >= 0 && packUsed + size > _buffers[static_cast<size_t>(packBuffer)].size())
+            flushPack();
+        if (packBuffer < 0) {
+            packBuffer = acquireBuffer();
+            if (packBuffer < 0)
+                break;
+        }
+
+        // Буфер растёт, только пока пуст: на уже набранные сегменты есть view
+        QByteArray& buffer = _buffers[static_cast<size_t>(packBuffer)];
+        if (buffer.size() < size)
+            buffer.resize(size);
+        const qint64 n = file.read(buffer.data() + packUsed, size);
+        if (n < 0) {
+            qWarning() << "Read failed:" << file.fileName() << file.errorString();
+            continue;
+        }
+        if (n > 0) {
+            pack.push_back({QByteArrayView(buffer.constData() + packUsed, n), packBuffer, source, n, 1});
+            packUsed += n;
+        }
+    }
+    flushPack();
+
+    if (_activeIo.fetch_sub(1) == 1)
+        triggerRead();
+}
+
+bool MultiFileReaderThread::readLargeFile(QFile& file, qint32 source, StreamDecoder* decoder)
+{
+    // Хвост после последнего разделителя переносится в начало следующего буфера
+    QByteArray carry;
+    qint64 reported = 0;
+    qint32 published = 0;
+    while (!_cancel) {
+        const qint32 index = acquireBuffer();
+        if (index < 0)
+            return false;
+        TraceSpan blockSpan("readBlock", "source", source);
+
+        QByteArray& buffer = _buffers[static_cast<size_t>(index)];
+        if (buffer.size() < carry.size() + _config.chunk_size_bytes)
+            buffer.resize(carry.size() + _config.chunk_size_bytes);
+        if (!carry.isEmpty())
+            std::memcpy(buffer.data(), carry.constData(), static_cast<size_t>(carry.size()));
+        qint64 filled = carry.size();
+        carry.clear();
+
+        bool eof = false;
+        qsizetype cutPos = -1;
+        while (true) {
+            const qint64 n = decoder ? decoder->read(buffer.data() + filled, buffer.size() - filled)
+                                     : file.read(buffer.data() + filled, buffer.size() - filled);
+            if (n < 0) {
+                qWarning() << "Read failed:" << file.fileName()
+                           << (decoder ? decoder->errorString() : file.errorString());
+                eof = true;
+                break;
+            }
+            filled += n;
+            if (n == 0 || (!decoder && file.atEnd())) {
+                eof = true;
+                break;
+            }
+            if (filled < buffer.size())
+                continue;
+
+            cutPos = _separators.findLast(QByteArrayView(buffer.constData(), filled));
+            if (cutPos >= 0)
+                break;
+            // Слово длиннее буфера: буфер удваивается, как кусок в FileReaderThread
+            buffer.resize(buffer.size() * 2);
+        }
+
+        qint64 length = filled;
+        if (!eof) {
+            carry = QByteArray(buffer.constData() + cutPos + 1, filled - cutPos - 1);
+            length = cutPos + 1;
+        }
+        // Сжатые байты, ушедшие в распаковщик с прошлого блока, достаются этому блоку
+        qint64 inputBytes = length;
+        if (decoder) {
+            inputBytes = (eof ? file.size() : decoder->consumed()) - reported;
+            reported += inputBytes;
+        }
+        // Пустой блок тоже отдаём, если на нём остался хвост сжатого файла: иначе прогресс не дойдёт до 100%.
+        // И если он последний: по нему анализатор узнаёт, что файл кончился
+        if (length > 0 || inputBytes > 0 || (eof && published > 0)) {
+            ++published;
+            publish({{QByteArrayView(buffer.constData(), length), index, source, inputBytes, eof ? published : 0}});
+        } else {
+            releaseBuffer(index);
+        }
+
+        if (eof)
+            return true;
+    }
+    return false;
+}
+
+qint32 MultiFileReaderThread::acquireBuffer()
+{
+    TraceSpan span("acquireBuffer");
+    QMutexLocker locker(&_bufferMutex);
+    if (_freeBuffers.empty())
+        markProducerStalled();
+    while (_freeBuffers.empty() && !_cancel)
+        _bufferFreed.wait(&_bufferMutex);
+    if (_cancel)
+        return -1;
+    const qint32 index = _freeBuffers.back();
+    _freeBuffers.pop_back();
+    return index;
+}
+
+void MultiFileReaderThread::releaseBuffer(qint32 buffer)
+{
+    QMutexLocker locker(&_bufferMutex);
+    qint32& refs = _bufferRefs[static_cast<size_t>(buffer)];
+    if (--refs > 0)
+        return;
+    refs = 0;
+    _freeBuffers.push_back(buffer);
+    _bufferFreed.wakeOne();
+}
+
+void MultiFileReaderThread::publish(const std::vector<Segment>& segments)
+{
+    {
+        QMutexLocker locker(&_bufferMutex);
+        _bufferRefs[static_cast<size_t>(segments.front().buffer)] = static_cast<qint32>(segments.size());
+    }
+    {
+        QMutexLocker locker(&_segmentMutex);
+        for (const Segment& segment : segments) {
+            _segments.insert(segment.view.data(), segment);
+            _ready.push_back(segment);
+        }
+    }
+    triggerRead();
+}
+
+void MultiFileReaderThread::stopWorkers()
+{
+    {
+        QMutexLocker locker(&_bufferMutex);
+        _cancel = true;
+        _bufferFreed.wakeAll();
+    }
+    _ioPool->waitForDone();
+}
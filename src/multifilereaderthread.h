@@ -0,0 +1,109 @@
+#ifndef MULTIFILEREADERTHREAD_H
+#define MULTIFILEREADERTHREAD_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include "config.h"
+#include "ringdataprovider.h"
+#include "byteclassifier.h"
+#include "streamdecoder.h"
+
+// Источник блоков для множества файлов (каталог, маски, список).
+// Файлы читают file_reader_threads воркеров в общий пул буферов: большие -
+// кусками по chunk_size_bytes с разрезом по разделителю, мелкие (до
+// small_file_bytes) - по нескольку в один буфер, чтобы не платить за каждый
+// файл отдельным блоком очереди. Каждый файл внутри буфера остаётся отдельным
+// блоком, так что слова на стыке файлов не склеиваются, а blockSource()
+// знает, откуда блок. Буферов max_chunks_in_mem_num + file_reader_threads,
+// память от числа и размера файлов не зависит. В кольцо блоки кладёт только
+// поток читателя, воркеры отдают ему готовые буферы.
+// Файлы .gz и .zst (по сигнатуре) распаковываются воркером на лету в те же
+// буферы; прогресс и totalSizeChanged считаются в сжатых байтах.
+class MultiFileReaderThread : public QThread, public RingDataProvider
+{
+    Q_OBJECT
+public:
+    MultiFileReaderThread(const QStringList& inputs, const Config& config, QObject* parent = nullptr);
+    ~MultiFileReaderThread();
+
+    // Каталог - все файлы в нём рекурсивно (по nameFilters), "@list.txt" - пути
+    // построчно, маска вроде "logs/*.log" - совпавшие файлы. Повторы убираются.
+    static QStringList expandInputs(const QStringList& inputs, const QStringList& nameFilters,
+                                    QString* error = nullptr);
+
+    const QStringList& getFiles() const noexcept;
+    quint64 getTotalBytes() const noexcept;
+
+    void releaseDataBlock(QByteArrayView block) override;
+    qint32 blockSource(QByteArrayView block) const override;
+    QString sourceName(qint32 source) const override;
+    qint32 sourceBlockCount(QByteArrayView block) const override;
+    qint64 blockInputBytes(QByteArrayView block) const override;
+
+public slots:
+    void startReading();
+    void cancelReading();
+    void readChunk();
+
+signals:
+    void chunkIsReady();
+    void readingFinished();
+    void readingError(const QString& error);
+    void totalSizeChanged(quint64 totalSize);
+
+protected:
+    void run() override;
+    void onSpaceFreed() override;
+
+private:
+    struct Segment {
+        QByteArrayView view;
+        qint32 buffer;
+        qint32 source;
+        qint64 inputBytes;
+        qint32 sourceBlocks;        // у последнего блока файла - число его блоков, иначе 0
+    };
+
+    void triggerRead();
+    void ioWorker();
+    qint32 acquireBuffer();
+    void releaseBuffer(qint32 buffer);
+    void publish(const std::vector<Segment>& segments);
+    bool readLargeFile(QFile& file, qint32 source, StreamDecoder* decoder);
+    void stopWorkers();
+
+    QStringList _inputs;
+    QStringList _files;
+    quint64 _totalBytes;
+
+    const Config& _config;
+    ByteClassifier _separators;
+
+    QThreadPool* _ioPool;
+    std::atomic<qint32> _nextFile;
+    std::atomic<qint32> _activeIo;
+    std::atomic<bool> _cancel;
+    bool _running;
+
+    // Буферы и их свободный список; буфер принадлежит воркеру от acquire до publish
+    std::vector<QByteArray> _buffers;
+    std::vector<qint32> _bufferRefs;
+    std::vector<qint32> _freeBuffers;
+    QMutex _bufferMutex;
+    QWaitCondition _bufferFreed;
+
+    // Готовые, но ещё не положенные в кольцо блоки, и все выданные блоки по адресу
+    std::deque<Segment> _ready;
+    QHash<const char*, Segment> _segments;
+    mutable QMutex _segmentMutex;
+};
+
+#endif // MULTIFILEREADERTHREAD_H
@@ -0,0 +1,88 @@
+#include "ngramstitcher.h"
+#include <QMutexLocker>
+
+NgramStitcher::NgramStitcher(qint32 n) : _n(qMax(1, n)), _nextSequence(0)
+{
+}
+
+NgramStitcher::Link NgramStitcher::next(qint32 source)
+{
+    QMutexLocker locker(&_mutex);
+    Link link;
+    link.sequence = _nextSequence++;
+    auto it = _lastOfSource.find(source);
+    if (it != _lastOfSource.end()) {
+        link.previous = it->second;
+        it->second = link.sequence;
+    } else {
+        _lastOfSource.emplace(source, link.sequence);
+    }
+    return link;
+}
+
+void NgramStitcher::stitch(Link link, const std::vector<quint32>& ids, std::vector<quint32>& out)
+{
+    if (_n < 2)
+        return;
+
+    // Края копируются до блокировки, сам блок дальше не нужен
+    const qsizetype edge = _n - 1;
+    const qsizetype count = static_cast<qsizetype>(ids.size());
+    Edges edges;
+    edges.count = count;
+    edges.head.assign(ids.begin(), ids.begin() + qMin(edge, count));
+    edges.tail.assign(ids.end() - qMin(edge, count), ids.end());
+
+    QMutexLocker locker(&_mutex);
+    std::vector<quint32> carry;
+    if (link.previous >= 0) {
+        auto it = _carries.find(link.previous);
+        if (it == _carries.end()) {
+            _waiting.emplace(link.previous, std::make_pair(link.sequence, std::move(edges)));
+            return;
+        }
+        carry = std::move(it->second);
+        _carries.erase(it);
+    }
+
+    qint64 sequence = link.sequence;
+    while (true) {
+        join(carry, edges, out);
+        auto waiting = _waiting.find(sequence);
+        if (waiting == _waiting.end())
+            break;
+        sequence = waiting->second.first;
+        edges = std::move(waiting->second.second);
+        _waiting.erase(waiting);
+    }
+    _carries.emplace(sequence, std::move(carry));
+}
+
+void NgramStitcher::join(std::vector<quint32>& carry, const Edges& edges, std::vector<quint32>& out) const
+{
+    // Стык: хвост потока и начало блока. Считаются n-граммы, начатые в хвосте
+    std::vector<quint32> joined = carry;
+    joined.insert(joined.end(), edges.head.begin(), edges.head.end());
+    const qsizetype carried = static_cast<qsizetype>(carry.size());
+    for (qsizetype i = 0; i < carried && i + _n <= static_cast<qsizetype>(joined.size()); ++i)
+        out.insert(out.end(), joined.begin() + i, joined.begin() + i + _n);
+
+    const qsizetype edge = _n - 1;
+    if (edges.count >= edge) {
+        carry = edges.tail;
+        return;
+    }
+    // Короткий блок: хвост продолжается через него
+    if (static_cast<qsizetype>(joined.size()) > edge)
+        joined.erase(joined.begin(), joined.end() - edge);
+    carry = std::move(joined);
+}
+
+void NgramStitcher::clear()
+{
+    QMutexLocker locker(&_mutex);
+    _nextSequence = 0;
+    _lastOfSource.clear();
+    _carries.clear();
+    _waiting.clear();
+}
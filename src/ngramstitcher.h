@@ -0,0 +1,55 @@
+#ifndef NGRAMSTITCHER_H
+#define NGRAMSTITCHER_H
+
+#include <QMutex>
+#include <QtGlobal>
+#include <unordered_map>
+#include <vector>
+
+// N-граммы через стык блоков. Воркеры считают блоки в любом порядке и сами
+// находят n-граммы внутри блока; те, что начинаются в прошлых блоках, собирает
+// сшиватель. Ему от блока нужны только края: первые и последние n - 1 номеров
+// слов. Блоки одного источника сшиваются строго по порядку выдачи: хвост
+// последних n - 1 слов потока переходит от блока к следующему, а блок,
+// предшественник которого ещё считается, ждёт его здесь.
+// Блоки разных источников (файлов) не сшиваются.
+class NgramStitcher
+{
+public:
+    // Место блока в потоке своего источника
+    struct Link {
+        qint64 sequence = -1;
+        qint64 previous = -1;   // -1 - первый блок источника
+    };
+
+    explicit NgramStitcher(qint32 n);
+
+    // Выдаёт номер следующему блоку source; вызывать в порядке выдачи блоков
+    Link next(qint32 source);
+    // ids - номера слов блока по порядку. В out дописываются готовые n-граммы через стыки
+    // (по n номеров подряд): этого блока и дождавшихся его следующих
+    void stitch(Link link, const std::vector<quint32>& ids, std::vector<quint32>& out);
+
+    void clear();
+
+private:
+    struct Edges {
+        std::vector<quint32> head;  // первые n - 1 слов (все, если слов меньше)
+        std::vector<quint32> tail;  // последние n - 1
+        qsizetype count = 0;
+    };
+
+    // carry - хвост потока до блока, на выходе - хвост после него
+    void join(std::vector<quint32>& carry, const Edges& edges, std::vector<quint32>& out) const;
+
+    const qsizetype _n;
+    QMutex _mutex;
+    qint64 _nextSequence;
+    std::unordered_map<qint32, qint64> _lastOfSource;
+    // Хвост потока после блока, которого ещё не забрал следующий
+    std::unordered_map<qint64, std::vector<quint32>> _carries;
+    // Блоки, ждущие предшественника: ключ - номер предшественника
+    std::unordered_map<qint64, std::pair<qint64, Edges>> _waiting;
+};
+
+#endif // NGRAMSTITCHER_H
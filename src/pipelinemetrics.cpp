@@ -0,0 +1,37 @@
+#include "pipelinemetrics.h"
+
+QString PipelineMetrics::bottleneck() const
+{
+    if (elapsedMs <= 0)
+        return "balanced";
+    if (readerStalledMs * 2 > elapsedMs)
+        return "cpu";
+    if (analyzerThreads > 0 && analyzerStarvedMs * 2 > static_cast<qint64>(analyzerThreads) * elapsedMs)
+        return "io";
+    return "balanced";
+}
+
+QJsonObject PipelineMetrics::toJson() const
+{
+    QJsonObject obj;
+    obj["elapsed_ms"] = elapsedMs;
+    obj["blocks_read"] = static_cast<qint64>(blocksRead);
+    obj["bytes_read"] = static_cast<qint64>(bytesRead);
+    obj["reader_stalled_ms"] = readerStalledMs;
+    obj["queue_depth"] = queueDepth;
+    obj["queue_capacity"] = queueCapacity;
+    obj["blocks_analyzed"] = static_cast<qint64>(blocksAnalyzed);
+    obj["bytes_analyzed"] = static_cast<qint64>(bytesAnalyzed);
+    obj["tokens"] = static_cast<qint64>(tokens);
+    obj["analyzer_threads"] = analyzerThreads;
+    obj["analyzer_busy_ms"] = analyzerBusyMs;
+    obj["analyzer_starved_ms"] = analyzerStarvedMs;
+    obj["table_words"] = tableWords;
+    obj["table_bytes"] = static_cast<qint64>(tableBytes);
+    obj["read_mb_per_s"] = readBytesPerSec / (1024.0 * 1024.0);
+    obj["analyze_mb_per_s"] = analyzeBytesPerSec / (1024.0 * 1024.0);
+    obj["tokens_per_s"] = tokensPerSec;
+    obj["eta_ms"] = etaMs;
+    obj["bottleneck"] = bottleneck();
+    return obj;
+}
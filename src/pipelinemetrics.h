@@ -0,0 +1,45 @@
+#ifndef PIPELINEMETRICS_H
+#define PIPELINEMETRICS_H
+
+#include <QJsonObject>
+#include <QMetaType>
+#include <QString>
+
+// Срез состояния конвейера "читатель -> очередь -> анализаторы". Счётчики
+// накопительные с startAnalyzis, скорости - за последний интервал метрик.
+// По readerStalledMs и analyzerStarvedMs видно, кто кого ждёт: читатель стоит
+// на полной очереди - не хватает CPU, воркеры простаивают - не хватает чтения.
+struct PipelineMetrics {
+    qint64 elapsedMs = 0;
+
+    // Читатель: байты в блоках очереди (для сжатых файлов - распакованные)
+    quint64 blocksRead = 0;
+    quint64 bytesRead = 0;
+    qint64 readerStalledMs = 0;     // очередь или бюджет отображения полны
+
+    qint64 queueDepth = 0;
+    qint64 queueCapacity = 0;
+
+    quint64 blocksAnalyzed = 0;
+    quint64 bytesAnalyzed = 0;
+    quint64 tokens = 0;
+    qint32 analyzerThreads = 0;
+    qint64 analyzerBusyMs = 0;      // сумма по воркерам
+    qint64 analyzerStarvedMs = 0;   // analyzerThreads * elapsedMs - analyzerBusyMs
+    qint64 tableWords = 0;
+    quint64 tableBytes = 0;
+
+    double readBytesPerSec = 0;
+    double analyzeBytesPerSec = 0;
+    double tokensPerSec = 0;
+    qint64 etaMs = -1;              // -1 - неизвестно (размер не задан или ещё нет скорости)
+
+    // "cpu" - читатель больше половины времени ждёт анализаторы, "io" - воркеры
+    // больше половины времени без блоков, иначе "balanced"
+    QString bottleneck() const;
+    QJsonObject toJson() const;
+};
+
+Q_DECLARE_METATYPE(PipelineMetrics)
+
+#endif // PIPELINEMETRICS_H
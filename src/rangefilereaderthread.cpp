@@ -0,0 +1,277 @@
+#include "rangefilereaderthread.h"
+#include "logger.h"
+#include "tracer.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Отдаёт системе страницы, целиком лежащие внутри [data, data + length)
+void dropPages(const char* data, qint64 length)
+{
+#ifdef Q_OS_UNIX
+    static const quintptr pageSize = static_cast<quintptr>(sysconf(_SC_PAGESIZE));
+    const quintptr from = (reinterpret_cast<quintptr>(data) + pageSize - 1) & ~(pageSize - 1);
+    const quintptr to = (reinterpret_cast<quintptr>(data) + static_cast<quintptr>(length)) & ~(pageSize - 1);
+    if (to > from)
+        madvise(reinterpret_cast<void*>(from), to - from, MADV_DONTNEED);
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(length);
+#endif
+}
+
+} // namespace
+
+RangeFileReaderThread::RangeFileReaderThread(const QString& filePath, const Config& config, QObject* parent)
+    : QThread{parent}, _filePath(filePath), _startPos(0), _separators(config.word_separators),
+      _rangeSize(qMax(kPageSize, (config.chunk_size_bytes + kPageSize - 1) / kPageSize * kPageSize)),
+      _wakeups(qMax(1, config.analyzer_threads)),
+      _data(nullptr), _fileSize(0), _start(0), _firstRange(0), _rangeCount(0), _closed(true), _inUse(0),
+      _nextRange(0), _claimedBlocks(0), _claimedBytes(0)
+{
+    this->moveToThread(this);
+}
+
+RangeFileReaderThread::~RangeFileReaderThread()
+{
+    qInfo() << "RangeFileReaderThread is being destroyed";
+    if (isRunning()) {
+        quit();
+        if (!wait(3000)) {
+            qCritical() << "RangeFileReaderThread did not stop gracefully, terminating.";
+            terminate();
+        }
+    }
+
+    // Анализаторы к этому времени остановлены
+    QMutexLocker locker(&_mapMutex);
+    _closed = true;
+    _inUse = 0;
+    unmapIfIdle();
+}
+
+void RangeFileReaderThread::setFilePath(const QString& filePath)
+{
+    _filePath = filePath;
+}
+
+void RangeFileReaderThread::setStartPos(qint64 pos)
+{
+    _startPos = pos;
+}
+
+bool RangeFileReaderThread::isDataEmpty() const noexcept
+{
+    return _closed.load(std::memory_order_acquire) || _nextRange.load(std::memory_order_relaxed) >= _rangeCount;
+}
+
+qsizetype RangeFileReaderThread::dataSize() const noexcept
+{
+    if (_closed.load(std::memory_order_acquire))
+        return 0;
+    return static_cast<qsizetype>(qMax<qint64>(0, _rangeCount - _nextRange.load(std::memory_order_relaxed)));
+}
+
+QByteArrayView RangeFileReaderThread::getDataBlock()
+{
+    QByteArrayView block;
+    qsizetype sizeBefore = 0;
+    takeDataBlocks(&block, 1, sizeBefore);
+    return block;
+}
+
+qsizetype RangeFileReaderThread::takeDataBlocks(QByteArrayView* blocks, qsizetype max, qsizetype& sizeBefore)
+{
+    sizeBefore = dataSize();
+    qsizetype taken = 0;
+    while (taken < max) {
+        qint64 index;
+        {
+            // Под мьютексом только номер диапазона, границы каждый воркер ищет сам
+            QMutexLocker locker(&_mapMutex);
+            if (_closed)
+                break;
+            index = _nextRange.load(std::memory_order_relaxed);
+            if (index >= _rangeCount)
+                break;
+            _nextRange.store(index + 1, std::memory_order_relaxed);
+            ++_inUse;
+        }
+
+        const QByteArrayView block = blockOf(index);
+        if (block.isEmpty()) {
+            // Диапазон целиком внутри слова соседа
+            releaseDataBlock(block);
+            continue;
+        }
+        _claimedBlocks.fetch_add(1, std::memory_order_relaxed);
+        _claimedBytes.fetch_add(static_cast<quint64>(block.size()), std::memory_order_relaxed);
+        blocks[taken++] = block;
+    }
+    return taken;
+}
+
+bool RangeFileReaderThread::waitForData(qint32 timeoutMs)
+{
+    Q_UNUSED(timeoutMs);
+    return !isDataEmpty();
+}
+
+void RangeFileReaderThread::releaseDataBlock(QByteArrayView block)
+{
+    if (!block.isEmpty())
+        dropPages(block.data(), block.size());
+
+    QMutexLocker locker(&_mapMutex);
+    if (_inUse > 0)
+        --_inUse;
+    const bool closed = _closed.load(std::memory_order_relaxed);
+    const bool idle = _inUse == 0;
+    const bool moreRanges = _nextRange.load(std::memory_order_relaxed) < _rangeCount;
+    const bool finished = unmapIfIdle() && !closed;
+    locker.unlock();
+
+    // Сигналы уходят из потока читателя: release зовут и из потока анализатора,
+    // прямой вызов его слота отсюда ушёл бы в рекурсию
+    if (finished) {
+        // Последний диапазон разобран: анализатору остаётся только итог
+        QMetaObject::invokeMethod(this, [this]() { emit readingFinished(); }, Qt::QueuedConnection);
+    } else if (idle && moreRanges && !closed) {
+        // Пачка разобрана целиком. Воркеры пула сами берут следующие диапазоны,
+        // а единственный воркер анализатора ждёт сигнала на каждую пачку
+        QMetaObject::invokeMethod(this, [this]() { emit chunkIsReady(); }, Qt::QueuedConnection);
+    }
+}
+
+IDataProvider::ProducerStats RangeFileReaderThread::producerStats() const
+{
+    ProducerStats stats;
+    stats.blocks = _claimedBlocks.load(std::memory_order_relaxed);
+    stats.bytes = _claimedBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+qint64 RangeFileReaderThread::wordStart(qint64 pos) const noexcept
+{
+    if (pos <= _start)
+        return _start;
+    if (pos >= _fileSize)
+        return _fileSize;
+    if (_separators.contains(_data[pos - 1]))
+        return pos;
+
+    const QByteArrayView rest(reinterpret_cast<const char*>(_data) + pos, _fileSize - pos);
+    const qsizetype separator = _separators.findFirst(rest);
+    return separator < 0 ? _fileSize : pos + separator + 1;
+}
+
+QByteArrayView RangeFileReaderThread::blockOf(qint64 index) const noexcept
+{
+    TraceSpan span("fixBoundaries", "range", index);
+    const qint64 from = wordStart(_firstRange + index * _rangeSize);
+    const qint64 to = index + 1 < _rangeCount ? wordStart(_firstRange + (index + 1) * _rangeSize) : _fileSize;
+    if (from >= to)
+        return {};
+    return QByteArrayView(reinterpret_cast<const char*>(_data) + from, to - from);
+}
+
+bool RangeFileReaderThread::unmapIfIdle()
+{
+    const bool done = _closed || _nextRange.load(std::memory_order_relaxed) >= _rangeCount;
+    if (!_file || _inUse > 0 || !done)
+        return false;
+    if (_data)
+        _file->unmap(const_cast<uchar*>(_data));
+    _file.reset();
+    _data = nullptr;
+    return true;
+}
+
+void RangeFileReaderThread::startReading()
+{
+    QMutexLocker locker(&_mapMutex);
+    if (_file) {
+        if (!_closed) {
+            qWarning() << "Attempt to start reading while already running.";
+            return;
+        }
+        // Блоки прошлого прогона ещё у анализаторов
+        locker.unlock();
+        const QString err = "Previous blocks of " + _filePath + " are still being analyzed";
+        qCritical() << err;
+        emit readingError(err);
+        return;
+    }
+
+    auto file = std::make_unique<QFile>(_filePath);
+    if (!file->open(QIODevice::ReadOnly)) {
+        locker.unlock();
+        const QString err = "Failed to open file: " + file->errorString();
+        qCritical() << err;
+        emit readingError(err);
+        return;
+    }
+
+    const qint64 size = file->size();
+    const uchar* data = nullptr;
+    if (size > 0) {
+        data = file->map(0, size);
+        if (!data) {
+            locker.unlock();
+            const QString err = "Critical: File mapping failed. " + file->errorString();
+            qCritical() << err;
+            emit readingError(err);
+            return;
+        }
+#ifdef Q_OS_UNIX
+        madvise(const_cast<uchar*>(data), static_cast<size_t>(size), MADV_SEQUENTIAL);
+#endif
+    }
+
+    _file = std::move(file);
+    _data = data;
+    _fileSize = size;
+    _start = qBound<qint64>(0, _startPos, size);
+    _firstRange = _start / _rangeSize * _rangeSize;
+    _rangeCount = _start < size ? (size - _firstRange + _rangeSize - 1) / _rangeSize : 0;
+    _inUse = 0;
+    _nextRange.store(0, std::memory_order_relaxed);
+    _claimedBlocks.store(0, std::memory_order_relaxed);
+    _claimedBytes.store(0, std::memory_order_relaxed);
+    _closed.store(false, std::memory_order_release);
+    const bool empty = unmapIfIdle();
+    const qint64 rangeCount = _rangeCount;
+    locker.unlock();
+
+    qInfo() << "Reading" << _filePath << "in" << rangeCount << "ranges of" << _rangeSize << "bytes";
+    emit totalSizeChanged(static_cast<quint64>(size));
+    if (empty) {
+        emit readingFinished();
+        return;
+    }
+
+    // По сигналу на воркер: дальше пул забирает диапазоны сам, а один воркер
+    // будится из releaseDataBlock после каждой пачки. readingFinished придёт
+    // оттуда же, когда вернут последний блок, так что анализатор не ждёт
+    // в analyzingFinishing весь файл и таймеры идут
+    for (qint32 i = 0; i < _wakeups; ++i)
+        emit chunkIsReady();
+}
+
+void RangeFileReaderThread::cancelReading()
+{
+    qInfo() << "Canceling reading operation.";
+    // Блоки, которые уже разбирают анализаторы, вернут сами, последний снимет отображение
+    QMutexLocker locker(&_mapMutex);
+    _closed.store(true, std::memory_order_release);
+    unmapIfIdle();
+}
+
+void RangeFileReaderThread::run()
+{
+    exec();
+}
@@ -0,0 +1,96 @@
+#ifndef RANGEFILEREADERTHREAD_H
+#define RANGEFILEREADERTHREAD_H
+
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include "config.h"
+#include "idataprovider.h"
+#include "byteclassifier.h"
+
+// Источник блоков одного файла без центрального нарезчика (read_backend = "ranges").
+// Файл отображается целиком и делится на диапазоны фиксированной длины,
+// кратной странице (chunk_size_bytes, выровненный вверх). Анализаторы забирают
+// диапазоны сами, счётчиком в takeDataBlocks, и сами же правят границы:
+// слово принадлежит диапазону, в котором лежит его первый байт. Поэтому
+// воркер пропускает хвост чужого слова в начале диапазона и дочитывает
+// за его концом последнее своё. Блоки соседних диапазонов стыкуются без
+// пропусков и перекрытий, так что счётчики те же, что у FileReaderThread.
+// Слово длиннее диапазона целиком уходит владельцу, остальные получают пустой
+// блок и сразу берут следующий.
+// Поток читателя только открывает файл и будит анализаторы, а readingFinished
+// шлёт, когда вернут последний блок; подсказки ядру
+// (MADV_SEQUENTIAL, MADV_DONTNEED на разобранных страницах) держат RSS в рамках.
+class RangeFileReaderThread : public QThread, public IDataProvider
+{
+    Q_OBJECT
+public:
+    RangeFileReaderThread(const QString& filePath, const Config& config, QObject* parent = nullptr);
+    ~RangeFileReaderThread();
+
+    void setFilePath(const QString& filePath);
+    // С какого байта начнёт следующий startReading (продолжение с контрольной точки)
+    void setStartPos(qint64 pos);
+    qint64 rangeSize() const noexcept { return _rangeSize; }
+
+    void lock() override {}
+    void unlock() override {}
+    // Пусто - все диапазоны уже забраны
+    bool isDataEmpty() const noexcept override;
+    qsizetype dataSize() const noexcept override;
+    QByteArrayView getDataBlock() override;
+    qsizetype takeDataBlocks(QByteArrayView* blocks, qsizetype max, qsizetype& sizeBefore) override;
+    // Ждать нечего: диапазоны доступны сразу после startReading
+    bool waitForData(qint32 timeoutMs) override;
+    void releaseDataBlock(QByteArrayView block) override;
+    ProducerStats producerStats() const override;
+
+    static constexpr qint64 kPageSize = 4096;
+
+public slots:
+    void startReading();
+    void cancelReading();
+
+signals:
+    void chunkIsReady();
+    void readingFinished();
+    void readingError(const QString& error);
+    void totalSizeChanged(quint64 totalSize);
+
+protected:
+    void run() override;
+
+private:
+    // Первая граница слова не раньше pos: начало данных, конец файла или байт после разделителя
+    qint64 wordStart(qint64 pos) const noexcept;
+    // Блок диапазона index, после правки границ; может быть пустым
+    QByteArrayView blockOf(qint64 index) const noexcept;
+    // Под _mapMutex; true - отображение снято этим вызовом
+    bool unmapIfIdle();
+
+    QString _filePath;
+    qint64 _startPos;
+    ByteClassifier _separators;
+    const qint64 _rangeSize;
+    const qint32 _wakeups;  // сигналов на старте: по одному на воркер анализатора
+
+    // Отображение живёт, пока из него есть выданные блоки
+    QMutex _mapMutex;
+    std::unique_ptr<QFile> _file;
+    const uchar* _data;
+    qint64 _fileSize;
+    qint64 _start;          // с какого байта считаем, граница слова
+    qint64 _firstRange;     // начало нулевого диапазона: _start, выровненный вниз
+    qint64 _rangeCount;
+    std::atomic<bool> _closed;  // новых блоков не выдаём, отображение снимет последний release
+    qint32 _inUse;          // выдано и не возвращено
+
+    std::atomic<qint64> _nextRange;
+    std::atomic<quint64> _claimedBlocks;
+    std::atomic<quint64> _claimedBytes;
+};
+
+#endif // RANGEFILEREADERTHREAD_H
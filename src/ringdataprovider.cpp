@@ -0,0 +1,155 @@
+#include "ringdataprovider.h"
+#include "tracer.h"
+#include <QDeadlineTimer>
+#include <QMutexLocker>
+
+RingDataProvider::RingDataProvider(qsizetype capacity)
+    : _ring(capacity), _limit(capacity), _producerWaiting(false), _closed(false), _sleepers(0),
+      _pushedBlocks(0), _pushedBytes(0), _stalledNs(0), _stallStartNs(-1)
+{
+    _clock.start();
+}
+
+bool RingDataProvider::isDataEmpty() const noexcept
+{
+    return _ring.isEmpty();
+}
+
+qsizetype RingDataProvider::dataSize() const noexcept
+{
+    return _ring.size();
+}
+
+QByteArrayView RingDataProvider::getDataBlock()
+{
+    QByteArrayView block;
+    qsizetype sizeBefore = 0;
+    takeDataBlocks(&block, 1, sizeBefore);
+    return block;
+}
+
+qsizetype RingDataProvider::takeDataBlocks(QByteArrayView* blocks, qsizetype max, qsizetype& sizeBefore)
+{
+    sizeBefore = _ring.size();
+    const qsizetype taken = _ring.tryPopBatch(blocks, max);
+
+    if (!taken)
+        return 0;
+
+    // Пара к waitForSpace: либо производитель увидит место, либо мы - его флаг
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_producerWaiting.load() && _producerWaiting.exchange(false))
+        onSpaceFreed();
+    return taken;
+}
+
+bool RingDataProvider::waitForData(qint32 timeoutMs)
+{
+    if (!_ring.isEmpty())
+        return true;
+    if (timeoutMs <= 0 || _closed)
+        return false;
+
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&_sleepMutex);
+    _sleepers.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (_ring.isEmpty() && !_closed) {
+        if (!_dataArrived.wait(&_sleepMutex, deadline))
+            break;
+    }
+    _sleepers.fetch_sub(1);
+    return !_ring.isEmpty();
+}
+
+IDataProvider::ProducerStats RingDataProvider::producerStats() const
+{
+    ProducerStats stats;
+    stats.blocks = _pushedBlocks.load(std::memory_order_relaxed);
+    stats.bytes = _pushedBytes.load(std::memory_order_relaxed);
+    stats.stalledNs = _stalledNs.load(std::memory_order_relaxed);
+    const qint64 stallStart = _stallStartNs.load(std::memory_order_relaxed);
+    if (stallStart >= 0)
+        stats.stalledNs += _clock.nsecsElapsed() - stallStart;
+    return stats;
+}
+
+qsizetype RingDataProvider::queueLimit() const noexcept
+{
+    return _limit.load(std::memory_order_relaxed);
+}
+
+bool RingDataProvider::pushDataBlock(QByteArrayView block)
+{
+    if (!_ring.tryPush(block)) {
+        markProducerStalled();
+        return false;
+    }
+    endProducerStall();
+    _pushedBlocks.fetch_add(1, std::memory_order_relaxed);
+    _pushedBytes.fetch_add(static_cast<quint64>(block.size()), std::memory_order_relaxed);
+
+    // Без барьера спящий мог проверить кольцо до записи, а мы - _sleepers до его инкремента
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleepers.load())
+        wakeConsumers();
+    return true;
+}
+
+bool RingDataProvider::waitForSpace(qsizetype limit)
+{
+    _limit.store(limit, std::memory_order_relaxed);
+    if (_ring.size() < limit)
+        return true;
+
+    _producerWaiting = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_ring.size() < limit && _producerWaiting.exchange(false))
+        return true;
+    markProducerStalled();
+    return false;
+}
+
+void RingDataProvider::closeData()
+{
+    endProducerStall();
+    _closed = true;
+    wakeConsumers();
+}
+
+void RingDataProvider::reopenData()
+{
+    _closed = false;
+    _producerWaiting = false;
+    _pushedBlocks = 0;
+    _pushedBytes = 0;
+    _stalledNs = 0;
+    _stallStartNs = -1;
+}
+
+void RingDataProvider::markProducerStalled()
+{
+    // Первая отметка задаёт начало простоя, повторные его не сдвигают
+    qint64 idle = -1;
+    _stallStartNs.compare_exchange_strong(idle, _clock.nsecsElapsed(), std::memory_order_relaxed);
+}
+
+void RingDataProvider::endProducerStall()
+{
+    const qint64 stallStart = _stallStartNs.exchange(-1, std::memory_order_relaxed);
+    if (stallStart < 0)
+        return;
+    const qint64 stalledNs = _clock.nsecsElapsed() - stallStart;
+    _stalledNs.fetch_add(stalledNs, std::memory_order_relaxed);
+    // Часы у трассировки свои: интервал откладываем назад от её "сейчас"
+    if (Tracer::isEnabled()) {
+        const qint64 end = Tracer::now();
+        Tracer::record("readerStalled", end - stalledNs, end);
+    }
+}
+
+void RingDataProvider::wakeConsumers()
+{
+    QMutexLocker locker(&_sleepMutex);
+    _dataArrived.wakeAll();
+}
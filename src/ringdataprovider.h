@@ -0,0 +1,65 @@
+#ifndef RINGDATAPROVIDER_H
+#define RINGDATAPROVIDER_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include "idataprovider.h"
+#include "blockring.h"
+
+// IDataProvider поверх lock-free кольца: один производитель (читатель файла),
+// сколько угодно анализаторов. lock()/unlock() здесь пустые, блоки выдаются
+// пачками, а ждущий данных потребитель спит на QWaitCondition, а не крутится.
+class RingDataProvider : public IDataProvider
+{
+public:
+    explicit RingDataProvider(qsizetype capacity);
+
+    void lock() override {}
+    void unlock() override {}
+    bool isDataEmpty() const noexcept override;
+    qsizetype dataSize() const noexcept override;
+    QByteArrayView getDataBlock() override;
+    qsizetype takeDataBlocks(QByteArrayView* blocks, qsizetype max, qsizetype& sizeBefore) override;
+    bool waitForData(qint32 timeoutMs) override;
+    ProducerStats producerStats() const override;
+    qsizetype queueLimit() const noexcept override;
+
+protected:
+    // false - кольцо заполнено
+    bool pushDataBlock(QByteArrayView block);
+    // true - место под блок уже есть; иначе onSpaceFreed() вызовут, как только оно освободится.
+    // limit не больше ёмкости кольца и может меняться от вызова к вызову
+    bool waitForSpace(qsizetype limit);
+    // Будит всех ждущих: данных больше не будет
+    void closeData();
+    void reopenData();
+    // Производитель встал из-за анализаторов; простой закончится на следующем pushDataBlock.
+    // waitForSpace() отмечает это сам, другие причины (бюджет памяти) - наследник
+    void markProducerStalled();
+
+    // Вызывается из потока потребителя
+    virtual void onSpaceFreed() {}
+
+private:
+    void wakeConsumers();
+    void endProducerStall();
+
+    BlockRing<QByteArrayView> _ring;
+
+    std::atomic<qsizetype> _limit;
+    std::atomic<bool> _producerWaiting;
+    std::atomic<bool> _closed;
+    std::atomic<qint32> _sleepers;
+    QMutex _sleepMutex;
+    QWaitCondition _dataArrived;
+
+    QElapsedTimer _clock;
+    std::atomic<quint64> _pushedBlocks;
+    std::atomic<quint64> _pushedBytes;
+    std::atomic<qint64> _stalledNs;
+    std::atomic<qint64> _stallStartNs;     // -1 - производитель не стоит
+};
+
+#endif // RINGDATAPROVIDER_H
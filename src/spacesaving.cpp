@@ -0,0 +1,199 @@
+#include "spacesaving.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include "topnselector.h"
+
+SpaceSavingCounter::SpaceSavingCounter(qsizetype capacity, qsizetype sketchWidth, qsizetype sketchDepth)
+    : _capacity(qMax<qsizetype>(1, capacity)), _total(0),
+      _sketchWidth(sketchDepth > 0 ? qMax<qsizetype>(0, sketchWidth) : 0),
+      _sketchDepth(sketchWidth > 0 ? qMax<qsizetype>(0, sketchDepth) : 0)
+{
+    // Всё выделяется сразу: дальше память не растёт, сколько бы слов ни пришло
+    _counters.reserve(_capacity);
+    _heap.reserve(_capacity);
+
+    size_t indexSize = 16;
+    while (indexSize < size_t(_capacity) * 2)
+        indexSize *= 2;
+    _index.assign(indexSize, -1);
+    _indexMask = indexSize - 1;
+
+    _sketch.assign(_sketchWidth * _sketchDepth, 0);
+}
+
+void SpaceSavingCounter::add(QByteArrayView word, quint64 hash, quint64 delta)
+{
+    _total += delta;
+    const quint64 estimate = _sketchDepth > 0 ? sketchAdd(hash, delta)
+                                              : std::numeric_limits<quint64>::max();
+
+    const size_t slot = findSlot(word, hash);
+    if (slot != npos) {
+        Counter& counter = _counters[_index[slot]];
+        counter.count += delta;
+        siftDown(counter.heapPos);
+        return;
+    }
+
+    if (size() < _capacity) {
+        const qint32 idx = qint32(_counters.size());
+        _counters.push_back({word.toByteArray(), hash, delta, 0, _heap.size()});
+        _heap.push_back(idx);
+        siftUp(_heap.size() - 1);
+        insertIndex(idx);
+        return;
+    }
+
+    // Вытесняем минимальный счётчик, новое слово наследует его значение как погрешность
+    const qint32 idx = _heap.front();
+    Counter& counter = _counters[idx];
+    eraseIndex(findSlot(counter.word, counter.hash));
+
+    quint64 count = counter.count + delta;
+    if (estimate < count)
+        count = estimate;
+
+    counter.word.resize(word.size());
+    std::memcpy(counter.word.data(), word.data(), size_t(word.size()));
+    counter.hash = hash;
+    counter.count = count;
+    counter.error = count - delta;
+
+    insertIndex(idx);
+    siftDown(0);
+}
+
+QVector<SpaceSavingCounter::Entry> SpaceSavingCounter::top(qsizetype n) const
+{
+    std::vector<const Counter*> sorted;
+    sorted.reserve(_counters.size());
+    for (const Counter& counter : _counters)
+        sorted.push_back(&counter);
+
+    const qsizetype count = qMin(n, size());
+    std::partial_sort(sorted.begin(), sorted.begin() + count, sorted.end(),
+                      [](const Counter* a, const Counter* b) {
+                          if (a->count != b->count)
+                              return a->count > b->count;
+                          return TopNSelector::compareKeys(a->word, b->word) > 0;
+                      });
+
+    QVector<Entry> result;
+    result.reserve(count);
+    for (qsizetype i = 0; i < count; ++i)
+        result.append({sorted[i]->word, sorted[i]->count, sorted[i]->error});
+    return result;
+}
+
+size_t SpaceSavingCounter::memoryUsage() const noexcept
+{
+    size_t words = 0;
+    for (const Counter& counter : _counters)
+        words += size_t(counter.word.capacity());
+    return _counters.capacity() * sizeof(Counter) + words
+           + _heap.capacity() * sizeof(qint32)
+           + _index.capacity() * sizeof(qint32)
+           + _sketch.capacity() * sizeof(quint64);
+}
+
+void SpaceSavingCounter::clear() noexcept
+{
+    _counters.clear();
+    _heap.clear();
+    std::fill(_index.begin(), _index.end(), -1);
+    std::fill(_sketch.begin(), _sketch.end(), 0);
+    _total = 0;
+}
+
+size_t SpaceSavingCounter::findSlot(QByteArrayView word, quint64 hash) const noexcept
+{
+    size_t i = hash & _indexMask;
+    while (_index[i] >= 0) {
+        const Counter& counter = _counters[_index[i]];
+        if (counter.hash == hash && counter.word.size() == word.size()
+            && std::memcmp(counter.word.constData(), word.data(), size_t(word.size())) == 0)
+            return i;
+        i = (i + 1) & _indexMask;
+    }
+    return npos;
+}
+
+void SpaceSavingCounter::insertIndex(qint32 counter) noexcept
+{
+    size_t i = _counters[counter].hash & _indexMask;
+    while (_index[i] >= 0)
+        i = (i + 1) & _indexMask;
+    _index[i] = counter;
+}
+
+void SpaceSavingCounter::eraseIndex(size_t slot) noexcept
+{
+    // Удаление со сдвигом назад: линейное пробирование обходится без надгробий
+    size_t i = slot;
+    size_t j = slot;
+    while (true) {
+        j = (j + 1) & _indexMask;
+        if (_index[j] < 0)
+            break;
+        const size_t home = _counters[_index[j]].hash & _indexMask;
+        const bool movable = (j > i) ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable) {
+            _index[i] = _index[j];
+            i = j;
+        }
+    }
+    _index[i] = -1;
+}
+
+void SpaceSavingCounter::siftDown(size_t pos) noexcept
+{
+    const size_t n = _heap.size();
+    while (true) {
+        const size_t left = pos * 2 + 1;
+        if (left >= n)
+            return;
+        size_t smallest = left;
+        if (left + 1 < n && heapCount(left + 1) < heapCount(left))
+            smallest = left + 1;
+        if (heapCount(pos) <= heapCount(smallest))
+            return;
+        swapHeap(pos, smallest);
+        pos = smallest;
+    }
+}
+
+void SpaceSavingCounter::siftUp(size_t pos) noexcept
+{
+    while (pos > 0) {
+        const size_t parent = (pos - 1) / 2;
+        if (heapCount(parent) <= heapCount(pos))
+            return;
+        swapHeap(pos, parent);
+        pos = parent;
+    }
+}
+
+void SpaceSavingCounter::swapHeap(size_t a, size_t b) noexcept
+{
+    std::swap(_heap[a], _heap[b]);
+    _counters[_heap[a]].heapPos = a;
+    _counters[_heap[b]].heapPos = b;
+}
+
+quint64 SpaceSavingCounter::sketchAdd(quint64 hash, quint64 delta) noexcept
+{
+    // Строки sketch адресуются двойным хешированием из одного 64-битного хеша
+    const quint64 h1 = hash & 0xFFFFFFFFu;
+    const quint64 h2 = (hash >> 32) | 1;
+    const quint64 width = quint64(_sketchWidth);
+
+    quint64 estimate = std::numeric_limits<quint64>::max();
+    for (qsizetype row = 0; row < _sketchDepth; ++row) {
+        const quint64 col = (h1 + quint64(row) * h2) % width;
+        quint64& cell = _sketch[size_t(row * _sketchWidth + qsizetype(col))];
+        cell += delta;
+        estimate = qMin(estimate, cell);
+    }
+    return estimate;
+}
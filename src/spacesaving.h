@@ -0,0 +1,72 @@
+#ifndef SPACESAVING_H
+#define SPACESAVING_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QVector>
+#include <vector>
+
+// Приближённый топ слов за фиксированную память: Space-Saving с capacity
+// счётчиками (Metwally et al.). Новое слово вытесняет счётчик с минимальным
+// значением и наследует его как погрешность. При sketchDepth > 0 новые слова
+// дополнительно оцениваются Count-Min sketch, что сужает погрешность.
+// Для каждого слова верно: count - error <= истинное значение <= count.
+class SpaceSavingCounter
+{
+public:
+    struct Entry {
+        QByteArray word;
+        quint64 count;
+        quint64 error;
+    };
+
+    SpaceSavingCounter(qsizetype capacity, qsizetype sketchWidth = 0, qsizetype sketchDepth = 0);
+
+    void add(QByteArrayView word, quint64 hash, quint64 delta = 1);
+
+    // n самых частых слов, по убыванию count
+    QVector<Entry> top(qsizetype n) const;
+
+    qsizetype size() const noexcept { return static_cast<qsizetype>(_counters.size()); }
+    qsizetype capacity() const noexcept { return _capacity; }
+    quint64 totalCount() const noexcept { return _total; }
+    size_t memoryUsage() const noexcept;
+
+    // Память не отдаётся: её объём и так не зависит от входа
+    void clear() noexcept;
+
+private:
+    struct Counter {
+        QByteArray word;
+        quint64 hash;
+        quint64 count;
+        quint64 error;
+        size_t heapPos;
+    };
+
+    static constexpr size_t npos = size_t(-1);
+
+    size_t findSlot(QByteArrayView word, quint64 hash) const noexcept;
+    void insertIndex(qint32 counter) noexcept;
+    void eraseIndex(size_t slot) noexcept;
+    quint64 heapCount(size_t pos) const noexcept { return _counters[_heap[pos]].count; }
+    void siftDown(size_t pos) noexcept;
+    void siftUp(size_t pos) noexcept;
+    void swapHeap(size_t a, size_t b) noexcept;
+
+    quint64 sketchAdd(quint64 hash, quint64 delta) noexcept;
+
+    qsizetype _capacity;
+    quint64 _total;
+
+    std::vector<Counter> _counters;
+    std::vector<qint32> _heap;      // min-heap индексов _counters по count
+    std::vector<qint32> _index;     // hash -> индекс в _counters, -1 - пусто
+    size_t _indexMask;
+
+    std::vector<quint64> _sketch;
+    qsizetype _sketchWidth;
+    qsizetype _sketchDepth;
+};
+
+#endif // SPACESAVING_H
@@ -0,0 +1,261 @@
+#include "streamdecoder.h"
+#include <QFile>
+#include <limits>
+
+#ifdef WORDPULSE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef WORDPULSE_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+#ifdef WORDPULSE_HAVE_ZLIB
+class GzipDecoder : public StreamDecoder
+{
+public:
+    explicit GzipDecoder(QIODevice& input) : StreamDecoder(input), _memberDone(false)
+    {
+        _stream = {};
+        // 15 + 16: только gzip-заголовок, окно 32 КиБ
+        _ok = inflateInit2(&_stream, 15 + 16) == Z_OK;
+        if (!_ok)
+            _error = "inflateInit2 failed";
+    }
+
+    ~GzipDecoder() override
+    {
+        if (_ok)
+            inflateEnd(&_stream);
+    }
+
+    qint64 read(char* dst, qint64 max) override
+    {
+        if (!_ok)
+            return -1;
+
+        _stream.next_out = reinterpret_cast<Bytef*>(dst);
+        _stream.avail_out = static_cast<uInt>(qMin<qint64>(max, std::numeric_limits<uInt>::max()));
+        const uInt capacity = _stream.avail_out;
+
+        while (_stream.avail_out > 0) {
+            if (_stream.avail_in == 0 && !_eof && !refillStream())
+                return -1;
+            if (_memberDone) {
+                if (_stream.avail_in == 0)
+                    break;
+                // Следующий член склеенного файла
+                inflateReset(&_stream);
+                _memberDone = false;
+            }
+
+            const uInt outBefore = _stream.avail_out;
+            const int rc = inflate(&_stream, Z_NO_FLUSH);
+            if (rc == Z_STREAM_END) {
+                _memberDone = true;
+                continue;
+            }
+            if (rc != Z_OK && rc != Z_BUF_ERROR) {
+                _error = QString("gzip: ") + (_stream.msg ? _stream.msg : "corrupted data");
+                return -1;
+            }
+            // Вход кончился, а распаковщику больше нечего отдать
+            if (_eof && _stream.avail_in == 0 && _stream.avail_out == outBefore)
+                break;
+        }
+
+        const qint64 produced = static_cast<qint64>(capacity - _stream.avail_out);
+        if (produced == 0 && !_memberDone) {
+            _error = "gzip: unexpected end of file";
+            return -1;
+        }
+        return produced;
+    }
+
+protected:
+    qint64 pendingInput() const noexcept override { return _stream.avail_in; }
+
+private:
+    bool refillStream()
+    {
+        qint64 size = 0;
+        if (!refill(size))
+            return false;
+        _stream.next_in = reinterpret_cast<Bytef*>(_inBuf.data());
+        _stream.avail_in = static_cast<uInt>(size);
+        return true;
+    }
+
+    z_stream _stream;
+    bool _ok;
+    bool _memberDone;
+};
+#endif
+
+#ifdef WORDPULSE_HAVE_ZSTD
+class ZstdDecoder : public StreamDecoder
+{
+public:
+    explicit ZstdDecoder(QIODevice& input) : StreamDecoder(input), _in{nullptr, 0, 0}, _frameDone(true)
+    {
+        _ctx = ZSTD_createDCtx();
+        if (!_ctx)
+            _error = "ZSTD_createDCtx failed";
+    }
+
+    ~ZstdDecoder() override
+    {
+        ZSTD_freeDCtx(_ctx);
+    }
+
+    qint64 read(char* dst, qint64 max) override
+    {
+        if (!_ctx)
+            return -1;
+
+        ZSTD_outBuffer out{dst, static_cast<size_t>(max), 0};
+        while (out.pos < out.size) {
+            if (_in.pos == _in.size && !_eof) {
+                qint64 size = 0;
+                if (!refill(size))
+                    return -1;
+                _in = {_inBuf.constData(), static_cast<size_t>(size), 0};
+            }
+
+            const size_t outBefore = out.pos;
+            const size_t inBefore = _in.pos;
+            const size_t rc = ZSTD_decompressStream(_ctx, &out, &_in);
+            if (ZSTD_isError(rc)) {
+                _error = QString("zstd: ") + ZSTD_getErrorName(rc);
+                return -1;
+            }
+            if (out.pos == outBefore && _in.pos == inBefore) {
+                if (_eof)
+                    break;
+                continue;
+            }
+            // 0 - кадр закончен и выдан целиком
+            _frameDone = rc == 0;
+        }
+
+        if (out.pos == 0 && !_frameDone) {
+            _error = "zstd: unexpected end of file";
+            return -1;
+        }
+        return static_cast<qint64>(out.pos);
+    }
+
+protected:
+    qint64 pendingInput() const noexcept override { return static_cast<qint64>(_in.size - _in.pos); }
+
+private:
+    ZSTD_DCtx* _ctx;
+    ZSTD_inBuffer _in;
+    bool _frameDone;
+};
+#endif
+
+} // namespace
+
+StreamDecoder::StreamDecoder(QIODevice& input)
+    : _input(input), _inBuf(kInputChunk, Qt::Uninitialized), _readBytes(0), _eof(false)
+{
+}
+
+StreamDecoder::Format StreamDecoder::detect(QIODevice& device)
+{
+    const QByteArray magic = device.peek(4);
+    if (magic.startsWith("\x1f\x8b"))
+        return Format::Gzip;
+    if (magic == QByteArray("\x28\xb5\x2f\xfd", 4))
+        return Format::Zstd;
+    return Format::Plain;
+}
+
+StreamDecoder::Format StreamDecoder::detect(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return Format::Plain;
+    return detect(file);
+}
+
+bool StreamDecoder::isSupported(Format format) noexcept
+{
+    switch (format) {
+    case Format::Plain:
+        return true;
+    case Format::Gzip:
+#ifdef WORDPULSE_HAVE_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    case Format::Zstd:
+#ifdef WORDPULSE_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+QString StreamDecoder::formatName(Format format)
+{
+    switch (format) {
+    case Format::Plain:
+        return "plain";
+    case Format::Gzip:
+        return "gzip";
+    case Format::Zstd:
+        return "zstd";
+    }
+    return QString();
+}
+
+std::unique_ptr<StreamDecoder> StreamDecoder::create(Format format, QIODevice& input, QString* error)
+{
+    Q_UNUSED(input);
+    std::unique_ptr<StreamDecoder> decoder;
+    switch (format) {
+    case Format::Plain:
+        return nullptr;
+    case Format::Gzip:
+#ifdef WORDPULSE_HAVE_ZLIB
+        decoder = std::make_unique<GzipDecoder>(input);
+#endif
+        break;
+    case Format::Zstd:
+#ifdef WORDPULSE_HAVE_ZSTD
+        decoder = std::make_unique<ZstdDecoder>(input);
+#endif
+        break;
+    }
+
+    if (!decoder) {
+        if (error)
+            *error = "built without " + formatName(format) + " support";
+        return nullptr;
+    }
+    if (!decoder->errorString().isEmpty()) {
+        if (error)
+            *error = decoder->errorString();
+        return nullptr;
+    }
+    return decoder;
+}
+
+bool StreamDecoder::refill(qint64& size)
+{
+    size = _input.read(_inBuf.data(), _inBuf.size());
+    if (size < 0) {
+        _error = "read failed: " + _input.errorString();
+        return false;
+    }
+    if (size == 0)
+        _eof = true;
+    _readBytes += size;
+    return true;
+}
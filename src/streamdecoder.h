@@ -0,0 +1,59 @@
+#ifndef STREAMDECODER_H
+#define STREAMDECODER_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <memory>
+
+// Потоковая распаковка входного файла без временных файлов на диске.
+// Формат определяется по сигнатуре, а не по расширению. gzip и zstd доступны,
+// только если сборка нашла zlib (WORDPULSE_HAVE_ZLIB) и libzstd (WORDPULSE_HAVE_ZSTD).
+// Склеенные потоки (cat a.gz b.gz > ab.gz, несколько кадров zstd) читаются целиком.
+class StreamDecoder
+{
+public:
+    enum class Format {
+        Plain,
+        Gzip,
+        Zstd
+    };
+
+    // Смотрит первые байты, не сдвигая позицию чтения
+    static Format detect(QIODevice& device);
+    static Format detect(const QString& path);
+    static bool isSupported(Format format) noexcept;
+    static QString formatName(Format format);
+
+    // nullptr для Plain и для неподдержанного формата (тогда error заполняется)
+    static std::unique_ptr<StreamDecoder> create(Format format, QIODevice& input, QString* error = nullptr);
+
+    virtual ~StreamDecoder() = default;
+    StreamDecoder(const StreamDecoder&) = delete;
+    StreamDecoder& operator=(const StreamDecoder&) = delete;
+
+    // Распаковывает до max байт в dst: сколько записано, 0 - конец потока, -1 - ошибка
+    virtual qint64 read(char* dst, qint64 max) = 0;
+
+    // Сколько сжатых байт уже ушло в распаковщик: по нему считается прогресс
+    qint64 consumed() const noexcept { return _readBytes - pendingInput(); }
+    const QString& errorString() const noexcept { return _error; }
+
+protected:
+    static constexpr qint64 kInputChunk = 256 * 1024;
+
+    explicit StreamDecoder(QIODevice& input);
+
+    // Следующая порция сжатых данных в _inBuf; false - ошибка чтения
+    bool refill(qint64& size);
+    // Прочитанные с диска, но ещё не отданные распаковщику байты
+    virtual qint64 pendingInput() const noexcept = 0;
+
+    QIODevice& _input;
+    QByteArray _inBuf;
+    qint64 _readBytes;
+    bool _eof;
+    QString _error;
+};
+
+#endif // STREAMDECODER_H
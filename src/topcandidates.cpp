@@ -0,0 +1,65 @@
+#include "topcandidates.h"
+#include <algorithm>
+#include <utility>
+#include "topnselector.h"
+
+TopCandidates::TopCandidates(qsizetype n)
+    : _n(static_cast<size_t>(qMax<qsizetype>(0, n))), _floorCount(0)
+{
+}
+
+bool TopCandidates::update(QByteArrayView word, quint64 hash, quint64 count)
+{
+    if (!_n)
+        return false;
+    if (count < _floorCount || (count == _floorCount && TopNSelector::compareKeys(word, _floorKey) < 0))
+        return false;
+
+    const quint64 current = _table.value(word, hash);
+    if (current == count)
+        return false;
+    _table.add(word, hash, count - current);
+    if (static_cast<size_t>(_table.size()) >= 2 * _n)
+        shrink();
+    return true;
+}
+
+size_t TopCandidates::memoryUsage() const noexcept
+{
+    return _table.memoryUsage() + _spare.memoryUsage() + _entries.capacity() * sizeof(Entry)
+           + static_cast<size_t>(_floorKey.capacity());
+}
+
+void TopCandidates::clear() noexcept
+{
+    _table.clear();
+    _spare.clear();
+    std::vector<Entry>().swap(_entries);
+    _floorCount = 0;
+    _floorKey.clear();
+}
+
+void TopCandidates::shrink()
+{
+    _entries.clear();
+    _table.forEach([this](QByteArrayView word, quint64 hash, quint64 count) {
+        _entries.push_back({word, hash, count});
+    });
+
+    const auto better = [](const Entry& a, const Entry& b) {
+        return a.count != b.count ? a.count > b.count : TopNSelector::compareKeys(a.word, b.word) > 0;
+    };
+    const auto floor = _entries.begin() + static_cast<std::ptrdiff_t>(_n - 1);
+    std::nth_element(_entries.begin(), floor, _entries.end(), better);
+
+    // Ключи живут в арене старой таблицы: порог копируется до подмены,
+    // а её память остаётся под следующее сжатие
+    _spare.reset();
+    for (auto it = _entries.begin(); it <= floor; ++it)
+        _spare.add(it->word, it->hash, it->count);
+    _floorCount = floor->count;
+    _floorKey = floor->word.toByteArray();
+    std::swap(_table, _spare);
+    _spare.reset();
+    _entries.clear();
+}
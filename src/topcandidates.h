@@ -0,0 +1,51 @@
+#ifndef TOPCANDIDATES_H
+#define TOPCANDIDATES_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <vector>
+#include "wordcounttable.h"
+
+// Слова шарда точных счётчиков, которые могут быть в его топе из n. Счётчики
+// только растут, поэтому хватает порога - пары (count, ключ) n-го места на момент
+// последнего сжатия. Слово ниже порога в топ не попадёт, пока его счётчик не
+// перешагнёт порог, а тогда flushCounts сам передаст его сюда. При 2n кандидатах
+// остаются n лучших, и порог поднимается до худшего из них. Отбор топа идёт по
+// кандидатам, а не по всему словарю. Ничьи решает TopNSelector::compareKeys.
+class TopCandidates
+{
+public:
+    explicit TopCandidates(qsizetype n);
+
+    // count - новое значение счётчика слова. true - набор кандидатов изменился
+    bool update(QByteArrayView word, quint64 hash, quint64 count);
+
+    // f(QByteArrayView word, quint64 count)
+    template <typename F>
+    void forEach(F&& f) const
+    {
+        _table.forEach([&f](QByteArrayView word, quint64, quint64 count) { f(word, count); });
+    }
+
+    qsizetype size() const noexcept { return _table.size(); }
+    size_t memoryUsage() const noexcept;
+    void clear() noexcept;
+
+private:
+    struct Entry {
+        QByteArrayView word;
+        quint64 hash;
+        quint64 count;
+    };
+
+    void shrink();
+
+    size_t _n;
+    WordCountTable _table;
+    WordCountTable _spare;          // сюда собираются выжившие при сжатии
+    std::vector<Entry> _entries;
+    quint64 _floorCount;    // порог: пара (count, ключ) худшего из n после сжатия
+    QByteArray _floorKey;
+};
+
+#endif // TOPCANDIDATES_H
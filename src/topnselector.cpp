@@ -0,0 +1,48 @@
+#include "topnselector.h"
+#include <algorithm>
+#include <functional>
+
+TopNSelector::TopNSelector(qsizetype n) : _n(static_cast<size_t>(qMax<qsizetype>(0, n)))
+{
+    _heap.reserve(_n);
+}
+
+void TopNSelector::setDecoder(std::function<QString(QByteArrayView)> decoder)
+{
+    _decoder = std::move(decoder);
+}
+
+void TopNSelector::offer(quint64 count, QByteArrayView word, quint64 error)
+{
+    if (!_n)
+        return;
+    if (_heap.size() == _n) {
+        const Candidate& worst = _heap.front();
+        if (count < worst.count || (count == worst.count && compareKeys(word, worst.key) <= 0))
+            return;
+    }
+
+    Candidate candidate{count, word.toByteArray(), _decoder ? _decoder(word) : QString::fromUtf8(word), error};
+    const std::greater<Candidate> greater;
+    if (_heap.size() == _n) {
+        std::pop_heap(_heap.begin(), _heap.end(), greater);
+        _heap.pop_back();
+    }
+    _heap.push_back(std::move(candidate));
+    std::push_heap(_heap.begin(), _heap.end(), greater);
+}
+
+QVector<QPair<quint64, QString>> TopNSelector::takeAscending(QVector<quint64>* errors)
+{
+    std::sort(_heap.begin(), _heap.end());
+
+    QVector<QPair<quint64, QString>> result;
+    result.reserve(static_cast<qsizetype>(_heap.size()));
+    for (Candidate& candidate : _heap) {
+        if (errors)
+            errors->append(candidate.error);
+        result.append({candidate.count, std::move(candidate.word)});
+    }
+    _heap.clear();
+    return result;
+}
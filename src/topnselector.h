@@ -0,0 +1,74 @@
+#ifndef TOPNSELECTOR_H
+#define TOPNSELECTOR_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// Отбор n лучших пар (count, ключ) из потока кандидатов: min-heap на n элементов.
+// При равном count выигрывает больший ключ в порядке compareKeys - том же, что у
+// QString для слов в UTF-8; для n-грамм это просто постоянный порядок. Кандидат не выше
+// минимума заполненной кучи отсекается сравнением числа и байтов ключа:
+// QString под него не создаётся, n-грамма не расшифровывается.
+class TopNSelector
+{
+public:
+    explicit TopNSelector(qsizetype n);
+
+    // Как показывать ключ; по умолчанию ключ - само слово в UTF-8.
+    // Вызывается только для кандидатов, прошедших отсечку по count
+    void setDecoder(std::function<QString(QByteArrayView)> decoder);
+
+    void offer(quint64 count, QByteArrayView word, quint64 error = 0);
+
+    // Порядок ключей UTF-8, совпадающий с порядком QString (UTF-16): байты как есть,
+    // только ведущие 0xEE/0xEF (U+E000..U+FFFF) старше 0xF0..0xF4 - символы вне BMP
+    // в UTF-16 идут суррогатами 0xD800..0xDFFF. Первый несовпавший байт обоих ключей
+    // в корректном UTF-8 - либо оба ведущие, либо оба продолжения, так что хватает
+    // перестановки значений одного байта
+    static int compareKeys(QByteArrayView a, QByteArrayView b) noexcept
+    {
+        const qsizetype common = qMin(a.size(), b.size());
+        const auto diff = std::mismatch(a.begin(), a.begin() + common, b.begin());
+        if (diff.first == a.begin() + common)
+            return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+        return utf16Rank(static_cast<quint8>(*diff.first)) < utf16Rank(static_cast<quint8>(*diff.second)) ? -1 : 1;
+    }
+
+    // По возрастанию (count, ключ); errors заполняется в том же порядке
+    QVector<QPair<quint64, QString>> takeAscending(QVector<quint64>* errors = nullptr);
+
+private:
+    static constexpr quint8 utf16Rank(quint8 c) noexcept
+    {
+        if (c >= 0xF0 && c <= 0xF4)
+            return static_cast<quint8>(c - 2);     // 0xEE..0xF2
+        if (c == 0xEE || c == 0xEF)
+            return static_cast<quint8>(c + 5);     // 0xF3, 0xF4
+        return c;
+    }
+
+    struct Candidate {
+        quint64 count;
+        QByteArray key;
+        QString word;
+        quint64 error;
+
+        bool operator>(const Candidate& other) const
+        {
+            return count != other.count ? count > other.count : compareKeys(key, other.key) > 0;
+        }
+        bool operator<(const Candidate& other) const { return other > *this; }
+    };
+
+    size_t _n;
+    std::function<QString(QByteArrayView)> _decoder;
+    std::vector<Candidate> _heap;   // в вершине - худший из отобранных
+};
+
+#endif // TOPNSELECTOR_H
@@ -0,0 +1,177 @@
+#include "topwordsdiff.h"
+#include <QHash>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+void applyStep(TopWordsDiff::TopList& list, const TopWordsDiff::Step& step)
+{
+    switch (step.op) {
+    case TopWordsDiff::Op::Remove:
+        list.remove(step.row);
+        break;
+    case TopWordsDiff::Op::Insert:
+        list.insert(step.row, {step.count, step.word});
+        break;
+    case TopWordsDiff::Op::Move:
+        list.move(step.row, step.to > step.row ? step.to - 1 : step.to);
+        break;
+    case TopWordsDiff::Op::Count:
+        list[step.row].first = step.count;
+        break;
+    }
+}
+
+// Номер строки по месту: сумма на префиксе мест, занятых строками (дерево Фенвика)
+class RowIndex
+{
+public:
+    explicit RowIndex(qint32 size) : _tree(static_cast<size_t>(size) + 1, 0) {}
+
+    void add(qint32 slot, qint32 delta)
+    {
+        for (size_t i = static_cast<size_t>(slot) + 1; i < _tree.size(); i += i & (~i + 1))
+            _tree[i] += delta;
+    }
+    // Сколько строк стоит перед местом slot
+    qint32 rowsBefore(qint32 slot) const
+    {
+        qint32 rows = 0;
+        for (size_t i = static_cast<size_t>(slot); i > 0; i -= i & (~i + 1))
+            rows += _tree[i];
+        return rows;
+    }
+
+private:
+    std::vector<qint32> _tree;
+};
+
+// Отмечает значения наибольшей возрастающей подпоследовательности (значения уникальны, меньше size)
+std::vector<bool> longestIncreasing(const std::vector<qint32>& values, qint32 size)
+{
+    std::vector<size_t> tails;
+    std::vector<qint64> previous(values.size(), -1);
+    for (size_t i = 0; i < values.size(); ++i) {
+        const auto it = std::lower_bound(tails.begin(), tails.end(), values[i],
+                                         [&values](size_t index, qint32 value) { return values[index] < value; });
+        if (it != tails.begin())
+            previous[i] = static_cast<qint64>(*(it - 1));
+        if (it == tails.end())
+            tails.push_back(i);
+        else
+            *it = i;
+    }
+
+    std::vector<bool> result(static_cast<size_t>(size), false);
+    for (qint64 i = tails.empty() ? -1 : static_cast<qint64>(tails.back()); i >= 0; i = previous[static_cast<size_t>(i)])
+        result[static_cast<size_t>(values[static_cast<size_t>(i)])] = true;
+    return result;
+}
+
+} // namespace
+
+TopWordsDiff TopWordsDiff::compute(const TopList& from, const TopList& to)
+{
+    TopWordsDiff diff;
+    diff.fromSize = static_cast<qint32>(from.size());
+    diff.result = to;
+
+    const qint32 size = static_cast<qint32>(to.size());
+    QHash<QString, qint32> target;
+    target.reserve(size);
+    for (qint32 i = 0; i < size; ++i)
+        target.insert(to[i].second, i);
+
+    // Удаления с конца: номера ещё не удалённых строк не сдвигаются
+    for (qint32 row = static_cast<qint32>(from.size()) - 1; row >= 0; --row) {
+        if (!target.contains(from[row].second))
+            diff.steps.append({Op::Remove, row, 0, 0, QString()});
+    }
+
+    // Оставшиеся строки по порядку: их номера в to и прежний счёт
+    std::vector<qint32> positions;
+    positions.reserve(static_cast<size_t>(from.size()));
+    std::vector<qint32> remaining(static_cast<size_t>(size), -1);  // номер в to -> номер оставшейся строки
+    std::vector<quint64> previousCount(static_cast<size_t>(size), 0);
+    for (const auto& entry : from) {
+        const auto it = target.constFind(entry.second);
+        if (it == target.constEnd())
+            continue;
+        remaining[static_cast<size_t>(*it)] = static_cast<qint32>(positions.size());
+        previousCount[static_cast<size_t>(*it)] = entry.first;
+        positions.push_back(*it);
+    }
+    const qint32 kept = static_cast<qint32>(positions.size());
+
+    // Слова, которые уже стоят в нужном порядке, остаются на месте
+    const std::vector<bool> stable = longestIncreasing(positions, size);
+
+    // Остальные встают цепочками перед ближайшим следующим неподвижным словом (или концом).
+    // Перед каждым таким якорем заводятся места под его цепочку, так что порядок мест -
+    // порядок строк, а номер строки считает RowIndex за log n вместо поиска по списку
+    std::vector<qint32> anchorOf(static_cast<size_t>(size), 0);
+    std::vector<qint32> depth(static_cast<size_t>(size), 0);
+    std::vector<qint32> chainLength(static_cast<size_t>(kept) + 1, 0);
+    for (qint32 i = size - 1; i >= 0; --i) {
+        if (stable[static_cast<size_t>(i)])
+            continue;
+        if (i + 1 == size || stable[static_cast<size_t>(i) + 1]) {
+            anchorOf[static_cast<size_t>(i)] = i + 1 == size ? kept : remaining[static_cast<size_t>(i) + 1];
+            depth[static_cast<size_t>(i)] = 1;
+        } else {
+            anchorOf[static_cast<size_t>(i)] = anchorOf[static_cast<size_t>(i) + 1];
+            depth[static_cast<size_t>(i)] = depth[static_cast<size_t>(i) + 1] + 1;
+        }
+        qint32& length = chainLength[static_cast<size_t>(anchorOf[static_cast<size_t>(i)])];
+        length = qMax(length, depth[static_cast<size_t>(i)]);
+    }
+    std::vector<qint32> anchorSlot(static_cast<size_t>(kept) + 1, 0);
+    qint32 slots = 0;
+    for (qint32 anchor = 0; anchor <= kept; ++anchor) {
+        slots += chainLength[static_cast<size_t>(anchor)];
+        anchorSlot[static_cast<size_t>(anchor)] = slots++;
+    }
+
+    RowIndex rows(slots);
+    std::vector<qint32> slotOf(static_cast<size_t>(size), -1);
+    for (qint32 i = 0; i < size; ++i) {
+        const qint32 row = remaining[static_cast<size_t>(i)];
+        if (row < 0)
+            continue;
+        slotOf[static_cast<size_t>(i)] = anchorSlot[static_cast<size_t>(row)];
+        rows.add(slotOf[static_cast<size_t>(i)], 1);
+    }
+
+    // С конца: каждое слово ставится прямо перед уже расставленным следующим
+    for (qint32 i = size - 1; i >= 0; --i) {
+        if (stable[static_cast<size_t>(i)])
+            continue;
+        const qint32 next = i + 1 < size ? slotOf[static_cast<size_t>(i) + 1] : anchorSlot[static_cast<size_t>(kept)];
+        const qint32 anchor = rows.rowsBefore(next);
+        const qint32 current = slotOf[static_cast<size_t>(i)];
+        if (current < 0) {
+            diff.steps.append({Op::Insert, anchor, 0, to[i].first, to[i].second});
+        } else {
+            const qint32 row = rows.rowsBefore(current);
+            if (row != anchor - 1)
+                diff.steps.append({Op::Move, row, anchor, 0, QString()});
+            rows.add(current, -1);
+        }
+        // Место сразу перед следующим: между ними строк нет
+        slotOf[static_cast<size_t>(i)] = next - 1;
+        rows.add(next - 1, 1);
+    }
+
+    for (qint32 row = 0; row < size; ++row) {
+        if (remaining[static_cast<size_t>(row)] >= 0 && previousCount[static_cast<size_t>(row)] != to[row].first)
+            diff.steps.append({Op::Count, row, 0, to[row].first, QString()});
+    }
+    return diff;
+}
+
+void TopWordsDiff::apply(TopList& list) const
+{
+    for (const Step& step : steps)
+        applyStep(list, step);
+}
@@ -0,0 +1,60 @@
+#ifndef TOPWORDSDIFF_H
+#define TOPWORDSDIFF_H
+
+#include <QMetaType>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include <memory>
+
+// Разница между двумя соседними топами: что удалить, вставить, переставить и у
+// кого поменялся счёт. Шаги идут в порядке применения, номера строк - на момент
+// шага, так что модель отдаёт их прямо в beginRemoveRows/beginMoveRows/dataChanged.
+// version/baseVersion связывают цепочку: применять можно только к топу baseVersion,
+// иначе (пропущенное обновление, сброс модели) берётся result целиком.
+struct TopWordsDiff {
+    using TopList = QVector<QPair<quint64, QString>>;
+
+    enum class Op : quint8 {
+        Remove,     // row
+        Insert,     // перед row, count и word
+        Move,       // row -> to, to в нумерации до перемещения (как у beginMoveRows)
+        Count       // row получает count
+    };
+
+    struct Step {
+        Op op;
+        qint32 row;
+        qint32 to;
+        quint64 count;
+        QString word;
+    };
+
+    quint64 baseVersion = 0;
+    quint64 version = 0;
+    qint32 fromSize = 0;
+    QVector<Step> steps;
+    TopList result;     // разделяется с сигналом topWords, копии нет
+
+    // Слова в списках уникальны. Перемещений столько, сколько слов вне наибольшей
+    // возрастающей подпоследовательности: слово, обогнавшее соседей, переезжает одно
+    static TopWordsDiff compute(const TopList& from, const TopList& to);
+    // Для проверок: применяет шаги к обычному списку
+    void apply(TopList& list) const;
+};
+
+// Топ, опубликованный анализатором. После публикации не меняется, поэтому
+// читатели из любого потока держат его через shared_ptr без копий и блокировок.
+// Версия растёт только тогда, когда топ действительно изменился
+struct TopWordsSnapshot {
+    quint64 version = 0;
+    TopWordsDiff::TopList top;
+    QVector<quint64> errors;    // approximate_counting: погрешность каждой строки top
+    TopWordsDiff diff;          // от снимка version - 1; считается, только если снимки кто-то читает
+};
+
+using TopWordsSnapshotPtr = std::shared_ptr<const TopWordsSnapshot>;
+
+Q_DECLARE_METATYPE(TopWordsDiff)
+
+#endif // TOPWORDSDIFF_H
@@ -2,6 +2,7 @@
 
 TopWordsModel::TopWordsModel(QObject* parent) : QAbstractListModel(parent) {
     maxCount = 0;
+    version = 0;
 }
 
 int TopWordsModel::rowCount(const QModelIndex& parent) const {
@@ -34,45 +35,55 @@ QHash<int, QByteArray> TopWordsModel::roleNames() const {
 void TopWordsModel::resetTopWords(const QVector<QPair<quint64, QString>>& newTopWords) {
     beginResetModel();
     topWords = newTopWords;
-    quint64 newMax = calculateMax();
-    if (newMax != maxCount) {
-        maxCount = newMax;
-        emit maxCountChanged();
-    }
+    version = 0;
     endResetModel();
+    updateMax();
 }
 
-void TopWordsModel::updateWord(int index, quint64 newCount, const QString& word) {
-    if (index < 0 || index >= topWords.size())
+void TopWordsModel::applyDiff(const TopWordsDiff& diff) {
+    if (diff.baseVersion != version || diff.fromSize != topWords.size()) {
+        resetTopWords(diff.result);
+        version = diff.version;
         return;
-    auto& pair = topWords[index];
-    bool countChanged = (newCount != pair.first);
-    bool wordChanged = (!word.isEmpty() && word != pair.second);
-    if (countChanged || wordChanged) {
-        pair.first = newCount;
-        if (!word.isEmpty()) pair.second = word;
-        const QModelIndex idx = createIndex(index, 0);
-        emit dataChanged(idx, idx, {CountRole, WordRole});
+    }
 
-        if (countChanged) {
-            quint64 newMax = calculateMax();
-            if (newMax != maxCount) {
-                maxCount = newMax;
-                emit maxCountChanged();
-            }
+    for (const TopWordsDiff::Step& step : diff.steps) {
+        switch (step.op) {
+        case TopWordsDiff::Op::Remove:
+            beginRemoveRows(QModelIndex(), step.row, step.row);
+            topWords.remove(step.row);
+            endRemoveRows();
+            break;
+        case TopWordsDiff::Op::Insert:
+            beginInsertRows(QModelIndex(), step.row, step.row);
+            topWords.insert(step.row, {step.count, step.word});
+            endInsertRows();
+            break;
+        case TopWordsDiff::Op::Move:
+            beginMoveRows(QModelIndex(), step.row, step.row, QModelIndex(), step.to);
+            topWords.move(step.row, step.to > step.row ? step.to - 1 : step.to);
+            endMoveRows();
+            break;
+        case TopWordsDiff::Op::Count: {
+            topWords[step.row].first = step.count;
+            const QModelIndex idx = createIndex(step.row, 0);
+            emit dataChanged(idx, idx, {CountRole});
+            break;
+        }
         }
     }
+    version = diff.version;
+    updateMax();
 }
+
 quint64 TopWordsModel::getMaxCount() const {
     return maxCount;
 }
 
-quint64 TopWordsModel::calculateMax() const {
-    if (topWords.isEmpty()) return 0;
-    quint64 max = 0;
-    for (const auto& pair : topWords) {
-        if (pair.first > max)
-            max = pair.first;
+void TopWordsModel::updateMax() {
+    const quint64 newMax = topWords.isEmpty() ? 0 : topWords.last().first;
+    if (newMax != maxCount) {
+        maxCount = newMax;
+        emit maxCountChanged();
     }
-    return max;
 }
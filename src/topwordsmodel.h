@@ -4,7 +4,9 @@
 #include <QAbstractListModel>
 #include <QPair>
 #include <QVector>
+#include "topwordsdiff.h"
 
+// Строки идут по возрастанию счёта, как их отдаёт анализатор: максимум - последняя
 class TopWordsModel : public QAbstractListModel {
     Q_OBJECT
     Q_PROPERTY(quint64 maxCount READ getMaxCount NOTIFY maxCountChanged)
@@ -22,14 +24,16 @@ public:
 
     quint64 getMaxCount() const;
     void resetTopWords(const QVector<QPair<quint64, QString>>& newTopWords);
-    void updateWord(int index, quint64 newCount, const QString& word = QString());
+    // Шаги разницы - точечными сигналами модели; если модель не на diff.baseVersion, сброс на diff.result
+    void applyDiff(const TopWordsDiff& diff);
 
 signals:
     void maxCountChanged();
 private:
     QVector<QPair<quint64, QString>> topWords;
     quint64 maxCount;
-    quint64 calculateMax() const;
+    quint64 version;    // TopWordsDiff::version текущего содержимого, 0 - после resetTopWords
+    void updateMax();
 };
 
 #endif // TOPWORDSMODEL_H
@@ -0,0 +1,224 @@
+#include "tracer.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const char* argName;
+    qint64 startNs;
+    qint64 durationNs;
+    qint64 arg;
+};
+
+// Буфер одного потока: список блоков, в который пишет только сам поток.
+// Число событий в блоке публикуется release-записью, поэтому stop() из
+// другого потока видит только дописанные события
+struct TraceChunk {
+    static constexpr qsizetype kEvents = 4096;
+    TraceEvent events[kEvents];
+    std::atomic<qsizetype> count{0};
+    std::atomic<TraceChunk*> next{nullptr};
+};
+
+struct ThreadBuffer {
+    qint32 tid = 0;
+    QString name;
+    std::atomic<quint64> generation{0};
+    std::unique_ptr<TraceChunk> head = std::make_unique<TraceChunk>();
+    TraceChunk* tail = nullptr;
+
+    ~ThreadBuffer()
+    {
+        TraceChunk* chunk = head->next.load();
+        while (chunk) {
+            TraceChunk* next = chunk->next.load();
+            delete chunk;
+            chunk = next;
+        }
+    }
+};
+
+struct Registry {
+    QMutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::atomic<quint64> generation{0};
+    std::atomic<qint64> originNs{0};
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+qint64 steadyNs() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ThreadBuffer* threadBuffer()
+{
+    // Буфер переживает свой поток (потоки пула приходят и уходят), его события нужны в stop()
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer)
+        return buffer;
+
+    auto created = std::make_unique<ThreadBuffer>();
+    QThread* thread = QThread::currentThread();
+    created->name = thread->objectName();
+    if (created->name.isEmpty())
+        created->name = QString::fromLatin1(thread->metaObject()->className());
+    created->tail = created->head.get();
+
+    Registry& reg = registry();
+    QMutexLocker locker(&reg.mutex);
+    created->tid = static_cast<qint32>(reg.buffers.size()) + 1;
+    created->generation = reg.generation.load();
+    buffer = created.get();
+    reg.buffers.push_back(std::move(created));
+    return buffer;
+}
+
+void appendJsonString(QByteArray& out, const QString& value)
+{
+    out.append('"');
+    for (QChar ch : value) {
+        if (ch == '"' || ch == '\\') {
+            out.append('\\');
+            out.append(static_cast<char>(ch.unicode()));
+        } else if (ch.unicode() < 0x20) {
+            out.append(' ');
+        } else {
+            out.append(QString(ch).toUtf8());
+        }
+    }
+    out.append('"');
+}
+
+} // namespace
+
+std::atomic<bool> Tracer::_enabled{false};
+
+void Tracer::start()
+{
+    Registry& reg = registry();
+    reg.originNs = steadyNs();
+    // Потоки сбрасывают свои буферы сами, на первом событии нового поколения
+    reg.generation.fetch_add(1);
+    _enabled = true;
+}
+
+qint64 Tracer::now() noexcept
+{
+    return steadyNs() - registry().originNs.load(std::memory_order_relaxed);
+}
+
+void Tracer::record(const char* name, qint64 startNs, qint64 endNs, const char* argName, qint64 arg)
+{
+    if (!isEnabled())
+        return;
+
+    ThreadBuffer* buffer = threadBuffer();
+    const quint64 generation = registry().generation.load(std::memory_order_relaxed);
+    if (buffer->generation.load(std::memory_order_relaxed) != generation) {
+        for (TraceChunk* chunk = buffer->head.get(); chunk; chunk = chunk->next.load(std::memory_order_relaxed))
+            chunk->count.store(0, std::memory_order_release);
+        buffer->tail = buffer->head.get();
+        buffer->generation.store(generation, std::memory_order_release);
+    }
+
+    TraceChunk* chunk = buffer->tail;
+    qsizetype count = chunk->count.load(std::memory_order_relaxed);
+    if (count == TraceChunk::kEvents) {
+        // Блоки прошлых поколений переиспользуются
+        TraceChunk* next = chunk->next.load(std::memory_order_relaxed);
+        if (!next) {
+            next = new TraceChunk;
+            chunk->next.store(next, std::memory_order_release);
+        }
+        buffer->tail = chunk = next;
+        count = 0;
+    }
+    chunk->events[count] = {name, argName, startNs, qMax<qint64>(0, endNs - startNs), arg};
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+bool Tracer::stop(const QString& path, QString* error)
+{
+    _enabled = false;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (error)
+            *error = "Cannot write trace " + path + ": " + file.errorString();
+        return false;
+    }
+
+    Registry& reg = registry();
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    const quint64 generation = reg.generation.load();
+    QByteArray out;
+    out.reserve(1 << 20);
+    out.append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    const auto separator = [&out, &first]() {
+        if (!first)
+            out.append(",\n");
+        first = false;
+    };
+
+    QMutexLocker locker(&reg.mutex);
+    for (const auto& buffer : reg.buffers) {
+        // Поток, не писавший с прошлого start(), держит чужие события
+        if (buffer->generation.load(std::memory_order_acquire) != generation)
+            continue;
+
+        separator();
+        out.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid
+                   + ",\"tid\":" + QByteArray::number(buffer->tid) + ",\"args\":{\"name\":");
+        appendJsonString(out, buffer->name);
+        out.append("}}");
+
+        for (TraceChunk* chunk = buffer->head.get(); chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            const qsizetype count = chunk->count.load(std::memory_order_acquire);
+            for (qsizetype i = 0; i < count; ++i) {
+                const TraceEvent& event = chunk->events[i];
+                separator();
+                out.append("{\"name\":\"");
+                out.append(event.name);
+                out.append("\",\"ph\":\"X\",\"pid\":" + pid
+                           + ",\"tid\":" + QByteArray::number(buffer->tid)
+                           + ",\"ts\":" + QByteArray::number(event.startNs / 1000.0, 'f', 3)
+                           + ",\"dur\":" + QByteArray::number(event.durationNs / 1000.0, 'f', 3));
+                if (event.argName) {
+                    out.append(",\"args\":{\"");
+                    out.append(event.argName);
+                    out.append("\":" + QByteArray::number(event.arg) + '}');
+                }
+                out.append('}');
+            }
+            if (out.size() > (1 << 20)) {
+                file.write(out);
+                out.resize(0);
+            }
+        }
+    }
+    locker.unlock();
+
+    out.append("\n]}\n");
+    if (file.write(out) != out.size() || !file.flush()) {
+        if (error)
+            *error = "Cannot write trace " + path + ": " + file.errorString();
+        return false;
+    }
+    return true;
+}
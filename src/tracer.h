@@ -0,0 +1,59 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+
+// Трассировка конвейера в формате Chrome trace event (открывается в Perfetto и
+// chrome://tracing). Каждый поток пишет события в свой буфер без блокировок;
+// файл собирается в stop(). Пока трассировка выключена, TraceSpan - одна
+// relaxed-загрузка флага.
+class Tracer {
+public:
+    static bool isEnabled() noexcept { return _enabled.load(std::memory_order_relaxed); }
+
+    // Включает запись; события прошлых запусков выбрасываются
+    static void start();
+    // Выключает запись и сохраняет всё записанное в path
+    static bool stop(const QString& path, QString* error = nullptr);
+
+    // Наносекунды от start()
+    static qint64 now() noexcept;
+    // name - строковый литерал: хранится только указатель. argName/arg - метка
+    // события (смещение блока, размер), argName == nullptr - без метки
+    static void record(const char* name, qint64 startNs, qint64 endNs,
+                       const char* argName = nullptr, qint64 arg = 0);
+
+private:
+    static std::atomic<bool> _enabled;
+};
+
+// Интервал от конструктора до деструктора
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* argName = nullptr, qint64 arg = 0) noexcept
+        : _name(name), _argName(argName), _arg(arg),
+          _startNs(Q_UNLIKELY(Tracer::isEnabled()) ? Tracer::now() : -1)
+    {
+    }
+    ~TraceSpan()
+    {
+        if (Q_UNLIKELY(_startNs >= 0))
+            Tracer::record(_name, _startNs, Tracer::now(), _argName, _arg);
+    }
+
+    // Метка, известная только к концу интервала
+    void setArg(const char* argName, qint64 arg) noexcept { _argName = argName; _arg = arg; }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* _name;
+    const char* _argName;
+    qint64 _arg;
+    qint64 _startNs;
+};
+
+#endif // TRACER_H
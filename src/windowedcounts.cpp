@@ -0,0 +1,132 @@
+#include "windowedcounts.h"
+#include <utility>
+
+WindowedCounts::WindowedCounts(Mode mode, qint64 spanMs, qint32 buckets, qsizetype topN)
+    : _mode(mode), _spanMs(qMax<qint64>(1, spanMs)), _top(topN), _epoch(-1), _landmark(0), _now(0)
+{
+    if (_mode == Mode::Sliding) {
+        const qint32 count = qBound<qint32>(1, buckets, static_cast<qint32>(qMin<qint64>(_spanMs, 1 << 16)));
+        _bucketMs = qMax<qint64>(1, _spanMs / count);
+        _buckets.resize(static_cast<size_t>(count));
+    } else {
+        _bucketMs = _spanMs;
+    }
+}
+
+bool WindowedCounts::add(QByteArrayView word, quint64 hash, quint64 delta, qint64 nowMs)
+{
+    const bool moved = advance(nowMs);
+
+    quint64 stored;
+    if (_mode == Mode::Sliding) {
+        stored = _window.add(word, hash, delta);
+        _buckets[static_cast<size_t>(_epoch % static_cast<qint64>(_buckets.size()))].add(word, hash, delta);
+    } else {
+        const double scaled = static_cast<double>(delta) * weight(_now);
+        stored = _window.add(word, hash, static_cast<quint64>(std::llround(scaled)));
+    }
+    return _top.update(word, hash, stored) || moved;
+}
+
+bool WindowedCounts::advance(qint64 nowMs)
+{
+    // Часы воркеров читаются без общей блокировки: небольшой откат времени не сдвигает окно назад
+    if (nowMs < _now)
+        nowMs = _now;
+    _now = nowMs;
+
+    const qint64 epoch = _now / _bucketMs;
+    if (_epoch < 0) {
+        _epoch = epoch;
+        return false;
+    }
+    if (epoch == _epoch)
+        return false;
+
+    if (_mode == Mode::Decay) {
+        _epoch = epoch;
+        if (_now - _landmark > kRenormHalfLives * _spanMs) {
+            renormalize(_now);
+            rebuildTop();
+        }
+        return !_window.isEmpty();
+    }
+
+    const qint64 bucketCount = static_cast<qint64>(_buckets.size());
+    bool expired = false;
+    if (epoch - _epoch >= bucketCount) {
+        // Простой дольше окна: истекло всё
+        expired = !_window.isEmpty();
+        _window.reset();
+        for (WordCountTable& bucket : _buckets)
+            bucket.reset();
+        _epoch = epoch;
+    } else {
+        while (_epoch < epoch) {
+            ++_epoch;
+            // Интервал, в который сейчас начнём писать, - самый старый в окне
+            WordCountTable& bucket = _buckets[static_cast<size_t>(_epoch % bucketCount)];
+            expired = expired || !bucket.isEmpty();
+            expireBucket(bucket);
+        }
+    }
+    if (expired)
+        rebuildTop();
+    return expired;
+}
+
+size_t WindowedCounts::memoryUsage() const noexcept
+{
+    size_t total = _window.memoryUsage() + _top.memoryUsage();
+    for (const WordCountTable& bucket : _buckets)
+        total += bucket.memoryUsage();
+    return total;
+}
+
+void WindowedCounts::clear() noexcept
+{
+    _window.clear();
+    for (WordCountTable& bucket : _buckets)
+        bucket.clear();
+    _top.clear();
+    _epoch = -1;
+    _landmark = 0;
+    _now = 0;
+}
+
+double WindowedCounts::weight(qint64 t) const noexcept
+{
+    return std::ldexp(std::exp2(static_cast<double>(t - _landmark) / static_cast<double>(_spanMs)), kFracBits);
+}
+
+void WindowedCounts::expireBucket(WordCountTable& bucket)
+{
+    if (bucket.isEmpty())
+        return;
+    bucket.forEach([this](QByteArrayView word, quint64 hash, quint64 count) {
+        _window.subtract(word, hash, count);
+    });
+    bucket.reset();
+}
+
+void WindowedCounts::renormalize(qint64 nowMs)
+{
+    // Переносим точку отсчёта в nowMs; слова, чей вес упал ниже 2^-kFracBits, отбрасываются
+    const double factor = std::exp2(static_cast<double>(nowMs - _landmark) / static_cast<double>(_spanMs));
+    WordCountTable next;
+    _window.forEach([&next, factor](QByteArrayView word, quint64 hash, quint64 stored) {
+        const quint64 rescaled = static_cast<quint64>(static_cast<double>(stored) / factor);
+        if (rescaled)
+            next.add(word, hash, rescaled);
+    });
+    _window = std::move(next);
+    _landmark = nowMs;
+}
+
+void WindowedCounts::rebuildTop()
+{
+    _top.clear();
+    _window.forEach([this](QByteArrayView word, quint64 hash, quint64 stored) {
+        _top.update(word, hash, stored);
+    });
+}
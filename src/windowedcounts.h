@@ -0,0 +1,105 @@
+#ifndef WINDOWEDCOUNTS_H
+#define WINDOWEDCOUNTS_H
+
+#include <QByteArrayView>
+#include <QtGlobal>
+#include <cmath>
+#include <vector>
+#include "topcandidates.h"
+#include "wordcounttable.h"
+
+// Счётчики слов за недавнее время. Время - миллисекунды от любой точки отсчёта,
+// лишь бы не убывало.
+//
+// Sliding: окно из buckets интервалов по spanMs / buckets. Каждый интервал хранит
+// свои приращения, общая таблица - их сумму. Истёкший интервал вычитается из
+// суммы целиком, так что устаревание стоит столько, сколько слов было в этом
+// интервале, а не во всей таблице. Окно покрывает текущий неполный интервал и
+// buckets - 1 предыдущих.
+//
+// Decay: вес вхождения в момент t равен 2^((t - now) / spanMs). Хранится
+// "forward decay": приращение умножается на растущий множитель 2^((t - landmark) / spanMs),
+// при чтении всё делится на множитель текущего момента. Порядок слов от этого не
+// зависит, а полная перепаковка с отбрасыванием угасших слов нужна лишь раз в
+// kRenormHalfLives полупериодов.
+//
+// Кандидаты в топ (TopCandidates) держатся рядом с окном: между сдвигами
+// хранимые счётчики только растут. Истечение интервала или перепаковка
+// уменьшают их, тогда кандидаты собираются заново обходом окна.
+class WindowedCounts
+{
+public:
+    enum class Mode {
+        Sliding,
+        Decay
+    };
+
+    // spanMs - длина окна для Sliding и полупериод для Decay; topN - сколько слов
+    // держать кандидатами для forEachTop, 0 - не держать
+    WindowedCounts(Mode mode, qint64 spanMs, qint32 buckets, qsizetype topN = 0);
+
+    // true - топ мог измениться: изменились кандидаты или окно сдвинулось
+    bool add(QByteArrayView word, quint64 hash, quint64 delta, qint64 nowMs);
+    // Сдвигает окно к nowMs: истёкшие интервалы вычитаются, затухание пересчитывается.
+    // true - значения изменились без новых данных: истёк непустой интервал (Sliding)
+    // или прошёл полупериод (Decay: порядок тот же, счётчики вдвое меньше)
+    bool advance(qint64 nowMs);
+
+    // f(QByteArrayView word, quint64 count) - значение на момент последнего advance()/add().
+    // Для Decay count округлён, слова с нулевым округлённым весом пропускаются
+    template <typename F>
+    void forEach(F&& f) const
+    {
+        if (_mode == Mode::Sliding) {
+            _window.forEach([&f](QByteArrayView word, quint64, quint64 count) { f(word, count); });
+            return;
+        }
+        const double scale = weight(_now);
+        _window.forEach([&f, scale](QByteArrayView word, quint64, quint64 stored) {
+            const quint64 count = static_cast<quint64>(std::llround(static_cast<double>(stored) / scale));
+            if (count)
+                f(word, count);
+        });
+    }
+
+    // То же по кандидатам: топ из topN слов среди них целиком
+    template <typename F>
+    void forEachTop(F&& f) const
+    {
+        if (_mode == Mode::Sliding) {
+            _top.forEach(f);
+            return;
+        }
+        const double scale = weight(_now);
+        _top.forEach([&f, scale](QByteArrayView word, quint64 stored) {
+            const quint64 count = static_cast<quint64>(std::llround(static_cast<double>(stored) / scale));
+            if (count)
+                f(word, count);
+        });
+    }
+
+    qsizetype size() const noexcept { return _window.size(); }
+    size_t memoryUsage() const noexcept;
+    void clear() noexcept;
+
+private:
+    static constexpr int kFracBits = 8;             // дробная часть веса при хранении
+    static constexpr int kRenormHalfLives = 20;     // множитель не растёт выше 2^(8 + 20)
+
+    double weight(qint64 t) const noexcept;
+    void expireBucket(WordCountTable& bucket);
+    void renormalize(qint64 nowMs);
+    void rebuildTop();
+
+    Mode _mode;
+    qint64 _spanMs;
+    qint64 _bucketMs;
+    WordCountTable _window;                 // Sliding: сумма интервалов, Decay: взвешенные счётчики
+    std::vector<WordCountTable> _buckets;
+    TopCandidates _top;                     // по хранимым значениям _window
+    qint64 _epoch;                          // номер интервала (Decay - полупериода), -1 - ещё не было данных
+    qint64 _landmark;
+    qint64 _now;
+};
+
+#endif // WINDOWEDCOUNTS_H
@@ -0,0 +1,250 @@
+#include "wordcounttable.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kArenaChunkSize = 256 * 1024;
+constexpr size_t kInitialCapacity = 64;
+
+inline quint64 load64(const char* p) noexcept
+{
+    quint64 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline quint64 fmix64(quint64 h) noexcept
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+} // namespace
+
+const char* WordArena::store(QByteArrayView bytes)
+{
+    const size_t len = static_cast<size_t>(bytes.size());
+
+    while (_current < _chunks.size() && _chunks[_current].size - _used < len) {
+        ++_current;
+        _used = 0;
+    }
+    if (_current == _chunks.size()) {
+        const size_t size = qMax(kArenaChunkSize, len);
+        _chunks.push_back({std::make_unique<char[]>(size), size});
+        _used = 0;
+    }
+
+    char* dst = _chunks[_current].data.get() + _used;
+    if (len)
+        std::memcpy(dst, bytes.data(), len);
+    _used += len;
+    return dst;
+}
+
+void WordArena::rewind() noexcept
+{
+    _current = 0;
+    _used = 0;
+}
+
+void WordArena::release() noexcept
+{
+    _chunks.clear();
+    _chunks.shrink_to_fit();
+    _current = 0;
+    _used = 0;
+}
+
+size_t WordArena::bytesReserved() const noexcept
+{
+    size_t total = 0;
+    for (const Chunk& chunk : _chunks)
+        total += chunk.size;
+    return total;
+}
+
+WordCountTable::WordCountTable() : _mask(0), _size(0), _keyBytes(0), _deadKeyBytes(0)
+{
+}
+
+quint64 WordCountTable::hash(QByteArrayView word) noexcept
+{
+    const char* p = word.data();
+    qsizetype n = word.size();
+    quint64 h = 0x9E3779B97F4A7C15ULL ^ static_cast<quint64>(n);
+
+    while (n >= 8) {
+        h = (h ^ load64(p)) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 29;
+        p += 8;
+        n -= 8;
+    }
+    if (n > 0) {
+        quint64 tail = 0;
+        std::memcpy(&tail, p, static_cast<size_t>(n));
+        h = (h ^ tail) * 0x9E3779B97F4A7C15ULL;
+    }
+    return fmix64(h);
+}
+
+quint64 WordCountTable::add(QByteArrayView word, quint64 hash, quint64 delta)
+{
+    // Держим заполнение не выше 3/4
+    if ((_size + 1) * 4 > _slots.size() * 3)
+        grow();
+
+    size_t i = static_cast<size_t>(hash) & _mask;
+    while (true) {
+        Slot& slot = _slots[i];
+        if (!slot.key) {
+            slot.hash = hash;
+            slot.key = _arena.store(word);
+            slot.length = word.size();
+            slot.count = delta;
+            ++_size;
+            _keyBytes += static_cast<size_t>(word.size());
+            return delta;
+        }
+        if (slot.hash == hash && slot.length == word.size()
+            && std::memcmp(slot.key, word.data(), static_cast<size_t>(word.size())) == 0) {
+            slot.count += delta;
+            return slot.count;
+        }
+        i = (i + 1) & _mask;
+    }
+}
+
+quint64 WordCountTable::subtract(QByteArrayView word, quint64 hash, quint64 delta)
+{
+    if (_slots.empty())
+        return 0;
+
+    size_t i = static_cast<size_t>(hash) & _mask;
+    while (true) {
+        Slot& slot = _slots[i];
+        if (!slot.key)
+            return 0;
+        if (slot.hash == hash && slot.length == word.size()
+            && std::memcmp(slot.key, word.data(), static_cast<size_t>(word.size())) == 0) {
+            if (slot.count > delta) {
+                slot.count -= delta;
+                return slot.count;
+            }
+            eraseSlot(i);
+            // Арена не умеет освобождать по одному ключу: перепаковываем, когда мёртвых больше живых
+            if (_deadKeyBytes > kArenaChunkSize && _deadKeyBytes > _keyBytes)
+                compactKeys();
+            return 0;
+        }
+        i = (i + 1) & _mask;
+    }
+}
+
+quint64 WordCountTable::value(QByteArrayView word, quint64 h) const noexcept
+{
+    if (_slots.empty())
+        return 0;
+
+    size_t i = static_cast<size_t>(h) & _mask;
+    while (true) {
+        const Slot& slot = _slots[i];
+        if (!slot.key)
+            return 0;
+        if (slot.hash == h && slot.length == word.size()
+            && std::memcmp(slot.key, word.data(), static_cast<size_t>(word.size())) == 0)
+            return slot.count;
+        i = (i + 1) & _mask;
+    }
+}
+
+size_t WordCountTable::memoryUsage() const noexcept
+{
+    return _slots.capacity() * sizeof(Slot) + _arena.bytesReserved();
+}
+
+WordCountTable::Snapshot WordCountTable::snapshot() const
+{
+    Snapshot copy;
+    copy._slots = _slots;
+    return copy;
+}
+
+void WordCountTable::clear() noexcept
+{
+    std::vector<Slot>().swap(_slots);
+    _mask = 0;
+    _size = 0;
+    _arena.release();
+    _keyBytes = 0;
+    _deadKeyBytes = 0;
+}
+
+void WordCountTable::reset() noexcept
+{
+    if (_size)
+        std::fill(_slots.begin(), _slots.end(), Slot{0, nullptr, 0, 0});
+    _size = 0;
+    _arena.rewind();
+    _keyBytes = 0;
+    _deadKeyBytes = 0;
+}
+
+void WordCountTable::grow()
+{
+    const size_t capacity = _slots.empty() ? kInitialCapacity : _slots.size() * 2;
+    std::vector<Slot> old;
+    old.swap(_slots);
+    _slots.assign(capacity, Slot{0, nullptr, 0, 0});
+    _mask = capacity - 1;
+
+    // Ключи остаются в арене, переносятся только слоты
+    for (const Slot& slot : old) {
+        if (!slot.key)
+            continue;
+        size_t i = static_cast<size_t>(slot.hash) & _mask;
+        while (_slots[i].key)
+            i = (i + 1) & _mask;
+        _slots[i] = slot;
+    }
+}
+
+void WordCountTable::eraseSlot(size_t pos) noexcept
+{
+    _keyBytes -= static_cast<size_t>(_slots[pos].length);
+    _deadKeyBytes += static_cast<size_t>(_slots[pos].length);
+    --_size;
+
+    // Удаление без надгробий: сдвигаем назад следующие слоты цепочки,
+    // чей домашний индекс не лежит циклически в (pos, j]
+    size_t i = pos;
+    size_t j = pos;
+    while (true) {
+        j = (j + 1) & _mask;
+        if (!_slots[j].key)
+            break;
+        const size_t home = static_cast<size_t>(_slots[j].hash) & _mask;
+        const bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (stays)
+            continue;
+        _slots[i] = _slots[j];
+        i = j;
+    }
+    _slots[i] = Slot{0, nullptr, 0, 0};
+}
+
+void WordCountTable::compactKeys()
+{
+    WordArena arena;
+    for (Slot& slot : _slots) {
+        if (slot.key)
+            slot.key = arena.store(QByteArrayView(slot.key, slot.length));
+    }
+    _arena = std::move(arena);
+    _deadKeyBytes = 0;
+}
@@ -0,0 +1,118 @@
+#ifndef WORDCOUNTTABLE_H
+#define WORDCOUNTTABLE_H
+
+#include <QByteArrayView>
+#include <QtGlobal>
+#include <memory>
+#include <vector>
+
+// Bump-аллокатор для байтов ключей. Память освобождается только целиком.
+class WordArena
+{
+public:
+    WordArena() = default;
+    WordArena(const WordArena&) = delete;
+    WordArena& operator=(const WordArena&) = delete;
+    WordArena(WordArena&&) noexcept = default;
+    WordArena& operator=(WordArena&&) noexcept = default;
+
+    const char* store(QByteArrayView bytes);
+    // Начать заново, не отдавая память системе
+    void rewind() noexcept;
+    void release() noexcept;
+    size_t bytesReserved() const noexcept;
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    std::vector<Chunk> _chunks;
+    size_t _current = 0;
+    size_t _used = 0;
+};
+
+// Таблица "слово в UTF-8 -> счётчик" с открытой адресацией и линейным
+// пробированием. В слоте хранится полный хеш, так что при поиске байты
+// ключа сравниваются только при совпадении хеша; сами ключи лежат в WordArena.
+class WordCountTable
+{
+public:
+    WordCountTable();
+
+    static quint64 hash(QByteArrayView word) noexcept;
+
+    // Прибавляет delta к счётчику слова, возвращает новое значение
+    quint64 add(QByteArrayView word, quint64 hash, quint64 delta = 1);
+    quint64 add(QByteArrayView word) { return add(word, hash(word)); }
+    // Вычитает delta (не ниже нуля), слово с нулевым счётчиком удаляется.
+    // Возвращает новое значение
+    quint64 subtract(QByteArrayView word, quint64 hash, quint64 delta);
+    quint64 value(QByteArrayView word, quint64 hash) const noexcept;
+    quint64 value(QByteArrayView word) const noexcept { return value(word, hash(word)); }
+
+    qsizetype size() const noexcept { return static_cast<qsizetype>(_size); }
+    bool isEmpty() const noexcept { return _size == 0; }
+    size_t memoryUsage() const noexcept;
+
+    // clear() отдаёт всю память, reset() оставляет её для следующего блока
+    void clear() noexcept;
+    void reset() noexcept;
+
+    // f(QByteArrayView word, quint64 hash, quint64 count)
+    template <typename F>
+    void forEach(F&& f) const
+    {
+        for (const Slot& slot : _slots) {
+            if (slot.key)
+                f(QByteArrayView(slot.key, slot.length), slot.hash, slot.count);
+        }
+    }
+
+private:
+    struct Slot {
+        quint64 hash;
+        const char* key;    // nullptr - пустой слот
+        quint64 count;
+        qsizetype length;
+    };
+
+public:
+    // Копия массива слотов без ключей: её можно обходить без блокировки таблицы,
+    // пока ключи на месте - таблица только прибавляет (add) и не очищается
+    class Snapshot
+    {
+    public:
+        // f(QByteArrayView word, quint64 hash, quint64 count)
+        template <typename F>
+        void forEach(F&& f) const
+        {
+            for (const Slot& slot : _slots) {
+                if (slot.key)
+                    f(QByteArrayView(slot.key, slot.length), slot.hash, slot.count);
+            }
+        }
+
+    private:
+        friend class WordCountTable;
+        std::vector<Slot> _slots;
+    };
+
+    Snapshot snapshot() const;
+
+private:
+
+    void grow();
+    void eraseSlot(size_t pos) noexcept;
+    void compactKeys();
+
+    std::vector<Slot> _slots;
+    size_t _mask;
+    size_t _size;
+    WordArena _arena;
+    size_t _keyBytes;       // байты живых ключей в арене
+    size_t _deadKeyBytes;   // байты удалённых ключей, возвращаются compactKeys()
+};
+
+#endif // WORDCOUNTTABLE_H
@@ -0,0 +1,95 @@
+#include "wordinterner.h"
+#include <QMutexLocker>
+#include <cstring>
+
+WordInterner::WordInterner(qint32 shardCount)
+{
+    const qint32 count = qMax(1, shardCount);
+    _shards.reserve(static_cast<size_t>(count));
+    for (qint32 i = 0; i < count; ++i)
+        _shards.push_back(std::make_unique<Shard>());
+}
+
+quint32 WordInterner::intern(QByteArrayView word, quint64 hash)
+{
+    // Шард - по старшим битам, как у шардов счётчиков; младшие заняты индексом
+    const quint32 shardCount = static_cast<quint32>(_shards.size());
+    const quint32 shardIndex = static_cast<quint32>((hash >> 32) % shardCount);
+    Shard& shard = *_shards[shardIndex];
+    QMutexLocker locker(&shard.mutex);
+
+    if ((shard.entries.size() + 1) * 4 > shard.index.size() * 3)
+        grow(shard);
+
+    size_t i = static_cast<size_t>(hash) & shard.mask;
+    while (quint32 slot = shard.index[i]) {
+        const Entry& entry = shard.entries[slot - 1];
+        if (entry.hash == hash && entry.length == word.size()
+            && std::memcmp(entry.key, word.data(), static_cast<size_t>(word.size())) == 0)
+            return (slot - 1) * shardCount + shardIndex;
+        i = (i + 1) & shard.mask;
+    }
+
+    shard.entries.push_back({shard.arena.store(word), word.size(), hash});
+    const quint32 local = static_cast<quint32>(shard.entries.size());
+    shard.index[i] = local;
+    return (local - 1) * shardCount + shardIndex;
+}
+
+QByteArrayView WordInterner::word(quint32 id) const
+{
+    const quint32 shardCount = static_cast<quint32>(_shards.size());
+    const Shard& shard = *_shards[id % shardCount];
+    const size_t local = id / shardCount;
+
+    QMutexLocker locker(&shard.mutex);
+    if (local >= shard.entries.size())
+        return {};
+    const Entry& entry = shard.entries[local];
+    return QByteArrayView(entry.key, entry.length);
+}
+
+qsizetype WordInterner::size() const
+{
+    qsizetype total = 0;
+    for (const auto& shard : _shards) {
+        QMutexLocker locker(&shard->mutex);
+        total += static_cast<qsizetype>(shard->entries.size());
+    }
+    return total;
+}
+
+size_t WordInterner::memoryUsage() const
+{
+    size_t total = 0;
+    for (const auto& shard : _shards) {
+        QMutexLocker locker(&shard->mutex);
+        total += shard->arena.bytesReserved() + shard->entries.capacity() * sizeof(Entry)
+                 + shard->index.capacity() * sizeof(quint32);
+    }
+    return total;
+}
+
+void WordInterner::clear()
+{
+    for (auto& shard : _shards) {
+        QMutexLocker locker(&shard->mutex);
+        shard->arena.release();
+        std::vector<Entry>().swap(shard->entries);
+        std::vector<quint32>().swap(shard->index);
+        shard->mask = 0;
+    }
+}
+
+void WordInterner::grow(Shard& shard)
+{
+    const size_t capacity = shard.index.empty() ? 1024 : shard.index.size() * 2;
+    shard.index.assign(capacity, 0);
+    shard.mask = capacity - 1;
+    for (size_t local = 0; local < shard.entries.size(); ++local) {
+        size_t i = static_cast<size_t>(shard.entries[local].hash) & shard.mask;
+        while (shard.index[i])
+            i = (i + 1) & shard.mask;
+        shard.index[i] = static_cast<quint32>(local + 1);
+    }
+}
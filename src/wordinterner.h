@@ -0,0 +1,50 @@
+#ifndef WORDINTERNER_H
+#define WORDINTERNER_H
+
+#include <QByteArrayView>
+#include <QMutex>
+#include <memory>
+#include <vector>
+#include "wordcounttable.h"
+
+// Номера слов для ключей n-грамм: n-грамма хранится как n номеров по 4 байта,
+// а не как склеенная строка, и каждое слово лежит в памяти один раз.
+// Слова делятся на шарды по хешу, у каждого свой мьютекс. Номер = индекс
+// в шарде * число шардов + шард, так что обратный поиск идёт сразу в нужный шард.
+// Номера живут до clear(); поиск идёт на каждое слово, поэтому воркеры держат
+// свой кэш слово -> номер и сюда приходят только с промахами.
+class WordInterner
+{
+public:
+    explicit WordInterner(qint32 shardCount);
+
+    // Потокобезопасно; hash - WordCountTable::hash(word)
+    quint32 intern(QByteArrayView word, quint64 hash);
+    // Пусто, если номера нет. View живёт до clear()
+    QByteArrayView word(quint32 id) const;
+
+    qsizetype size() const;
+    size_t memoryUsage() const;
+    void clear();
+
+private:
+    struct Entry {
+        const char* key;
+        qsizetype length;
+        quint64 hash;
+    };
+
+    struct Shard {
+        mutable QMutex mutex;
+        WordArena arena;
+        std::vector<Entry> entries;     // по индексу в шарде
+        std::vector<quint32> index;     // открытая адресация: индекс + 1, 0 - пусто
+        size_t mask = 0;
+    };
+
+    static void grow(Shard& shard);
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+};
+
+#endif // WORDINTERNER_H
@@ -3,16 +3,24 @@
 #include <QFileInfo>
 #include <QDir>
 #include "topwordsmodel.h"
+#include "logger.h"
+#include "tracer.h"
 
 WordPulseViewModel::WordPulseViewModel(QObject *parent) : QObject{parent}, _configPath("config.json"), _config(Config::fromJson(_configPath))
 {
+    Logger::setLevel(_config.log_level);
     _topWordsModel = new TopWordsModel(this);
     _progress = 0;
+    _shownSnapshot = 0;
      _topWordsModel->resetTopWords({});
     _isRunning = false;
     _isPaused = false;
     _fileChosen = false;
 
+    // Пауза, продолжение и follow есть только у чтения окнами отображения;
+    // read_backend async и ranges - только для CLI
+    if (_config.read_backend != Config::ReadBackend::Mmap)
+        qWarning() << "read_backend is ignored by the GUI, reading with mmap";
     reader = std::make_unique<FileReaderThread>("", _config);
     analyzer = std::make_unique<BlockAnalyzerThread>(_config, reader.get());
 
@@ -34,6 +42,10 @@ WordPulseViewModel::WordPulseViewModel(QObject *parent) : QObject{parent}, _conf
     connect(analyzer.get(), &BlockAnalyzerThread::thresholdBlockFreed,
             reader.get(), &FileReaderThread::readChunk, Qt::QueuedConnection);
 
+    // follow: файл растёт, прогресс считается от уже увиденного объёма
+    connect(reader.get(), &FileReaderThread::totalSizeChanged,
+            analyzer.get(), &BlockAnalyzerThread::setTotalSize, Qt::QueuedConnection);
+
     connect(this, &WordPulseViewModel::readingStarted, reader.get(), &FileReaderThread::startReading, Qt::QueuedConnection);
     connect(this, &WordPulseViewModel::readingStarted, analyzer.get(), &BlockAnalyzerThread::startAnalyzis, Qt::QueuedConnection);
 
@@ -50,7 +62,8 @@ WordPulseViewModel::WordPulseViewModel(QObject *parent) : QObject{parent}, _conf
     connect(reader.get(), &FileReaderThread::isRunningChanged, this, &WordPulseViewModel::setIsRunning, Qt::QueuedConnection);
 
     connect(analyzer.get(), &BlockAnalyzerThread::progress, this, &WordPulseViewModel::updateProgress, Qt::QueuedConnection);
-    connect(analyzer.get(), &BlockAnalyzerThread::topWords, this, &WordPulseViewModel::updateTopWords,  Qt::QueuedConnection);
+    connect(analyzer.get(), &BlockAnalyzerThread::snapshotReady, this, &WordPulseViewModel::updateTopWords,  Qt::QueuedConnection);
+    connect(analyzer.get(), &BlockAnalyzerThread::metricsUpdated, this, &WordPulseViewModel::updateMetrics, Qt::QueuedConnection);
 }
 
 WordPulseViewModel::~WordPulseViewModel()
@@ -73,6 +86,66 @@ bool WordPulseViewModel::get_isPaused() const noexcept
     return _isPaused;
 }
 
+bool WordPulseViewModel::get_hasMetrics() const noexcept
+{
+    return _metrics.elapsedMs > 0;
+}
+
+double WordPulseViewModel::get_readMBps() const noexcept
+{
+    return _metrics.readBytesPerSec / (1024.0 * 1024.0);
+}
+
+double WordPulseViewModel::get_analyzeMBps() const noexcept
+{
+    return _metrics.analyzeBytesPerSec / (1024.0 * 1024.0);
+}
+
+double WordPulseViewModel::get_tokensPerSec() const noexcept
+{
+    return _metrics.tokensPerSec;
+}
+
+qint64 WordPulseViewModel::get_queueDepth() const noexcept
+{
+    return _metrics.queueDepth;
+}
+
+qint64 WordPulseViewModel::get_queueCapacity() const noexcept
+{
+    return _metrics.queueCapacity;
+}
+
+qint64 WordPulseViewModel::get_readerStalledMs() const noexcept
+{
+    return _metrics.readerStalledMs;
+}
+
+qint64 WordPulseViewModel::get_analyzerStarvedMs() const noexcept
+{
+    return _metrics.analyzerStarvedMs;
+}
+
+qint64 WordPulseViewModel::get_tableWords() const noexcept
+{
+    return _metrics.tableWords;
+}
+
+quint64 WordPulseViewModel::get_tableBytes() const noexcept
+{
+    return _metrics.tableBytes;
+}
+
+qint64 WordPulseViewModel::get_etaMs() const noexcept
+{
+    return _metrics.etaMs;
+}
+
+QString WordPulseViewModel::get_bottleneck() const
+{
+    return _metrics.bottleneck();
+}
+
 quint8 WordPulseViewModel::get_progress() const noexcept
 {
     return _progress;
@@ -101,6 +174,7 @@ void WordPulseViewModel::openFile() {
     }
 
     _topWordsModel->resetTopWords({});
+    _shownSnapshot = 0;
     _progress = 0;
     _fileChosen = true;
     emit progressChanged();
@@ -118,7 +192,10 @@ void WordPulseViewModel::start()
     }
 
     qDebug() << "started";
+    if (!_config.trace_path.isEmpty())
+        Tracer::start();
     _topWordsModel->resetTopWords({});
+    _shownSnapshot = 0;
     _progress = 0;
     emit progressChanged();
 
@@ -127,6 +204,24 @@ void WordPulseViewModel::start()
     if (analyzer)
         analyzer->start();
 
+    // Отмена сохраняет контрольную точку, и новый запуск того же файла продолжает с неё.
+    // В потоке анализатора: там же ещё может выполняться сохранение при отмене
+    if (!_config.checkpoint_path.isEmpty() && reader && analyzer) {
+        if (_config.follow) {
+            qWarning() << "Checkpoints need a file without follow, they are disabled";
+        } else {
+            quint64 offset = 0;
+            const QString path = reader->getFilePath();
+            BlockAnalyzerThread* analyzerPtr = analyzer.get();
+            QMetaObject::invokeMethod(analyzerPtr, [analyzerPtr, &offset, &path]() {
+                offset = analyzerPtr->prepareCheckpoint(path);
+            }, Qt::BlockingQueuedConnection);
+            reader->setStartPos(static_cast<qint64>(offset));
+            if (offset > 0)
+                showInfo(QString("Продолжение с контрольной точки: байт %1").arg(offset));
+        }
+    }
+
     _isPaused = false;
     _isRunning = true;
     emit readingStarted();
@@ -149,6 +244,8 @@ void WordPulseViewModel::resume()
     qDebug() << "resumed";
     _isPaused = false;
     emit readingResumed();
+    // Снимки, пришедшие на паузе, пропущены; анализ мог и закончиться - новых не будет
+    updateTopWords();
 
     emit pausedChanged();
 }
@@ -157,6 +254,7 @@ void WordPulseViewModel::cancel()
 {
     qDebug() << "cancel";
     _topWordsModel->resetTopWords({});
+    _shownSnapshot = 0;
     _progress = 0;
     _isPaused = false;
     _isRunning = false;
@@ -165,6 +263,7 @@ void WordPulseViewModel::cancel()
 
     emit pausedChanged();
     emit runningChanged();
+    writeTrace();
 }
 
 void WordPulseViewModel::showInfo(const QString &msg)
@@ -209,39 +308,46 @@ void WordPulseViewModel::updateProgress(quint8 progress) {
 
     if (this->_progress != progress) {
         this->_progress = progress;
-        qDebug() << "progressChanged";
+        qCDebug(lcPipeline) << "progressChanged";
         emit progressChanged();
     }
 }
 
-void WordPulseViewModel::updateTopWords(const QVector<QPair<quint64, QString>>& newTopWords) {
+void WordPulseViewModel::updateTopWords() {
+    // Пропущенный на паузе снимок не страшен: следующий не совпадёт по версии и сбросит модель
     if (_isPaused)
         return;
 
-    const int currentSize = _topWordsModel->rowCount();
-    const int newSize = newTopWords.size();
-    const int minSize = qMin(currentSize, newSize);
-
-    bool needsReset = (currentSize != newSize);
-    if (!needsReset) {
-        for (int i = 0; i < minSize; ++i) {
-            const auto& newPair = newTopWords.at(i);
-            const QModelIndex idx = _topWordsModel->index(i);
-            quint64 currentCount = _topWordsModel->data(idx, TopWordsModel::CountRole).value<quint64>();
-            QString currentWord = _topWordsModel->data(idx, TopWordsModel::WordRole).toString();
-            if (newPair.first != currentCount || newPair.second != currentWord) {
-                _topWordsModel->updateWord(i, newPair.first, newPair.second);
-            }
-        }
-    } else {
-        _topWordsModel->resetTopWords(newTopWords);
-    }
+    // Уведомления могут скопиться в очереди: берём самый свежий снимок, остальные пропускаем
+    const TopWordsSnapshotPtr snapshot = analyzer->latestSnapshot();
+    if (snapshot->version == _shownSnapshot)
+        return;
+    _shownSnapshot = snapshot->version;
+    _topWordsModel->applyDiff(snapshot->diff);
+}
+
+void WordPulseViewModel::updateMetrics(const PipelineMetrics& metrics)
+{
+    _metrics = metrics;
+    emit metricsChanged();
+}
+
+void WordPulseViewModel::writeTrace()
+{
+    if (_config.trace_path.isEmpty() || !Tracer::isEnabled())
+        return;
+    QString error;
+    if (Tracer::stop(_config.trace_path, &error))
+        showInfo("Трасса записана в " + _config.trace_path);
+    else
+        showWarning(error);
 }
 
 void WordPulseViewModel::finishProcess()
 {
     _isRunning = false;
     emit runningChanged();
+    writeTrace();
     emit showInfo("Анализ завершён!");
 }
 
@@ -25,6 +25,20 @@ class WordPulseViewModel : public QObject {
     Q_PROPERTY(bool isRunning READ get_isRunning NOTIFY runningChanged)
     Q_PROPERTY(bool isPaused READ get_isPaused NOTIFY pausedChanged)
 
+    // Живые метрики конвейера (PipelineMetrics), все обновляются вместе по metricsChanged
+    Q_PROPERTY(bool hasMetrics READ get_hasMetrics NOTIFY metricsChanged)
+    Q_PROPERTY(double readMBps READ get_readMBps NOTIFY metricsChanged)
+    Q_PROPERTY(double analyzeMBps READ get_analyzeMBps NOTIFY metricsChanged)
+    Q_PROPERTY(double tokensPerSec READ get_tokensPerSec NOTIFY metricsChanged)
+    Q_PROPERTY(qint64 queueDepth READ get_queueDepth NOTIFY metricsChanged)
+    Q_PROPERTY(qint64 queueCapacity READ get_queueCapacity NOTIFY metricsChanged)
+    Q_PROPERTY(qint64 readerStalledMs READ get_readerStalledMs NOTIFY metricsChanged)
+    Q_PROPERTY(qint64 analyzerStarvedMs READ get_analyzerStarvedMs NOTIFY metricsChanged)
+    Q_PROPERTY(qint64 tableWords READ get_tableWords NOTIFY metricsChanged)
+    Q_PROPERTY(quint64 tableBytes READ get_tableBytes NOTIFY metricsChanged)
+    Q_PROPERTY(qint64 etaMs READ get_etaMs NOTIFY metricsChanged)
+    Q_PROPERTY(QString bottleneck READ get_bottleneck NOTIFY metricsChanged)
+
 public:
     explicit WordPulseViewModel(QObject* parent = nullptr);
     ~WordPulseViewModel();
@@ -35,6 +49,18 @@ public:
     qint32 get_topWordsCount() const noexcept;
     bool get_isRunning() const noexcept;
     bool get_isPaused() const noexcept;
+    bool get_hasMetrics() const noexcept;
+    double get_readMBps() const noexcept;
+    double get_analyzeMBps() const noexcept;
+    double get_tokensPerSec() const noexcept;
+    qint64 get_queueDepth() const noexcept;
+    qint64 get_queueCapacity() const noexcept;
+    qint64 get_readerStalledMs() const noexcept;
+    qint64 get_analyzerStarvedMs() const noexcept;
+    qint64 get_tableWords() const noexcept;
+    quint64 get_tableBytes() const noexcept;
+    qint64 get_etaMs() const noexcept;
+    QString get_bottleneck() const;
 
     enum MessageType {
         MsgInfo = 0,
@@ -59,6 +85,7 @@ signals:
 
     void runningChanged();
     void pausedChanged();
+    void metricsChanged();
 
     void readingStarted();
     void readingPaused();
@@ -74,9 +101,11 @@ private:
     void setIsRunning(bool isRunning);
     void setIsPaused(bool isPaused);
     void updateProgress(quint8 progress);
-    void updateTopWords(const QVector<QPair<quint64, QString>>& newTopWords);
+    void updateTopWords();
+    void updateMetrics(const PipelineMetrics& metrics);
 
     void finishProcess(void);
+    void writeTrace(void);
 
     std::unique_ptr<FileReaderThread> reader;
     std::unique_ptr<BlockAnalyzerThread> analyzer;
@@ -87,6 +116,8 @@ private:
     const Config _config;
 
     quint8 _progress;
+    quint64 _shownSnapshot;     // версия снимка, который сейчас в модели
+    PipelineMetrics _metrics;
 
     bool _isRunning;
     bool _isPaused;
@@ -0,0 +1,284 @@
+#include "wordtokenizer.h"
+#include <QChar>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+
+constexpr quint64 kOnes = 0x0101010101010101ULL;
+constexpr quint64 kHighBits = kOnes * 0x80;
+
+// 8 байт ASCII (старшие биты нулевые): A-Z -> a-z без ветвлений.
+// Байт + (0x80 - 'A') получает старший бит, если он >= 'A', байт + (0x80 - '[') -
+// если он > 'Z'; переносов между байтами нет, максимум 0x7F + 0x3F.
+inline quint64 foldAscii8(quint64 x) noexcept
+{
+    const quint64 upper = ((x + kOnes * (0x80 - 'A')) ^ (x + kOnes * (0x80 - 'Z' - 1))) & kHighBits;
+    return x | (upper >> 2);
+}
+
+// Строится по QString::toLower, чтобы совпадать с ним символ в символ.
+// В таблицу попадают только символы, строчная форма которых тоже двухбайтная
+const char16_t* twoByteLowerTable()
+{
+    static const std::array<char16_t, 0x800> table = [] {
+        std::array<char16_t, 0x800> t{};
+        for (char16_t cp = 0x80; cp < 0x800; ++cp) {
+            const QString lower = QString(QChar(cp)).toLower();
+            if (lower.size() == 1 && lower.at(0).unicode() >= 0x80 && lower.at(0).unicode() < 0x800)
+                t[cp] = lower.at(0).unicode();
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+} // namespace
+
+WordTokenizer::WordTokenizer(const Config& config)
+{
+    _regex.setPattern(config.string_pattern);
+    if (!config.case_sensitive) {
+        _regex.setPatternOptions(QRegularExpression::NoPatternOption);
+    } else {
+        _regex.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+    }
+    _lowerCase = _regex.patternOptions() == QRegularExpression::NoPatternOption;
+
+    _byteClass.fill(ByteOther);
+    _unicode = false;
+    _unicodeWord = false;
+    _unicodeDigit = false;
+    _hasLetterLiteral = false;
+    _lowerTable = twoByteLowerTable();
+
+    _fastPath = compileFastPath(config.string_pattern);
+
+    // Без UCP-флага caseless-regex сопоставляет [k] ещё и с KELVIN SIGN, [s] - с LONG S.
+    // Таблица такого не умеет, поэтому явные буквы + CaseInsensitiveOption идут в regex.
+    if (_fastPath && _hasLetterLiteral
+        && (_regex.patternOptions() & QRegularExpression::CaseInsensitiveOption)) {
+        _fastPath = false;
+    }
+
+    if (_fastPath && _unicode && (_unicodeWord || _unicodeDigit)) {
+        for (int b = 0x80; b < 0x100; ++b)
+            _byteClass[b] = ByteNonAscii;
+    }
+
+    for (int b = 0; b < 0x100; ++b) {
+        if (_byteClass[b] != ByteOther)
+            _runBytes.add(static_cast<uchar>(b));
+    }
+
+    qDebug() << "WordTokenizer pattern:" << config.string_pattern
+             << (_fastPath ? "byte fast path" : "regex path");
+}
+
+bool WordTokenizer::isFastPath() const noexcept
+{
+    return _fastPath;
+}
+
+const QRegularExpression& WordTokenizer::regex() const noexcept
+{
+    return _regex;
+}
+
+bool WordTokenizer::compileFastPath(const QString& pattern)
+{
+    static const QString ucpPrefix = QStringLiteral("(*UCP)");
+
+    qsizetype pos = 0;
+    if (pattern.startsWith(ucpPrefix)) {
+        _unicode = true;
+        pos = ucpPrefix.size();
+    }
+
+    // Поддерживаем ровно "<класс>+" без якорей, групп и прочего
+    if (pattern.size() - pos < 2 || !pattern.endsWith(QLatin1Char('+')))
+        return false;
+    const qsizetype classEnd = pattern.size() - 1;
+
+    if (pattern.at(pos) == QLatin1Char('[')) {
+        ++pos;
+        if (pos >= classEnd || pattern.at(pos) == QLatin1Char('^') || pattern.at(pos) == QLatin1Char(']'))
+            return false;
+        while (pos < classEnd && pattern.at(pos) != QLatin1Char(']')) {
+            if (!addClassItem(pattern, pos))
+                return false;
+        }
+        return pos == classEnd - 1 && pattern.at(pos) == QLatin1Char(']');
+    }
+
+    if (!addClassItem(pattern, pos))
+        return false;
+    return pos == classEnd;
+}
+
+bool WordTokenizer::addClassItem(const QString& pattern, qsizetype& pos)
+{
+    const QChar ch = pattern.at(pos);
+
+    if (ch == QLatin1Char('\\')) {
+        if (pos + 1 >= pattern.size())
+            return false;
+        const QChar esc = pattern.at(pos + 1);
+        pos += 2;
+        if (esc == QLatin1Char('w')) {
+            addAsciiRange('a', 'z');
+            addAsciiRange('A', 'Z');
+            addAsciiRange('0', '9');
+            addAsciiRange('_', '_');
+            _unicodeWord = true;
+            return true;
+        }
+        if (esc == QLatin1Char('d')) {
+            addAsciiRange('0', '9');
+            _unicodeDigit = true;
+            return true;
+        }
+        // Экранированная пунктуация - обычный символ
+        if (esc.unicode() < 0x80 && esc.unicode() > 0x20 && !esc.isLetterOrNumber()) {
+            addAsciiRange(static_cast<uchar>(esc.unicode()), static_cast<uchar>(esc.unicode()));
+            return true;
+        }
+        return false;
+    }
+
+    if (ch.unicode() >= 0x80 || ch.unicode() <= 0x20 || ch == QLatin1Char('['))
+        return false;
+
+    uchar from = static_cast<uchar>(ch.unicode());
+    uchar to = from;
+    ++pos;
+
+    // Диапазон a-z; '-' перед ']' - обычный символ
+    if (pos + 1 < pattern.size() && pattern.at(pos) == QLatin1Char('-')
+        && pattern.at(pos + 1) != QLatin1Char(']')) {
+        const QChar last = pattern.at(pos + 1);
+        if (last.unicode() >= 0x80 || last.unicode() <= 0x20
+            || last == QLatin1Char('\\') || last == QLatin1Char('['))
+            return false;
+        to = static_cast<uchar>(last.unicode());
+        if (to < from)
+            return false;
+        pos += 2;
+    }
+
+    addAsciiRange(from, to);
+    for (int c = from; c <= to; ++c) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+            _hasLetterLiteral = true;
+    }
+    return true;
+}
+
+void WordTokenizer::addAsciiRange(uchar from, uchar to)
+{
+    for (int c = from; c <= to; ++c)
+        _byteClass[c] = ByteWord;
+}
+
+bool WordTokenizer::isWordCodePoint(char32_t cp) const noexcept
+{
+    if (cp == 0xFFFD)
+        return false;
+
+    const QChar::Category category = QChar::category(cp);
+    if (_unicodeWord) {
+        switch (category) {
+        case QChar::Letter_Uppercase:
+        case QChar::Letter_Lowercase:
+        case QChar::Letter_Titlecase:
+        case QChar::Letter_Modifier:
+        case QChar::Letter_Other:
+        case QChar::Number_DecimalDigit:
+        case QChar::Number_Letter:
+        case QChar::Number_Other:
+            return true;
+        default:
+            break;
+        }
+    }
+    return _unicodeDigit && category == QChar::Number_DecimalDigit;
+}
+
+bool WordTokenizer::foldCase(QByteArrayView word, QByteArray& out) const
+{
+    const qsizetype n = word.size();
+    // Буфер не сжимается, так что после первых слов resize не выделяет память
+    out.resize(n);
+    const uchar* in = reinterpret_cast<const uchar*>(word.data());
+    uchar* dst = reinterpret_cast<uchar*>(out.data());
+
+    qsizetype i = 0;
+    while (i < n) {
+        if (n - i >= 8) {
+            quint64 x;
+            std::memcpy(&x, in + i, 8);
+            if (!(x & kHighBits)) {
+                x = foldAscii8(x);
+                std::memcpy(dst + i, &x, 8);
+                i += 8;
+                continue;
+            }
+        }
+
+        const uchar b = in[i];
+        if (b < 0x80) {
+            dst[i++] = (b >= 'A' && b <= 'Z') ? static_cast<uchar>(b + ('a' - 'A')) : b;
+            continue;
+        }
+        if (b < 0xC2 || b > 0xDF || i + 1 >= n || (in[i + 1] & 0xC0) != 0x80)
+            return false;
+        const char16_t lower = _lowerTable[((b & 0x1F) << 6) | (in[i + 1] & 0x3F)];
+        if (!lower)
+            return false;
+        dst[i] = static_cast<uchar>(0xC0 | (lower >> 6));
+        dst[i + 1] = static_cast<uchar>(0x80 | (lower & 0x3F));
+        i += 2;
+    }
+    return true;
+}
+
+qsizetype WordTokenizer::decodeUtf8(const uchar* p, qsizetype avail, char32_t& cp) noexcept
+{
+    const uchar b0 = p[0];
+    qsizetype len;
+    char32_t min;
+
+    if (b0 >= 0xC2 && b0 <= 0xDF) {
+        len = 2;
+        cp = b0 & 0x1F;
+        min = 0x80;
+    } else if (b0 >= 0xE0 && b0 <= 0xEF) {
+        len = 3;
+        cp = b0 & 0x0F;
+        min = 0x800;
+    } else if (b0 >= 0xF0 && b0 <= 0xF4) {
+        len = 4;
+        cp = b0 & 0x07;
+        min = 0x10000;
+    } else {
+        cp = 0xFFFD;
+        return 1;
+    }
+
+    if (avail < len) {
+        cp = 0xFFFD;
+        return 1;
+    }
+
+    for (qsizetype i = 1; i < len; ++i) {
+        if ((p[i] & 0xC0) != 0x80) {
+            cp = 0xFFFD;
+            return i;
+        }
+        cp = (cp << 6) | (p[i] & 0x3F);
+    }
+
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+        cp = 0xFFFD;
+    return len;
+}
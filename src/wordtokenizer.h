@@ -0,0 +1,229 @@
+#ifndef WORDTOKENIZER_H
+#define WORDTOKENIZER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringEncoder>
+#include <array>
+#include <bit>
+#include "config.h"
+#include "byteclassifier.h"
+
+// Разбивает блок UTF-8 на слова по Config::string_pattern.
+// Простые шаблоны вида "\w+" или "[a-z0-9_-]+" (опционально с "(*UCP)")
+// разбираются прямо по байтам блока, без QString и QRegularExpression:
+// границы слов ищутся по 64-байтным маскам ByteClassifier, а не-ASCII
+// символы внутри слова проверяются табличным декодером UTF-8.
+// Всё остальное уходит в regex как раньше.
+// Регистр сворачивается прямо в байтах UTF-8, в переиспользуемый буфер:
+// ASCII по 8 байт за раз, двухбайтные символы (латиница, греческий, кириллица...)
+// по таблице. Через QString идут только слова с символами вне таблицы.
+class WordTokenizer
+{
+public:
+    explicit WordTokenizer(const Config& config);
+
+    bool isFastPath() const noexcept;
+    const QRegularExpression& regex() const noexcept;
+
+    // onWord(QByteArrayView) получает слово в UTF-8, при case_sensitive == false
+    // уже в нижнем регистре. View живёт только до возврата из onWord.
+    template <typename OnWord>
+    void tokenize(QByteArrayView block, OnWord&& onWord) const;
+
+private:
+    enum ByteClass : quint8 {
+        ByteOther = 0,
+        ByteWord,
+        ByteNonAscii
+    };
+
+    bool compileFastPath(const QString& pattern);
+    bool addClassItem(const QString& pattern, qsizetype& pos);
+    void addAsciiRange(uchar from, uchar to);
+
+    bool isWordCodePoint(char32_t cp) const noexcept;
+    // Нижний регистр word в out той же длины. false - в слове есть символ вне таблицы
+    bool foldCase(QByteArrayView word, QByteArray& out) const;
+    static qsizetype decodeUtf8(const uchar* p, qsizetype avail, char32_t& cp) noexcept;
+
+    template <typename OnWord>
+    void tokenizeFast(QByteArrayView block, OnWord& onWord) const;
+    template <typename OnWord>
+    void tokenizeScalar(QByteArrayView run, QByteArray& folded, OnWord& onWord) const;
+    template <typename OnWord>
+    void emitRun(QByteArrayView run, QByteArray& folded, OnWord& onWord) const;
+    template <typename OnWord>
+    void tokenizeRegex(QByteArrayView block, OnWord& onWord) const;
+    template <typename OnWord>
+    void emitWord(QByteArrayView word, QByteArray& folded, OnWord& onWord) const;
+
+    QRegularExpression _regex;
+    bool _lowerCase;
+    bool _fastPath;
+
+    std::array<quint8, 256> _byteClass;
+    ByteClassifier _runBytes;   // байты, которые могут входить в слово
+    bool _unicode;          // (*UCP): не-ASCII символы классифицируются по Unicode
+    bool _unicodeWord;      // в классе есть \w
+    bool _unicodeDigit;     // в классе есть \d
+    bool _hasLetterLiteral; // буквы заданы явно, а не через \w
+    // Код символа U+0080..U+07FF -> код его строчной формы, 0 - сворачивать через QString
+    const char16_t* _lowerTable;
+};
+
+template <typename OnWord>
+void WordTokenizer::tokenize(QByteArrayView block, OnWord&& onWord) const
+{
+    if (_fastPath)
+        tokenizeFast(block, onWord);
+    else
+        tokenizeRegex(block, onWord);
+}
+
+template <typename OnWord>
+void WordTokenizer::emitWord(QByteArrayView word, QByteArray& folded, OnWord& onWord) const
+{
+    if (!_lowerCase) {
+        onWord(word);
+        return;
+    }
+
+    if (!foldCase(word, folded)) {
+        // Редкий путь: длина может измениться (İ -> i̇), так что через QString
+        folded = QString::fromUtf8(word).toLower().toUtf8();
+    }
+    onWord(QByteArrayView(folded));
+}
+
+template <typename OnWord>
+void WordTokenizer::tokenizeFast(QByteArrayView block, OnWord& onWord) const
+{
+    const char* data = block.data();
+    const qsizetype n = block.size();
+    QByteArray folded;
+
+    // Пробег - максимальная последовательность байт из _runBytes. Биты за концом
+    // блока в маске нулевые, поэтому последний пробег всегда закрывается.
+    qsizetype runStart = -1;
+    for (qsizetype base = 0; base < n; base += 64) {
+        quint64 mask = _runBytes.mask64(data + base, qMin<qsizetype>(64, n - base));
+
+        while (true) {
+            if (runStart < 0) {
+                if (!mask)
+                    break;
+                runStart = base + std::countr_zero(mask);
+            }
+
+            const int from = runStart > base ? static_cast<int>(runStart - base) : 0;
+            const quint64 ends = ~mask & (~quint64(0) << from);
+            if (!ends)
+                break;
+
+            const int endPos = std::countr_zero(ends);
+            emitRun(block.sliced(runStart, base + endPos - runStart), folded, onWord);
+            runStart = -1;
+            mask &= ~quint64(0) << endPos;
+        }
+    }
+
+    if (runStart >= 0)
+        emitRun(block.sliced(runStart), folded, onWord);
+}
+
+template <typename OnWord>
+void WordTokenizer::emitRun(QByteArrayView run, QByteArray& folded, OnWord& onWord) const
+{
+    if (_unicode) {
+        for (char c : run) {
+            if (static_cast<uchar>(c) >= 0x80) {
+                // Не-ASCII символ может оказаться и разделителем: дорезаем побайтно
+                tokenizeScalar(run, folded, onWord);
+                return;
+            }
+        }
+    }
+    emitWord(run, folded, onWord);
+}
+
+template <typename OnWord>
+void WordTokenizer::tokenizeScalar(QByteArrayView run, QByteArray& folded, OnWord& onWord) const
+{
+    const uchar* data = reinterpret_cast<const uchar*>(run.data());
+    const qsizetype n = run.size();
+    char32_t cp = 0;
+
+    qsizetype i = 0;
+    while (i < n) {
+        // Пропускаем всё, что не слово
+        qsizetype start = -1;
+        while (i < n) {
+            const quint8 cls = _byteClass[data[i]];
+            if (cls == ByteWord) {
+                start = i;
+                break;
+            }
+            if (cls == ByteNonAscii) {
+                const qsizetype len = decodeUtf8(data + i, n - i, cp);
+                if (isWordCodePoint(cp)) {
+                    start = i;
+                    break;
+                }
+                i += len;
+                continue;
+            }
+            ++i;
+        }
+        if (start < 0)
+            break;
+
+        // Само слово
+        while (i < n) {
+            const quint8 cls = _byteClass[data[i]];
+            if (cls == ByteWord) {
+                ++i;
+                continue;
+            }
+            if (cls == ByteNonAscii) {
+                const qsizetype len = decodeUtf8(data + i, n - i, cp);
+                if (isWordCodePoint(cp)) {
+                    i += len;
+                    continue;
+                }
+            }
+            break;
+        }
+
+        emitWord(run.sliced(start, i - start), folded, onWord);
+    }
+}
+
+template <typename OnWord>
+void WordTokenizer::tokenizeRegex(QByteArrayView block, OnWord& onWord) const
+{
+    QRegularExpressionMatchIterator it = _regex.globalMatch(QString::fromUtf8(block));
+    QStringEncoder toUtf8(QStringEncoder::Utf8, QStringEncoder::Flag::Stateless);
+    QByteArray utf8;
+    QByteArray folded;
+
+    while (it.hasNext())
+    {
+        QRegularExpressionMatch match = it.next();
+        if (!match.hasMatch())
+            continue;
+
+        const QStringView word = match.capturedView(0);
+        if (word.isEmpty())
+            continue;
+
+        // Кодируем в тот же буфер, регистр сворачиваем уже в UTF-8, как и быстрый путь
+        utf8.resize(toUtf8.requiredSpace(word.size()));
+        const char* end = toUtf8.appendToBuffer(utf8.data(), word);
+        emitWord(QByteArrayView(utf8.constData(), end), folded, onWord);
+    }
+}
+
+#endif // WORDTOKENIZER_H
@@ -19,7 +19,7 @@ QByteArrayView MockDataProvider::getDataBlock()
 {
     if (queue.isEmpty()) return QByteArrayView();
 
-    currentData = queue.dequeue();
+    consumed.append(queue.dequeue());
 
-    return currentData;
+    return consumed.last();
 }
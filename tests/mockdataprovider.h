@@ -4,24 +4,29 @@
 #include "../src/idataprovider.h"
 #include <QQueue>
 #include <QByteArray>
+#include <QMutex>
 
 // Этот класс притворяется FileReader-ом
 class MockDataProvider : public IDataProvider {
 public:
     QQueue<QByteArray> queue;
 
-    QByteArray currentData;
+    // Выданные блоки живут до конца теста: воркеры пула держат на них view
+    QList<QByteArray> consumed;
 
     void addData(const QString& str);
 
-    void lock() override { }
-    void unlock() override { }
+    void lock() override { mutex.lock(); }
+    void unlock() override { mutex.unlock(); }
 
     bool isDataEmpty() const noexcept override;
 
     qsizetype dataSize() const noexcept override;
 
     QByteArrayView getDataBlock() override;
+
+private:
+    QMutex mutex;
 };
 
 #endif // MOCKDATAPROVIDER_H
@@ -1,15 +1,1681 @@
 #include <QtTest>
 #include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTemporaryFile>
 #include <memory>
 #include "../src/blockanalyzerthread.h"
 #include "../src/config.h"
+#include "../src/wordtokenizer.h"
+#include "../src/byteclassifier.h"
+#include "../src/wordcounttable.h"
+#include "../src/spacesaving.h"
+#include "../src/topnselector.h"
+#include "../src/topcandidates.h"
+#include "../src/windowedcounts.h"
+#include "../src/filereaderthread.h"
+#include "../src/asyncfilereaderthread.h"
+#include "../src/rangefilereaderthread.h"
+#include "../src/multifilereaderthread.h"
+#include "../src/streamdecoder.h"
+#include "../src/checkpoint.h"
+#include "../src/logger.h"
+#include "../src/tracer.h"
+#include "../src/topwordsdiff.h"
+#include "../src/chunktuner.h"
+#include "../src/ringdataprovider.h"
 #include "mockdataprovider.h"
+#ifdef WORDPULSE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Открывает производителю доступ к кольцу
+class TestRingProvider : public RingDataProvider
+{
+public:
+    using RingDataProvider::RingDataProvider;
+    using RingDataProvider::pushDataBlock;
+    using RingDataProvider::closeData;
+};
 
 class TestBlockAnalyzer : public QObject
 {
     Q_OBJECT
 
+private:
+    // Детерминированный корпус: много блоков с повторяющимися словами и ничьими по счёту
+    static QStringList makeBlocks(int blockCount) {
+        QStringList blocks;
+        quint32 seed = 12345;
+        for (int b = 0; b < blockCount; ++b) {
+            QString block;
+            for (int w = 0; w < 200; ++w) {
+                seed = seed * 1103515245u + 12345u;
+                block += QString("w%1 ").arg((seed >> 16) % 97);
+            }
+            blocks << block;
+        }
+        return blocks;
+    }
+
+    static QVector<QPair<quint64, QString>> runToFinish(Config cfg, const QStringList& blocks) {
+        MockDataProvider mock;
+        quint64 total = 0;
+        for (const QString& block : blocks) {
+            mock.addData(block);
+            total += block.toUtf8().size();
+        }
+
+        auto analyzer = std::make_unique<BlockAnalyzerThread>(cfg, &mock);
+        analyzer->setTotalSize(total);
+
+        QSignalSpy spyTop(analyzer.get(), &BlockAnalyzerThread::topWords);
+        QSignalSpy spyFinished(analyzer.get(), &BlockAnalyzerThread::analyzisFinished);
+
+        analyzer->start();
+        QMetaObject::invokeMethod(analyzer.get(), "startAnalyzis", Qt::QueuedConnection);
+        for (int i = 0; i < blocks.size(); ++i)
+            QMetaObject::invokeMethod(analyzer.get(), "analyzeBlock", Qt::QueuedConnection);
+        QMetaObject::invokeMethod(analyzer.get(), "analyzingFinishing", Qt::QueuedConnection);
+
+        if (!spyFinished.wait(5000))
+            return {};
+
+        QVector<QPair<quint64, QString>> list;
+        if (!spyTop.isEmpty())
+            list = spyTop.takeLast().at(0).value<QVector<QPair<quint64, QString>>>();
+
+        QThread* mainThread = QThread::currentThread();
+        QMetaObject::invokeMethod(analyzer.get(), [analyzer = analyzer.get(), mainThread]() {
+            analyzer->moveToThread(mainThread);
+        }, Qt::BlockingQueuedConnection);
+
+        analyzer->quit();
+        analyzer->wait();
+        return list;
+    }
+
+    static QStringList tokenize(const Config& cfg, const QByteArray& text) {
+        WordTokenizer tokenizer(cfg);
+        QStringList words;
+        tokenizer.tokenize(text, [&words](QByteArrayView word) {
+            words << QString::fromUtf8(word);
+        });
+        return words;
+    }
+
+    static qint64 residentKb() {
+#ifdef Q_OS_LINUX
+        QFile status("/proc/self/status");
+        if (status.open(QIODevice::ReadOnly)) {
+            for (const QByteArray& line : status.readAll().split('\n')) {
+                if (line.startsWith("VmRSS:"))
+                    return line.mid(6).trimmed().split(' ').first().toLongLong();
+            }
+        }
+#endif
+        return -1;
+    }
+
 private slots:
+    void testByteClassifierKernels() {
+        const Config cfg = Config::defaultConfig();
+        const ByteClassifier separators(cfg.word_separators);
+        const ByteClassifier::Kernel original = ByteClassifier::activeKernel();
+
+        QByteArray data;
+        quint32 seed = 777;
+        for (int i = 0; i < 1000; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            data.append(static_cast<char>(seed >> 16));
+        }
+
+        for (auto kernel : {ByteClassifier::Kernel::Scalar, ByteClassifier::Kernel::Ssse3,
+                            ByteClassifier::Kernel::Avx2}) {
+            if (!ByteClassifier::setKernel(kernel))
+                continue;
+
+            // Все длины, чтобы задеть хвосты короче 64 байт
+            for (qsizetype len = 0; len <= 200; ++len) {
+                const QByteArrayView view(data.constData(), len);
+                qsizetype first = -1, last = -1, firstNot = -1;
+                for (qsizetype i = 0; i < len; ++i) {
+                    if (cfg.word_separators.contains(view[i])) {
+                        if (first < 0)
+                            first = i;
+                        last = i;
+                    } else if (firstNot < 0) {
+                        firstNot = i;
+                    }
+                }
+                QCOMPARE(separators.findFirst(view), first);
+                QCOMPARE(separators.findLast(view), last);
+                QCOMPARE(separators.findFirstNot(view), firstNot);
+            }
+        }
+
+        ByteClassifier::setKernel(original);
+    }
+
+    void testWordCountTable() {
+        WordCountTable table;
+        const int distinct = 10000;
+
+        // Два прохода: вставка новых ключей с ростом таблицы и инкремент существующих
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int i = 0; i < distinct; ++i) {
+                const QByteArray word = "word" + QByteArray::number(i);
+                QCOMPARE(table.add(word), quint64(pass + 1));
+            }
+        }
+
+        QCOMPARE(table.size(), qsizetype(distinct));
+        QCOMPARE(table.value("word0"), 2ULL);
+        QCOMPARE(table.value("word9999"), 2ULL);
+        QCOMPARE(table.value("missing"), 0ULL);
+
+        quint64 total = 0;
+        table.forEach([&total](QByteArrayView word, quint64 hash, quint64 count) {
+            QCOMPARE(hash, WordCountTable::hash(word));
+            total += count;
+        });
+        QCOMPARE(total, quint64(distinct * 2));
+
+        QVERIFY(table.memoryUsage() > 0);
+        table.clear();
+        QVERIFY(table.isEmpty());
+        QCOMPARE(table.memoryUsage(), size_t(0));
+        QCOMPARE(table.value("word0"), 0ULL);
+    }
+
+    void testTopCandidatesKeepShardTop() {
+        // Скошенный поток с ничьими: топ по кандидатам совпадает с топом по всей таблице
+        const qsizetype n = 8;
+        WordCountTable table;
+        TopCandidates candidates(n);
+        quint32 seed = 99;
+        for (int i = 0; i < 50000; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            const QByteArray word = "w" + QByteArray::number(((seed >> 8) % 3000) / (1 + (seed >> 20) % 30));
+            const quint64 hash = WordCountTable::hash(word);
+            candidates.update(word, hash, table.add(word, hash));
+
+            if (i % 997 == 0 || i == 49999) {
+                TopNSelector full(n);
+                table.forEach([&full](QByteArrayView key, quint64, quint64 count) { full.offer(count, key); });
+                TopNSelector reduced(n);
+                candidates.forEach([&reduced](QByteArrayView key, quint64 count) { reduced.offer(count, key); });
+                QCOMPARE(reduced.takeAscending(), full.takeAscending());
+                QVERIFY(candidates.size() < 2 * n);
+            }
+        }
+
+        // Ничьи на минимуме отсекаются по байтам ключа, не расшифровываясь
+        TopNSelector selector(2);
+        int decoded = 0;
+        selector.setDecoder([&decoded](QByteArrayView key) {
+            ++decoded;
+            return QString::fromUtf8(key);
+        });
+        for (const char* word : {"b", "c", "a", "b0", "a"})
+            selector.offer(2, word);
+        QCOMPARE(decoded, 3);
+        const QVector<QPair<quint64, QString>> expected{{2, "b0"}, {2, "c"}};
+        QCOMPARE(selector.takeAscending(), expected);
+    }
+
+    void testSpaceSavingBounds() {
+        // Скошенный поток: слово i встречается примерно 2000 / (i + 1) раз
+        WordCountTable exact;
+        SpaceSavingCounter plain(32);
+        SpaceSavingCounter sketched(32, 256, 4);
+        quint32 seed = 777;
+        for (int i = 0; i < 20000; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            const quint32 r = (seed >> 8) % 2000;
+            const QByteArray word = "w" + QByteArray::number(2000 / (r + 1));
+            const quint64 hash = WordCountTable::hash(word);
+            exact.add(word, hash);
+            plain.add(word, hash);
+            sketched.add(word, hash);
+        }
+
+        for (const SpaceSavingCounter* counter : {&plain, &sketched}) {
+            QCOMPARE(counter->size(), qsizetype(32));
+            QCOMPARE(counter->totalCount(), 20000ULL);
+            const auto top = counter->top(5);
+            QCOMPARE(top.size(), 5);
+            for (const SpaceSavingCounter::Entry& entry : top) {
+                const quint64 truth = exact.value(entry.word);
+                QVERIFY(entry.count >= truth);
+                QVERIFY(entry.count - entry.error <= truth);
+            }
+            QCOMPARE(top[0].word, QByteArray("w1"));
+        }
+
+        // Если словарь помещается в ёмкость, приближённый режим совпадает с точным
+        Config cfg = Config::defaultConfig();
+        cfg.top_n = 20;
+        const QStringList blocks = makeBlocks(16);
+        const auto precise = runToFinish(cfg, blocks);
+        cfg.approximate_counting = true;
+        cfg.approx_capacity = 1000;
+        cfg.analyzer_threads = 4;
+        const auto approximate = runToFinish(cfg, blocks);
+        QCOMPARE(approximate.size(), 20);
+        QVERIFY(approximate == precise);
+    }
+
+    void testWindowedCountsExpiry() {
+        // Удаление из таблицы не должно терять соседей по цепочке пробирования
+        WordCountTable table;
+        for (int i = 0; i < 5000; ++i)
+            table.add("word" + QByteArray::number(i));
+        for (int i = 0; i < 5000; i += 2) {
+            const QByteArray word = "word" + QByteArray::number(i);
+            QCOMPARE(table.subtract(word, WordCountTable::hash(word), 1), 0ULL);
+        }
+        QCOMPARE(table.size(), qsizetype(2500));
+        for (int i = 0; i < 5000; ++i)
+            QCOMPARE(table.value("word" + QByteArray::number(i)), quint64(i % 2));
+
+        const auto add = [](WindowedCounts& counts, const QByteArray& word, quint64 delta, qint64 now) {
+            counts.add(word, WordCountTable::hash(word), delta, now);
+        };
+        const auto valueOf = [](const WindowedCounts& counts, const QByteArray& word) {
+            quint64 value = 0;
+            counts.forEach([&](QByteArrayView w, quint64 count) {
+                if (w == word)
+                    value = count;
+            });
+            return value;
+        };
+
+        // Окно 1 с из четырёх интервалов по 250 мс
+        WindowedCounts sliding(WindowedCounts::Mode::Sliding, 1000, 4);
+        add(sliding, "alpha", 1, 0);
+        add(sliding, "beta", 1, 300);
+        add(sliding, "alpha", 1, 600);
+        sliding.advance(999);
+        QCOMPARE(valueOf(sliding, "alpha"), 2ULL);
+        QCOMPARE(valueOf(sliding, "beta"), 1ULL);
+        sliding.advance(1000);
+        QCOMPARE(valueOf(sliding, "alpha"), 1ULL);
+        sliding.advance(1300);
+        QCOMPARE(valueOf(sliding, "beta"), 0ULL);
+        QCOMPARE(sliding.size(), qsizetype(1));
+        sliding.advance(60000);
+        QCOMPARE(sliding.size(), qsizetype(0));
+
+        // Полупериод 1 с; после многих полупериодов угасшие слова выбрасываются
+        WindowedCounts decay(WindowedCounts::Mode::Decay, 1000, 0);
+        add(decay, "alpha", 8, 0);
+        decay.advance(1000);
+        QCOMPARE(valueOf(decay, "alpha"), 4ULL);
+        add(decay, "beta", 4, 1000);
+        decay.advance(2000);
+        QCOMPARE(valueOf(decay, "alpha"), 2ULL);
+        QCOMPARE(valueOf(decay, "beta"), 2ULL);
+        add(decay, "gamma", 1, 40000);
+        QCOMPARE(valueOf(decay, "gamma"), 1ULL);
+        QCOMPARE(decay.size(), qsizetype(1));
+
+        // Кандидаты в топ: сдвиг без истёкших интервалов топ не трогает, истечение собирает его заново
+        const auto topOf = [](const WindowedCounts& counts) {
+            QMap<QByteArray, quint64> top;
+            counts.forEachTop([&top](QByteArrayView w, quint64 count) { top[w.toByteArray()] = count; });
+            return top;
+        };
+        WindowedCounts ranked(WindowedCounts::Mode::Sliding, 1000, 4, 1);
+        const auto addRanked = [&ranked](const QByteArray& word, quint64 delta, qint64 now) {
+            return ranked.add(word, WordCountTable::hash(word), delta, now);
+        };
+        QVERIFY(addRanked("alpha", 3, 0));
+        QVERIFY(addRanked("beta", 2, 300));
+        QVERIFY(addRanked("beta", 2, 400));
+        QVERIFY(!ranked.advance(700));
+        QCOMPARE(topOf(ranked).value("beta"), 4ULL);
+        QVERIFY(ranked.advance(1000));
+        QCOMPARE(topOf(ranked).value("beta"), 4ULL);
+        QVERIFY(!topOf(ranked).contains("alpha"));
+        QVERIFY(ranked.advance(1300));
+        QVERIFY(topOf(ranked).isEmpty());
+        QVERIFY(!ranked.advance(5000));
+
+        WindowedCounts rankedDecay(WindowedCounts::Mode::Decay, 1000, 0, 2);
+        rankedDecay.add("alpha", WordCountTable::hash("alpha"), 8, 0);
+        QVERIFY(!rankedDecay.advance(500));
+        QVERIFY(rankedDecay.advance(1000));
+        QCOMPARE(topOf(rankedDecay).value("alpha"), 4ULL);
+    }
+
+    void testTokenizerFastPathMatchesRegex() {
+        // ASCII, смешанный регистр, кириллица, латиница с диакритикой, битый UTF-8
+        const QByteArray text = "Hello, wOrld! foo_bar 42x -dash- "
+                                "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 "
+                                "caf\xc3\xa9 bad\xff\xfe" "byte \xe2\x82 tail";
+
+        // Быстрый шаблон и эквивалентный ему, который таблица не разбирает
+        const QList<QPair<QString, QString>> patterns = {
+            {"\\w+", "(?:\\w)+"},
+            {"\\d+", "(?:\\d)+"},
+            {"[a-z0-9]+", "(?:[a-z0-9])+"},
+            {"[\\w-]+", "(?:[\\w-])+"},
+            {"(*UCP)\\w+", "(*UCP)(?:\\w)+"},
+        };
+
+        for (bool caseSensitive : {false, true}) {
+            for (const auto& pattern : patterns) {
+                Config cfg = Config::defaultConfig();
+                cfg.case_sensitive = caseSensitive;
+
+                cfg.string_pattern = pattern.first;
+                QVERIFY(WordTokenizer(cfg).isFastPath() || caseSensitive);
+                const QStringList fast = tokenize(cfg, text);
+
+                cfg.string_pattern = pattern.second;
+                QVERIFY(!WordTokenizer(cfg).isFastPath());
+                const QStringList slow = tokenize(cfg, text);
+
+                QCOMPARE(fast, slow);
+            }
+        }
+    }
+
+    void testWorkerPoolMatchesSingleThread() {
+        Config cfg = Config::defaultConfig();
+        cfg.top_n = 20;
+        const QStringList blocks = makeBlocks(64);
+
+        cfg.analyzer_threads = 1;
+        const auto single = runToFinish(cfg, blocks);
+        QCOMPARE(single.size(), 20);
+
+        cfg.analyzer_threads = 4;
+        const auto pooled = runToFinish(cfg, blocks);
+        QVERIFY(pooled == single);
+    }
+
+    void testTopTieOrdering() {
+        // При равном счёте в топ попадают слова, большие по строковому сравнению
+        Config cfg = Config::defaultConfig();
+        cfg.top_n = 2;
+        const auto list = runToFinish(cfg, {"b a c b a c d"});
+
+        QCOMPARE(list.size(), 2);
+        QCOMPARE(list[0], qMakePair(2ULL, QString("b")));
+        QCOMPARE(list[1], qMakePair(2ULL, QString("c")));
+
+        // Слово вне BMP (в UTF-16 - суррогаты) младше слова из U+E000..U+FFFF, как у QString,
+        // хотя его первый байт в UTF-8 больше
+        const QString supplementary = QString::fromUtf8("\xf0\x90\x90\xa8");    // U+10428
+        const QString fullwidth = QString::fromUtf8("\xef\xbd\x81");             // U+FF41
+        QVERIFY(supplementary < fullwidth);
+        cfg.top_n = 1;
+        cfg.string_pattern = "(*UCP)\\w+";
+        for (const QString& text : {fullwidth + " " + supplementary, supplementary + " " + fullwidth}) {
+            const auto unicode = runToFinish(cfg, {text + " " + text});
+            QCOMPARE(unicode.size(), 1);
+            QCOMPARE(unicode[0], qMakePair(2ULL, fullwidth));
+        }
+        QVERIFY(TopNSelector::compareKeys(supplementary.toUtf8(), fullwidth.toUtf8()) < 0);
+        QVERIFY(TopNSelector::compareKeys("\xed\x9f\xbf", supplementary.toUtf8()) < 0);  // U+D7FF
+    }
+
+    void testMappedWindowsBoundedMemory() {
+        // Файл во много раз больше бюджета отображения: память не должна расти с размером файла
+        const QByteArray line = "alpha beta alpha gamma\n";
+        const QByteArray chunk = line.repeated((1 << 20) / line.size());
+        const int chunkCount = 48;
+
+        QTemporaryFile tmp;
+        QVERIFY(tmp.open());
+        for (int i = 0; i < chunkCount; ++i)
+            QCOMPARE(tmp.write(chunk), qint64(chunk.size()));
+        tmp.flush();
+        const quint64 lines = quint64(chunk.size() / line.size()) * chunkCount;
+
+        Config cfg = Config::defaultConfig();
+        cfg.top_n = 3;
+        cfg.chunk_size_bytes = 64 * 1024;
+        cfg.max_chunks_in_mem_num = 8;
+        cfg.mmap_window_bytes = 1024 * 1024;
+        cfg.max_mapped_bytes = 4 * 1024 * 1024;
+        cfg.analyzer_threads = 2;
+
+        auto reader = std::make_unique<FileReaderThread>(tmp.fileName(), cfg);
+        auto analyzer = std::make_unique<BlockAnalyzerThread>(cfg, reader.get());
+        analyzer->setTotalSize(tmp.size());
+
+        connect(reader.get(), &FileReaderThread::chunkIsReady,
+                analyzer.get(), &BlockAnalyzerThread::analyzeBlock, Qt::QueuedConnection);
+        connect(reader.get(), &FileReaderThread::readingFinished,
+                analyzer.get(), &BlockAnalyzerThread::analyzingFinishing, Qt::QueuedConnection);
+        connect(analyzer.get(), &BlockAnalyzerThread::thresholdBlockFreed,
+                reader.get(), &FileReaderThread::readChunk, Qt::QueuedConnection);
+
+        QSignalSpy spyTop(analyzer.get(), &BlockAnalyzerThread::topWords);
+        QSignalSpy spyFinished(analyzer.get(), &BlockAnalyzerThread::analyzisFinished);
+
+        const qint64 rssBefore = residentKb();
+        reader->start();
+        analyzer->start();
+        QMetaObject::invokeMethod(analyzer.get(), "startAnalyzis", Qt::QueuedConnection);
+        QMetaObject::invokeMethod(reader.get(), "startReading", Qt::QueuedConnection);
+
+        QVERIFY2(spyFinished.wait(30000), "Timeout waiting for analyzisFinished");
+        const qint64 rssAfter = residentKb();
+
+        QVERIFY(reader->getWindows().peakMappedBytes() <= cfg.max_mapped_bytes);
+        if (rssBefore > 0 && rssAfter > 0)
+            QVERIFY2(rssAfter - rssBefore < 16 * 1024, "RSS grew with file size");
+
+        const auto list = spyTop.takeLast().at(0).value<QVector<QPair<quint64, QString>>>();
+        QCOMPARE(list.size(), 3);
+        QCOMPARE(list[2], qMakePair(lines * 2, QString("alpha")));
+        QCOMPARE(list[1], qMakePair(lines, QString("gamma")));
+
+        QThread* mainThread = QThread::currentThread();
+        for (QThread* thread : {static_cast<QThread*>(reader.get()), static_cast<QThread*>(analyzer.get())}) {
+            QMetaObject::invokeMethod(thread, [thread, mainThread]() {
+                thread->moveToThread(mainThread);
+            }, Qt::BlockingQueuedConnection);
+            thread->quit();
+            thread->wait();
+        }
+    }
+
+    void testFollowAppendsTruncationAndRotation() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString path = dir.filePath("app.log");
+        const auto append = [&path](const QByteArray& data) {
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Append));
+            QCOMPARE(file.write(data), qint64(data.size()));
+        };
+        append("alpha beta\n");
+
+        Config cfg = Config::defaultConfig();
+        cfg.top_n = 5;
+        cfg.follow = true;
+        cfg.follow_poll_ms = 50;
+
+        auto reader = std::make_unique<FileReaderThread>(path, cfg);
+        auto analyzer = std::make_unique<BlockAnalyzerThread>(cfg, reader.get());
+
+        connect(reader.get(), &FileReaderThread::chunkIsReady,
+                analyzer.get(), &BlockAnalyzerThread::analyzeBlock, Qt::QueuedConnection);
+        connect(analyzer.get(), &BlockAnalyzerThread::thresholdBlockFreed,
+                reader.get(), &FileReaderThread::readChunk, Qt::QueuedConnection);
+        connect(reader.get(), &FileReaderThread::totalSizeChanged,
+                analyzer.get(), &BlockAnalyzerThread::setTotalSize, Qt::QueuedConnection);
+
+        QSignalSpy spyTop(analyzer.get(), &BlockAnalyzerThread::topWords);
+        QSignalSpy spyFinished(reader.get(), &FileReaderThread::readingFinished);
+        QSignalSpy spyTruncated(reader.get(), &FileReaderThread::fileTruncated);
+        QSignalSpy spyRotated(reader.get(), &FileReaderThread::fileRotated);
+
+        const auto countOf = [&spyTop](const QString& word) -> quint64 {
+            if (spyTop.isEmpty())
+                return 0;
+            const auto list = spyTop.last().at(0).value<QVector<QPair<quint64, QString>>>();
+            for (const auto& entry : list) {
+                if (entry.second == word)
+                    return entry.first;
+            }
+            return 0;
+        };
+
+        reader->start();
+        analyzer->start();
+        QMetaObject::invokeMethod(analyzer.get(), "startAnalyzis", Qt::QueuedConnection);
+        QMetaObject::invokeMethod(reader.get(), "startReading", Qt::QueuedConnection);
+        QTRY_COMPARE_WITH_TIMEOUT(countOf("alpha"), quint64(1), 5000);
+
+        // Дописанные байты, в том числе слово, разорванное между двумя записями
+        append("alpha gamma alph");
+        QTRY_COMPARE_WITH_TIMEOUT(countOf("gamma"), quint64(1), 5000);
+        append("a\n");
+        QTRY_COMPARE_WITH_TIMEOUT(countOf("alpha"), quint64(3), 5000);
+        QCOMPARE(countOf("alph"), quint64(0));
+
+        // copytruncate: счётчики сохраняются, файл читается заново с начала
+        {
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::ReadWrite));
+            QVERIFY(file.resize(0));
+        }
+        append("delta\n");
+        QTRY_COMPARE_WITH_TIMEOUT(countOf("delta"), quint64(1), 5000);
+        QCOMPARE(spyTruncated.count(), 1);
+        QCOMPARE(countOf("alpha"), quint64(3));
+
+        // Ротация переименованием: по пути появляется новый файл
+        QVERIFY(QFile::rename(path, path + ".1"));
+        append("omega omega\n");
+        QTRY_COMPARE_WITH_TIMEOUT(countOf("omega"), quint64(2), 5000);
+        QCOMPARE(spyRotated.count(), 1);
+        QCOMPARE(spyFinished.count(), 0);
+
+        // Усечение, пока блоки старой версии в очереди, а один разбирает анализатор:
+        // блоки - копии, так что чтение идёт дальше без SIGBUS и ничего не теряется
+        const QString queuedPath = dir.filePath("queued.log");
+        const QByteArray line("epsilon zeta\n");
+        {
+            QFile file(queuedPath);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            QCOMPARE(file.write(line.repeated(4096)), qint64(line.size() * 4096));
+        }
+        Config queuedCfg = cfg;
+        queuedCfg.chunk_size_bytes = 4096;
+        queuedCfg.max_chunks_in_mem_num = 4;
+        auto queuedReader = std::make_unique<FileReaderThread>(queuedPath, queuedCfg);
+        QSignalSpy spyQueuedTruncated(queuedReader.get(), &FileReaderThread::fileTruncated);
+        queuedReader->start();
+        QMetaObject::invokeMethod(queuedReader.get(), "startReading", Qt::QueuedConnection);
+        QTRY_COMPARE_WITH_TIMEOUT(queuedReader->dataSize(), qsizetype(4), 5000);
+
+        QByteArrayView held;
+        qsizetype sizeBefore = 0;
+        QCOMPARE(queuedReader->takeDataBlocks(&held, 1, sizeBefore), qsizetype(1));
+        QTRY_COMPARE_WITH_TIMEOUT(queuedReader->dataSize(), qsizetype(4), 5000);
+
+        // "Анализатор" перечитывает взятый блок всё время, пока файл усекают
+        std::atomic<bool> stop{false};
+        std::atomic<bool> intact{true};
+        std::unique_ptr<QThread> worker(QThread::create([&]() {
+            while (!stop.load()) {
+                for (qsizetype i = 0; i < held.size(); ++i) {
+                    if (held[i] != line[i % line.size()])
+                        intact = false;
+                }
+            }
+        }));
+        worker->start();
+        {
+            QFile file(queuedPath);
+            QVERIFY(file.open(QIODevice::ReadWrite));
+            QVERIFY(file.resize(0));
+            QCOMPARE(file.write("eta\n"), qint64(4));
+        }
+        QTRY_COMPARE_WITH_TIMEOUT(spyQueuedTruncated.count(), 1, 5000);
+        QTest::qWait(100);
+        stop = true;
+        QVERIFY(worker->wait(5000));
+        QVERIFY(intact.load());
+        QVERIFY(held.size() > 0 && held.size() % line.size() == 0);
+        queuedReader->releaseDataBlock(held);
+
+        // Очередь старой версии цела, за ней - новое начало файла
+        QByteArray rest;
+        const auto drainRest = [&]() {
+            while (!queuedReader->isDataEmpty()) {
+                const QByteArrayView block = queuedReader->getDataBlock();
+                rest += block.toByteArray();
+                queuedReader->releaseDataBlock(block);
+            }
+            return rest.endsWith("eta\n");
+        };
+        QTRY_VERIFY_WITH_TIMEOUT(drainRest(), 5000);
+        QVERIFY(rest.size() > 4);
+        QCOMPARE(rest.chopped(4), line.repeated((rest.size() - 4) / line.size()));
+
+        QThread* mainThread = QThread::currentThread();
+        for (QThread* thread : {static_cast<QThread*>(reader.get()), static_cast<QThread*>(analyzer.get()),
+                                static_cast<QThread*>(queuedReader.get())}) {
+            QMetaObject::invokeMethod(thread, [thread, mainThread]() {
+                thread->moveToThread(mainThread);
+            }, Qt::BlockingQueuedConnection);
+            thread->quit();
+            thread->wait();
+        }
+    }
+
+    void testMultiFileReaderPacksAndAttributes() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(QDir(dir.path()).mkpath("sub"));
+        const auto write = [&dir](const QString& name, const QByteArray& data) {
+            QFile file(dir.filePath(name));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            QCOMPARE(file.write(data), qint64(data.size()));
+        };
+        // Мелкие файлы без перевода строки в конце: слова на стыке не должны склеиться
+        for (int i = 0; i < 20; ++i)
+            write(QString("small%1.log").arg(i), "alpha beta");
+        write("sub/nested.log", "gamma gamma");
+        write("sub/skipped.txt", "zeta zeta zeta");
+        QByteArray large;
+        for (int i = 0; i < 5000; ++i)
+            large += "delta epsilon\n";
+        write("large.log", large);
+
+        QString error;
+        const QStringList files = MultiFileReaderThread::expandInputs({dir.path(), dir.filePath("*.log")}, {"*.log"}, &error);
+        QVERIFY(error.isEmpty());
+        QCOMPARE(files.size(), 22);
+
+        Config cfg = Config::defaultConfig();
+        cfg.top_n = 10;
+        cfg.chunk_size_bytes = 4096;
+        cfg.small_file_bytes = 1024;
+        cfg.file_reader_threads = 3;
+        cfg.per_file_top = true;
+        cfg.input_name_filters = "*.log";
+
+        auto reader = std::make_unique<MultiFileReaderThread>(QStringList{dir.path()}, cfg);
+        auto analyzer = std::make_unique<BlockAnalyzerThread>(cfg, reader.get());
+        connect(reader.get(), &MultiFileReaderThread::chunkIsReady,
+                analyzer.get(), &BlockAnalyzerThread::analyzeBlock, Qt::QueuedConnection);
+        connect(reader.get(), &MultiFileReaderThread::readingFinished,
+                analyzer.get(), &BlockAnalyzerThread::analyzingFinishing, Qt::QueuedConnection);
+
+        QSignalSpy spyTop(analyzer.get(), &BlockAnalyzerThread::topWords);
+        QSignalSpy spyFileTop(analyzer.get(), &BlockAnalyzerThread::fileTopWords);
+        QSignalSpy spyFinished(analyzer.get(), &BlockAnalyzerThread::analyzisFinished);
+        QSignalSpy spyError(reader.get(), &MultiFileReaderThread::readingError);
+
+        reader->start();
+        analyzer->start();
+        QMetaObject::invokeMethod(analyzer.get(), "startAnalyzis", Qt::QueuedConnection);
+        QMetaObject::invokeMethod(reader.get(), "startReading", Qt::QueuedConnection);
+        QVERIFY(spyFinished.wait(10000));
+        QCOMPARE(spyError.count(), 0);
+        QCOMPARE(reader->getTotalBytes(), quint64(20 * 10 + 11 + large.size()));
+
+        QMap<QString, quint64> global;
+        for (const auto& entry : spyTop.last().at(0).value<QVector<QPair<quint64, QString>>>())
+            global[entry.second] = entry.first;
+        QCOMPARE(global.value("alpha"), quint64(20));
+        QCOMPARE(global.value("beta"), quint64(20));
+        QCOMPARE(global.value("gamma"), quint64(2));
+        QCOMPARE(global.value("delta"), quint64(5000));
+        QVERIFY(!global.contains("betaalpha"));
+        QVERIFY(!global.contains("zeta"));
+
+        // Топ файла уходит, когда досчитан его последний блок, и только один раз
+        QCOMPARE(spyFileTop.count(), 22);
+        QSet<QString> fileTopSources;
+        for (const QList<QVariant>& args : spyFileTop) {
+            const QString source = args.at(0).toString();
+            fileTopSources.insert(source);
+            const auto list = args.at(1).value<QVector<QPair<quint64, QString>>>();
+            QVERIFY(!list.isEmpty());
+            if (source.endsWith("large.log"))
+                QCOMPARE(list.last().first, quint64(5000));
+            else if (source.endsWith("nested.log"))
+                QCOMPARE(list.last(), qMakePair(quint64(2), QString("gamma")));
+            else
+                QCOMPARE(list.last().first, quint64(1));
+        }
+        QCOMPARE(fileTopSources.size(), 22);
+
+        QThread* mainThread = QThread::currentThread();
+        for (QThread* thread : {static_cast<QThread*>(reader.get()), static_cast<QThread*>(analyzer.get())}) {
+            QMetaObject::invokeMethod(thread, [thread, mainThread]() {
+                thread->moveToThread(mainThread);
+            }, Qt::BlockingQueuedConnection);
+            thread->quit();
+            thread->wait();
+        }
+    }
+
+    void testGzipInputStreamsInBlocks() {
+#ifndef WORDPULSE_HAVE_ZLIB
+        QSKIP("built without zlib");
+#else
+        // Два склеенных gzip-члена, как после cat a.gz b.gz
+        const auto gzip = [](const QByteArray& data) {
+            z_stream stream{};
+            if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                return QByteArray();
+            QByteArray out(static_cast<qsizetype>(deflateBound(&stream, static_cast<uLong>(data.size()))), Qt::Uninitialized);
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+            stream.avail_in = static_cast<uInt>(data.size());
+            stream.next_out = reinterpret_cast<Bytef*>(out.data());
+            stream.avail_out = static_cast<uInt>(out.size());
+            const int rc = deflate(&stream, Z_FINISH);
+            out.resize(static_cast<qsizetype>(stream.total_out));
+            deflateEnd(&stream);
+            return rc == Z_STREAM_END ? out : QByteArray();
+        };
+        QByteArray first;
+        for (int i = 0; i < 3000; ++i)
+            first += "alpha beta beta\n";
+        const QByteArray archive = gzip(first) + gzip("gamma alpha");
+        QVERIFY(archive.size() > 20);
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString path = dir.filePath("app.log.gz");
+        {
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            QCOMPARE(file.write(archive), qint64(archive.size()));
+        }
+        QCOMPARE(StreamDecoder::detect(path), StreamDecoder::Format::Gzip);
+
+        Config cfg = Config::defaultConfig();
+        cfg.top_n = 5;
+        cfg.chunk_size_bytes = 1000;
+        cfg.max_chunks_in_mem_num = 2;
+        cfg.file_reader_threads = 1;
+
+        auto reader = std::make_unique<MultiFileReaderThread>(QStringList{path}, cfg);
+        auto analyzer = std::make_unique<BlockAnalyzerThread>(cfg, reader.get());
+        connect(reader.get(), &MultiFileReaderThread::chunkIsReady,
+                analyzer.get(), &BlockAnalyzerThread::analyzeBlock, Qt::QueuedConnection);
+        connect(reader.get(), &MultiFileReaderThread::readingFinished,
+                analyzer.get(), &BlockAnalyzerThread::analyzingFinishing, Qt::QueuedConnection);
+        connect(reader.get(), &MultiFileReaderThread::totalSizeChanged,
+                analyzer.get(), &BlockAnalyzerThread::setTotalSize, Qt::QueuedConnection);
+
+        QSignalSpy spyTop(analyzer.get(), &BlockAnalyzerThread::topWords);
+        QSignalSpy spyProgress(analyzer.get(), &BlockAnalyzerThread::progress);
+        QSignalSpy spyFinished(analyzer.get(), &BlockAnalyzerThread::analyzisFinished);
+
+        reader->start();
+        analyzer->start();
+        QMetaObject::invokeMethod(analyzer.get(), "startAnalyzis", Qt::QueuedConnection);
+        QMetaObject::invokeMethod(reader.get(), "startReading", Qt::QueuedConnection);
+        QVERIFY(spyFinished.wait(10000));
+
+        // Прогресс идёт по сжатым байтам и сходится к размеру архива
+        QCOMPARE(reader->getTotalBytes(), quint64(archive.size()));
+        QCOMPARE(spyProgress.last().at(0).value<quint8>(), quint8(100));
+
+        QMap<QString, quint64> counts;
+        for (const auto& entry : spyTop.last().at(0).value<QVector<QPair<quint64, QString>>>())
+            counts[entry.second] = entry.first;
+        QCOMPARE(counts.value("alpha"), quint64(3001));
+        QCOMPARE(counts.value("beta"), quint64(6000));
+        QCOMPARE(counts.value("gamma"), quint64(1));
+        QCOMPARE(counts.size(), 3);
+
+        QThread* mainThread = QThread::currentThread();
+        for (QThread* thread : {static_cast<QThread*>(reader.get()), static_cast<QThread*>(analyzer.get())}) {
+            QMetaObject::invokeMethod(thread, [thread, mainThread]() {
+                thread->moveToThread(mainThread);
+            }, Qt::BlockingQueuedConnection);
+            thread->quit();
+            thread->wait();
+        }
+#endif
+    }
+
+    void testCheckpointSavesPrefixAndResumes() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString path = dir.filePath("big.log");
+        const QString checkpointPath = dir.filePath("run.checkpoint");
+        QByteArray data;
+        for (int i = 0; i < 20000; ++i)
+            data += QString("w%1 ").arg(i % 313).toUtf8();
+        {
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            QCOMPARE(file.write(data), qint64(data.size()));
+        }
+
+        Config cfg = Config::defaultConfig();
+        cfg.top_n = 400;
+        cfg.chunk_size_bytes = 4096;
+        cfg.max_chunks_in_mem_num = 4;
+        cfg.analyzer_threads = 2;
+        cfg.checkpoint_path = checkpointPath;
+        cfg.checkpoint_interval_ms = 5;
+
+        const auto countPrefix = [&cfg, &data](qsizetype length) {
+            QMap<QString, quint64> counts;
+            WordTokenizer(cfg).tokenize(QByteArrayView(data).first(length), [&counts](QByteArrayView word) {
+                counts[QString::fromUtf8(word)] += 1;
+            });
+            return counts;
+        };
+        const auto lastTop = [](const QSignalSpy& spy) {
+            QMap<QString, quint64> counts;
+            for (const auto& entry : spy.last().at(0).value<QVector<QPair<quint64, QString>>>())
+                counts[entry.second] = entry.first;
+            return counts;
+        };
+        const auto stopThreads = [](QThread* reader, QThread* analyzer) {
+            QThread* mainThread = QThread::currentThread();
+            for (QThread* thread : {reader, analyzer}) {
+                QMetaObject::invokeMethod(thread, [thread, mainThread]() {
+                    thread->moveToThread(mainThread);
+                }, Qt::BlockingQueuedConnection);
+                thread->quit();
+                thread->wait();
+            }
+        };
+
+        // Первый запуск: читатель встаёт на паузу после первого блока, отмена сохраняет точку
+        {
+            auto reader = std::make_unique<FileReaderThread>(path, cfg);
+            auto analyzer = std::make_unique<BlockAnalyzerThread>(cfg, reader.get());
+            connect(reader.get(), &FileReaderThread::chunkIsReady,
+                    analyzer.get(), &BlockAnalyzerThread::analyzeBlock, Qt::QueuedConnection);
+            FileReaderThread* readerPtr = reader.get();
+            connect(reader.get(), &FileReaderThread::chunkIsReady, reader.get(), [readerPtr]() {
+                readerPtr->pauseReading();
+            }, Qt::DirectConnection);
+            QSignalSpy spyTop(analyzer.get(), &BlockAnalyzerThread::topWords);
+
+            QCOMPARE(analyzer->prepareCheckpoint(path), quint64(0));
+            analyzer->setTotalSize(quint64(data.size()));
+            reader->start();
+            analyzer->start();
+            QMetaObject::invokeMethod(analyzer.get(), "startAnalyzis", Qt::QueuedConnection);
+            QMetaObject::invokeMethod(reader.get(), "startReading", Qt::QueuedConnection);
+            QTRY_VERIFY_WITH_TIMEOUT(!spyTop.isEmpty() && !lastTop(spyTop).isEmpty(), 5000);
+
+            QMetaObject::invokeMethod(analyzer.get(), "cancelAnalyzis", Qt::BlockingQueuedConnection);
+            stopThreads(reader.get(), analyzer.get());
+        }
+
+        Checkpoint saved;
+        WordCountTable savedCounts;
+        QString error;
+        QVERIFY2(saved.load(checkpointPath, savedCounts, &error), qPrintable(error));
+        QVERIFY(saved.offset > 0 && saved.offset < quint64(data.size()));
+        QCOMPARE(data.at(qsizetype(saved.offset) - 1), ' ');
+        QVERIFY(saved.identity == Checkpoint::identityOf(path));
+        QMap<QString, quint64> savedMap;
+        savedCounts.forEach([&savedMap](QByteArrayView word, quint64, quint64 count) {
+            savedMap[QString::fromUtf8(word)] = count;
+        });
+        QCOMPARE(savedMap, countPrefix(qsizetype(saved.offset)));
+
+        // Второй запуск продолжает с точки и досчитывает файл; точка после конца удаляется
+        {
+            auto reader = std::make_unique<FileReaderThread>(path, cfg);
+            auto analyzer = std::make_unique<BlockAnalyzerThread>(cfg, reader.get());
+            connect(reader.get(), &FileReaderThread::chunkIsReady,
+                    analyzer.get(), &BlockAnalyzerThread::analyzeBlock, Qt::QueuedConnection);
+            connect(analyzer.get(), &BlockAnalyzerThread::thresholdBlockFreed,
+                    reader.get(), &FileReaderThread::readChunk, Qt::QueuedConnection);
+            connect(reader.get(), &FileReaderThread::readingFinished,
+                    analyzer.get(), &BlockAnalyzerThread::analyzingFinishing, Qt::QueuedConnection);
+            QSignalSpy spyTop(analyzer.get(), &BlockAnalyzerThread::topWords);
+            QSignalSpy spyFinished(analyzer.get(), &BlockAnalyzerThread::analyzisFinished);
+
+            const quint64 offset = analyzer->prepareCheckpoint(path);
+            QCOMPARE(offset, saved.offset);
+            reader->setStartPos(qint64(offset));
+            analyzer->setTotalSize(quint64(data.size()));
+            reader->start();
+            analyzer->start();
+            QMetaObject::invokeMethod(analyzer.get(), "startAnalyzis", Qt::QueuedConnection);
+            QMetaObject::invokeMethod(reader.get(), "startReading", Qt::QueuedConnection);
+            QVERIFY(spyFinished.wait(10000));
+
+            QCOMPARE(lastTop(spyTop), countPrefix(data.size()));
+            QVERIFY(!QFile::exists(checkpointPath));
+            stopThreads(reader.get(), analyzer.get());
+        }
+
+        // Точки пишутся, пока воркеры считают: каждая - ровно префикс до своей границы
+        {
+            QByteArray big;
+            for (int i = 0; i < 40; ++i)
+                big += data;
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            QCOMPARE(file.write(big), qint64(big.size()));
+            file.close();
+            data = big;
+        }
+        Config busyCfg = cfg;
+        busyCfg.analyzer_threads = 4;
+        busyCfg.max_chunks_in_mem_num = 16;
+        busyCfg.checkpoint_interval_ms = 1;
+        {
+            auto reader = std::make_unique<FileReaderThread>(path, busyCfg);
+            auto analyzer = std::make_unique<BlockAnalyzerThread>(busyCfg, reader.get());
+            connect(reader.get(), &FileReaderThread::chunkIsReady,
+                    analyzer.get(), &BlockAnalyzerThread::analyzeBlock, Qt::QueuedConnection);
+            connect(analyzer.get(), &BlockAnalyzerThread::thresholdBlockFreed,
+                    reader.get(), &FileReaderThread::readChunk, Qt::QueuedConnection);
+            connect(reader.get(), &FileReaderThread::readingFinished,
+                    analyzer.get(), &BlockAnalyzerThread::analyzingFinishing, Qt::QueuedConnection);
+            QSignalSpy spyFinished(analyzer.get(), &BlockAnalyzerThread::analyzisFinished);
+
+            // Файл точки подменяется целиком (QSaveFile), так что прочитанный всегда цел
+            QList<QByteArray> captured;
+            QTimer capture;
+            connect(&capture, &QTimer::timeout, this, [&captured, &checkpointPath]() {
+                QFile saved(checkpointPath);
+                if (saved.open(QIODevice::ReadOnly)) {
+                    const QByteArray bytes = saved.readAll();
+                    if (captured.isEmpty() || captured.last() != bytes)
+                        captured.append(bytes);
+                }
+            });
+            capture.start(1);
+
+            QCOMPARE(analyzer->prepareCheckpoint(path), quint64(0));
+            analyzer->setTotalSize(quint64(data.size()));
+            reader->start();
+            analyzer->start();
+            QMetaObject::invokeMethod(analyzer.get(), "startAnalyzis", Qt::QueuedConnection);
+            QMetaObject::invokeMethod(reader.get(), "startReading", Qt::QueuedConnection);
+            QVERIFY(spyFinished.wait(20000));
+            capture.stop();
+            stopThreads(reader.get(), analyzer.get());
+
+            QVERIFY(!captured.isEmpty());
+            const QString copyPath = dir.filePath("captured.checkpoint");
+            // Префикс считается заново для каждой точки: проверяем не больше десятка
+            const qsizetype step = qMax<qsizetype>(1, captured.size() / 10);
+            for (qsizetype c = 0; c < captured.size(); c += step) {
+                const QByteArray& bytes = captured[c];
+                QFile copy(copyPath);
+                QVERIFY(copy.open(QIODevice::WriteOnly | QIODevice::Truncate));
+                QCOMPARE(copy.write(bytes), qint64(bytes.size()));
+                copy.close();
+
+                Checkpoint point;
+                WordCountTable pointCounts;
+                QVERIFY2(point.load(copyPath, pointCounts, &error), qPrintable(error));
+                QVERIFY(point.offset <= quint64(data.size()));
+                QMap<QString, quint64> pointMap;
+                pointCounts.forEach([&pointMap](QByteArrayView word, quint64, quint64 count) {
+                    pointMap[QString::fromUtf8(word)] = count;
+                });
+                QCOMPARE(pointMap, countPrefix(qsizetype(point.offset)));
+            }
+        }
+    }
+
+    void testPipelineMetricsCounters() {
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        QByteArray data;
+        for (int i = 0; i < 5000; ++i)
+            data += "one two three\n";
+        QCOMPARE(file.write(data), qint64(data.size()));
+        file.flush();
+
+        Config cfg = Config::defaultConfig();
+        cfg.chunk_size_bytes = 1024;
+        cfg.max_chunks_in_mem_num = 2;
+        cfg.analyzer_threads = 2;
+        cfg.metrics_interval_ms = 10;
+
+        auto reader = std::make_unique<FileReaderThread>(file.fileName(), cfg);
+        auto analyzer = std::make_unique<BlockAnalyzerThread>(cfg, reader.get());
+        connect(reader.get(), &FileReaderThread::chunkIsReady,
+                analyzer.get(), &BlockAnalyzerThread::analyzeBlock, Qt::QueuedConnection);
+        connect(analyzer.get(), &BlockAnalyzerThread::thresholdBlockFreed,
+                reader.get(), &FileReaderThread::readChunk, Qt::QueuedConnection);
+        connect(reader.get(), &FileReaderThread::readingFinished,
+                analyzer.get(), &BlockAnalyzerThread::analyzingFinishing, Qt::QueuedConnection);
+
+        QSignalSpy spyMetrics(analyzer.get(), &BlockAnalyzerThread::metricsUpdated);
+        QSignalSpy spyFinished(analyzer.get(), &BlockAnalyzerThread::analyzisFinished);
+
+        analyzer->setTotalSize(quint64(data.size()));
+        reader->start();
+        analyzer->start();
+        QMetaObject::invokeMethod(analyzer.get(), "startAnalyzis", Qt::QueuedConnection);
+        QMetaObject::invokeMethod(reader.get(), "startReading", Qt::QueuedConnection);
+        QVERIFY(spyFinished.wait(10000));
+
+        // Последний срез - итог всего прогона
+        QVERIFY(!spyMetrics.isEmpty());
+        const PipelineMetrics metrics = spyMetrics.last().at(0).value<PipelineMetrics>();
+        QCOMPARE(metrics.bytesRead, quint64(data.size()));
+        QCOMPARE(metrics.bytesAnalyzed, quint64(data.size()));
+        QCOMPARE(metrics.blocksAnalyzed, metrics.blocksRead);
+        QVERIFY(metrics.blocksRead >= quint64(data.size() / cfg.chunk_size_bytes));
+        QCOMPARE(metrics.tokens, quint64(15000));
+        QCOMPARE(metrics.queueDepth, qint64(0));
+        QCOMPARE(metrics.queueCapacity, qint64(2));
+        QCOMPARE(metrics.analyzerThreads, 2);
+        QCOMPARE(metrics.tableWords, qint64(3));
+        QVERIFY(metrics.tableBytes > 0);
+        QCOMPARE(metrics.etaMs, qint64(0));
+        QVERIFY(metrics.analyzerBusyMs + metrics.analyzerStarvedMs >= 2 * metrics.elapsedMs);
+        QCOMPARE(metrics.toJson().value("tokens").toInteger(), qint64(15000));
+
+        QThread* mainThread = QThread::currentThread();
+        for (QThread* thread : {static_cast<QThread*>(reader.get()), static_cast<QThread*>(analyzer.get())}) {
+            QMetaObject::invokeMethod(thread, [thread, mainThread]() {
+                thread->moveToThread(mainThread);
+            }, Qt::BlockingQueuedConnection);
+            thread->quit();
+            thread->wait();
+        }
+    }
+
+    void testTracerWritesChromeJson() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString path = dir.filePath("trace.json");
+
+        { TraceSpan ignored("beforeStart"); }
+        Tracer::start();
+        {
+            TraceSpan outer("outer", "offset", 4096);
+            TraceSpan inner("inner");
+        }
+        QThreadPool pool;
+        pool.start([]() { TraceSpan span("pooled", "bytes", 7); });
+        pool.waitForDone();
+        QString error;
+        QVERIFY2(Tracer::stop(path, &error), qPrintable(error));
+        { TraceSpan ignored("afterStop"); }
+        QVERIFY(!Tracer::isEnabled());
+
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QJsonParseError parseError;
+        const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+        QCOMPARE(parseError.error, QJsonParseError::NoError);
+
+        QMap<QString, QJsonObject> spans;
+        QSet<qint64> namedThreads;
+        for (const QJsonValue& value : doc.object().value("traceEvents").toArray()) {
+            const QJsonObject event = value.toObject();
+            if (event.value("ph").toString() == "M")
+                namedThreads.insert(event.value("tid").toInteger());
+            else
+                spans.insert(event.value("name").toString(), event);
+        }
+        QCOMPARE(spans.keys(), QStringList({"inner", "outer", "pooled"}));
+        QCOMPARE(spans["outer"].value("args").toObject().value("offset").toInteger(), qint64(4096));
+        QVERIFY(spans["outer"].value("dur").toDouble() >= spans["inner"].value("dur").toDouble());
+        QVERIFY(spans["inner"].value("ts").toDouble() >= spans["outer"].value("ts").toDouble());
+        QVERIFY(spans["pooled"].value("tid").toInteger() != spans["outer"].value("tid").toInteger());
+        QVERIFY(namedThreads.contains(spans["pooled"].value("tid").toInteger()));
+        QVERIFY(namedThreads.contains(spans["outer"].value("tid").toInteger()));
+    }
+
+    void testTopWordsDiffReachesTarget() {
+        using TopList = TopWordsDiff::TopList;
+        quint32 seed = 4242;
+        const auto next = [&seed](quint32 bound) {
+            seed = seed * 1103515245u + 12345u;
+            return (seed >> 16) % bound;
+        };
+        const auto randomTop = [&next]() {
+            TopList list;
+            const quint32 size = next(12);
+            while (static_cast<quint32>(list.size()) < size) {
+                const QString word = "w" + QString::number(next(30));
+                if (std::none_of(list.cbegin(), list.cend(), [&word](const auto& e) { return e.second == word; }))
+                    list.append({quint64(next(10)), word});
+            }
+            return list;
+        };
+
+        for (int round = 0; round < 2000; ++round) {
+            const TopList from = randomTop();
+            const TopList to = randomTop();
+            const TopWordsDiff diff = TopWordsDiff::compute(from, to);
+            QCOMPARE(diff.fromSize, qint32(from.size()));
+            TopList applied = from;
+            diff.apply(applied);
+            QCOMPARE(applied, to);
+        }
+
+        // Слово обогнало всех: одно перемещение в конец и новый счёт, без сброса
+        const TopList before = {{1, "a"}, {2, "b"}, {3, "c"}, {4, "d"}};
+        const TopList after = {{2, "b"}, {3, "c"}, {4, "d"}, {5, "a"}};
+        const TopWordsDiff diff = TopWordsDiff::compute(before, after);
+        QCOMPARE(diff.steps.size(), 2);
+        QCOMPARE(diff.steps[0].op, TopWordsDiff::Op::Move);
+        QCOMPARE(diff.steps[0].row, 0);
+        QCOMPARE(diff.steps[0].to, 4);
+        QCOMPARE(diff.steps[1].op, TopWordsDiff::Op::Count);
+        QCOMPARE(diff.steps[1].row, 3);
+        QVERIFY(TopWordsDiff::compute(after, after).steps.isEmpty());
+    }
+
+    void testSnapshotsPublishedOnlyOnChange() {
+        Config cfg = Config::defaultConfig();
+        cfg.top_n = 5;
+        MockDataProvider mock;
+
+        auto analyzer = std::make_unique<BlockAnalyzerThread>(cfg, &mock);
+        analyzer->setTotalSize(1000);
+        QSignalSpy spyReady(analyzer.get(), &BlockAnalyzerThread::snapshotReady);
+        QSignalSpy spyTop(analyzer.get(), &BlockAnalyzerThread::topWords);
+        analyzer->start();
+        QMetaObject::invokeMethod(analyzer.get(), "startAnalyzis", Qt::QueuedConnection);
+
+        mock.addData("alpha beta alpha ");
+        QMetaObject::invokeMethod(analyzer.get(), "analyzeBlock", Qt::QueuedConnection);
+        QVERIFY(spyReady.wait(1000));
+        const TopWordsSnapshotPtr first = analyzer->latestSnapshot();
+        QCOMPARE(spyReady.last().at(0).toULongLong(), first->version);
+        QCOMPARE(first->top, TopWordsDiff::TopList({{1, "beta"}, {2, "alpha"}}));
+        // Разница от пустого топа сброса приводит к тому же списку
+        TopWordsDiff::TopList rebuilt;
+        first->diff.apply(rebuilt);
+        QCOMPARE(rebuilt, first->top);
+
+        // Байты есть, а слов нет: топ прежний, сигналов и новой версии нет
+        mock.addData(" ,,, ");
+        QMetaObject::invokeMethod(analyzer.get(), "analyzeBlock", Qt::QueuedConnection);
+        QTest::qWait(100);
+        QCOMPARE(spyReady.count(), 1);
+        QCOMPARE(spyTop.count(), 1);
+        QCOMPARE(analyzer->latestSnapshot().get(), first.get());
+
+        mock.addData("beta beta ");
+        QMetaObject::invokeMethod(analyzer.get(), "analyzeBlock", Qt::QueuedConnection);
+        QVERIFY(spyReady.wait(1000));
+        const TopWordsSnapshotPtr second = analyzer->latestSnapshot();
+        QCOMPARE(second->version, first->version + 1);
+        QCOMPARE(second->diff.baseVersion, first->version);
+        QCOMPARE(second->top, TopWordsDiff::TopList({{2, "alpha"}, {3, "beta"}}));
+        // Старый снимок не тронут
+        QCOMPARE(first->top, TopWordsDiff::TopList({{1, "beta"}, {2, "alpha"}}));
+        TopWordsDiff::TopList updated = first->top;
+        second->diff.apply(updated);
+        QCOMPARE(updated, second->top);
+
+        QThread* mainThread = QThread::currentThread();
+        QMetaObject::invokeMethod(analyzer.get(), [analyzer = analyzer.get(), mainThread]() {
+            analyzer->moveToThread(mainThread);
+        }, Qt::BlockingQueuedConnection);
+        analyzer->quit();
+        analyzer->wait();
+    }
+
+    void testChunkTunerAdapts() {
+        Config cfg = Config::defaultConfig();
+        cfg.adaptive_chunking = true;
+        cfg.chunk_size_bytes = 128 * 1024;
+        cfg.chunk_size_min_bytes = 64 * 1024;
+        cfg.chunk_size_max_bytes = 1024 * 1024;
+        cfg.max_chunks_in_mem_num = 4;
+        cfg.queue_depth_min = 2;
+        cfg.queue_depth_max = 16;
+        cfg.analyzer_threads = 2;
+
+        ChunkTuner tuner(cfg);
+        qint64 now = 0;
+        qint64 stalled = 0;
+        QVERIFY(!tuner.update(now, stalled));
+        // Один период: blocks блоков по bytes, читатель простоял stalledNs
+        const auto period = [&](qint32 blocks, qint64 bytes, qint64 mapNs, qsizetype queued, qint64 stalledNs) {
+            for (qint32 i = 0; i < blocks; ++i)
+                tuner.onBlock(bytes, i == 0 ? mapNs : 1000, queued);
+            now += ChunkTuner::kPeriodNs;
+            stalled += stalledNs;
+            return tuner.update(now, stalled);
+        };
+
+        // Очередь всегда пустая, одно отображение дольше двух блоков: растут и блок, и очередь
+        QVERIFY(period(10, 128 * 1024, 60'000'000, 0, 0));
+        QCOMPARE(tuner.chunkSize(), qint64(256 * 1024));
+        QCOMPARE(tuner.depth(), 6);
+
+        // Скорость после шага упала - откат и пауза
+        QVERIFY(period(8, 64 * 1024, 1000, 0, 0));
+        QCOMPARE(tuner.chunkSize(), qint64(128 * 1024));
+        QCOMPARE(tuner.depth(), 4);
+        for (qint32 i = 0; i < ChunkTuner::kHoldPeriods; ++i)
+            QVERIFY(!period(10, 128 * 1024, 60'000'000, 0, 0));
+
+        // Упор в анализаторы: блок по 5 мс на воркера не трогаем, очередь ужимается до воркеров + 1
+        QVERIFY(period(100, 128 * 1024, 1000, 3, 200'000'000));
+        QCOMPARE(tuner.chunkSize(), qint64(128 * 1024));
+        QCOMPARE(tuner.depth(), 3);
+        QVERIFY(!tuner.lastDecision().isEmpty());
+        QVERIFY(!period(100, 128 * 1024, 1000, 3, 200'000'000));
+        QCOMPARE(tuner.depth(), 3);
+
+        // Мелкие блоки (меньше 2 мс на воркера) укрупняются, не выходя за верхнюю границу
+        for (qint32 i = 0; i < 10; ++i)
+            period(1000, 64 * 1024, 1000, 3, 200'000'000);
+        QCOMPARE(tuner.chunkSize(), cfg.chunk_size_max_bytes);
+
+        // Без adaptive_chunking - ровно значения из конфига
+        cfg.adaptive_chunking = false;
+        ChunkTuner fixed(cfg);
+        fixed.update(0, 0);
+        for (qint32 i = 0; i < 10; ++i)
+            fixed.onBlock(128 * 1024, 1000, 0);
+        QVERIFY(!fixed.update(ChunkTuner::kPeriodNs, 0));
+        QCOMPARE(fixed.chunkSize(), cfg.chunk_size_bytes);
+        QCOMPARE(fixed.depth(), cfg.max_chunks_in_mem_num);
+    }
+
+    void testAsyncReaderCarriesWordsAcrossBuffers() {
+        if (!AsyncFileReaderThread::isSupported())
+            QSKIP("read_backend async needs a Unix system");
+
+        // Слова разной длины: стыки буферов по 4 КиБ приходятся на середины слов
+        QByteArray content;
+        quint32 seed = 7;
+        while (content.size() < 200 * 1024) {
+            seed = seed * 1103515245u + 12345u;
+            content.append(QByteArray(1 + (seed >> 16) % 40, char('a' + (seed >> 8) % 26)));
+            content.append((seed >> 4) % 5 ? ' ' : '\n');
+        }
+        // Слово длиннее трёх буферов копится в куче и не разрезается
+        content.insert(content.indexOf(' ', 100 * 1024) + 1, QByteArray(3 * 4096 + 123, 'z') + ' ');
+        QTemporaryFile tmp;
+        QVERIFY(tmp.open());
+        QCOMPARE(tmp.write(content), qint64(content.size()));
+        tmp.flush();
+
+        Config cfg = Config::defaultConfig();
+        cfg.read_backend = Config::ReadBackend::Async;
+        cfg.chunk_size_bytes = 4096;
+        cfg.max_chunks_in_mem_num = 4;
+        cfg.io_depth = 3;
+        cfg.analyzer_threads = 1;
+
+        for (const bool direct : {false, true}) {
+            for (const qint64 start : {qint64(0), qint64(5001)}) {
+                cfg.direct_io = direct;
+                AsyncFileReaderThread reader(tmp.fileName(), cfg);
+                reader.setStartPos(start);
+
+                QByteArray joined;
+                qint32 blocks = 0;
+                bool cutInWord = false;
+                const auto drain = [&]() {
+                    QByteArrayView batch[8];
+                    qsizetype sizeBefore = 0;
+                    while (const qsizetype taken = reader.takeDataBlocks(batch, 8, sizeBefore)) {
+                        for (qsizetype i = 0; i < taken; ++i) {
+                            // Конец файла - только у последнего блока, остальные кончаются разделителем
+                            if (joined.size() + batch[i].size() < content.size() - start) {
+                                const char last = batch[i].back();
+                                cutInWord = cutInWord || (last != ' ' && last != '\n');
+                            }
+                            joined.append(batch[i].data(), batch[i].size());
+                            ++blocks;
+                            reader.releaseDataBlock(batch[i]);
+                        }
+                    }
+                };
+                QEventLoop loop;
+                connect(&reader, &AsyncFileReaderThread::chunkIsReady, &loop, drain, Qt::QueuedConnection);
+                connect(&reader, &AsyncFileReaderThread::readingFinished, &loop, &QEventLoop::quit, Qt::QueuedConnection);
+                connect(&reader, &AsyncFileReaderThread::readingError, &loop, &QEventLoop::quit, Qt::QueuedConnection);
+                QTimer::singleShot(10000, &loop, &QEventLoop::quit);
+
+                reader.start();
+                QMetaObject::invokeMethod(&reader, "startReading", Qt::QueuedConnection);
+                loop.exec();
+                drain();
+
+                QVERIFY2(joined == content.mid(start), qPrintable(reader.backendName()));
+                QVERIFY(!cutInWord);
+                QVERIFY(blocks >= (content.size() - start) / (2 * cfg.chunk_size_bytes));
+
+                QThread* mainThread = QThread::currentThread();
+                QMetaObject::invokeMethod(&reader, [&reader, mainThread]() {
+                    reader.moveToThread(mainThread);
+                }, Qt::BlockingQueuedConnection);
+                reader.quit();
+                reader.wait();
+            }
+        }
+    }
+
+    void testCaseFoldingMatchesQStringToLower() {
+        // Длинное ASCII-слово (восьмибайтный путь), кириллица с Ё и Ѓ, латиница-1,
+        // и символы вне таблицы: İ меняет длину, ẞ трёхбайтный
+        const QByteArray text = QString("HELLO wOrLd ABCDEFGHIJKLMNOPQRSTUVWXYZ_0123 "
+                                        "ПРИВЕТ МирОК ЁЖИК ЃЀЏ абв "
+                                        "ÄÖÜß CAFÉ ÀÇÑØÞ "
+                                        "İSTANBUL STRAẞE MixedДанныеÉtÉ").toUtf8();
+
+        for (const QString& pattern : {QString("(*UCP)\\w+"), QString("(*UCP)(?:\\w)+")}) {
+            Config cfg = Config::defaultConfig();
+            cfg.string_pattern = pattern;
+            cfg.case_sensitive = true;
+            QStringList expected = tokenize(cfg, text);
+            QCOMPARE(expected.size(), qsizetype(14));
+            for (QString& word : expected)
+                word = word.toLower();
+
+            cfg.case_sensitive = false;
+            QCOMPARE(tokenize(cfg, text), expected);
+        }
+    }
+
+    void testRangeReaderSplitsWordsAtRangeBoundaries() {
+        // Слова на каждом стыке диапазонов по 4 КиБ и одно длиннее двух диапазонов
+        QByteArray content;
+        quint32 seed = 11;
+        while (content.size() < 64 * 1024) {
+            seed = seed * 1103515245u + 12345u;
+            content.append(QByteArray(1 + (seed >> 16) % 40, char('a' + (seed >> 8) % 26)));
+            content.append((seed >> 4) % 5 ? ' ' : '\n');
+            if (content.size() > 20000 && content.size() < 20100)
+                content.append(QByteArray(9000, 'z') + ' ');
+        }
+        for (qint64 boundary = 4096; boundary < content.size(); boundary += 4096) {
+            content[boundary - 1] = 'q';
+            content[boundary] = 'q';
+        }
+        QTemporaryFile tmp;
+        QVERIFY(tmp.open());
+        QCOMPARE(tmp.write(content), qint64(content.size()));
+        tmp.flush();
+
+        Config cfg = Config::defaultConfig();
+        cfg.read_backend = Config::ReadBackend::Ranges;
+        cfg.chunk_size_bytes = 4000;    // выравнивается до страницы
+
+        for (const qint64 start : {qint64(0), qint64(5001)}) {
+            RangeFileReaderThread reader(tmp.fileName(), cfg);
+            QCOMPARE(reader.rangeSize(), RangeFileReaderThread::kPageSize);
+            reader.setStartPos(start);
+
+            QSignalSpy spyStarted(&reader, &RangeFileReaderThread::totalSizeChanged);
+            QSignalSpy spyFinished(&reader, &RangeFileReaderThread::readingFinished);
+            reader.start();
+            QMetaObject::invokeMethod(&reader, "startReading", Qt::QueuedConnection);
+            QVERIFY(spyStarted.wait(5000));
+
+            // Забирают несколько потоков сразу, как воркеры анализатора
+            QMutex mutex;
+            QList<QPair<qint64, QByteArray>> blocks;
+            std::vector<std::unique_ptr<QThread>> workers;
+            for (int w = 0; w < 4; ++w) {
+                workers.emplace_back(QThread::create([&]() {
+                    QByteArrayView batch[2];
+                    qsizetype sizeBefore = 0;
+                    while (const qsizetype taken = reader.takeDataBlocks(batch, 2, sizeBefore)) {
+                        QMutexLocker locker(&mutex);
+                        for (qsizetype i = 0; i < taken; ++i)
+                            blocks.append({qint64(quintptr(batch[i].data())), batch[i].toByteArray()});
+                        locker.unlock();
+                        for (qsizetype i = 0; i < taken; ++i)
+                            reader.releaseDataBlock(batch[i]);
+                    }
+                }));
+                workers.back()->start();
+            }
+            for (auto& worker : workers)
+                QVERIFY(worker->wait(5000));
+            QVERIFY(reader.isDataEmpty());
+            // Чтение кончается, когда вернули последний блок, а не когда раздали диапазоны
+            QTRY_COMPARE_WITH_TIMEOUT(spyFinished.count(), 1, 5000);
+
+            std::sort(blocks.begin(), blocks.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            QByteArray joined;
+            for (qsizetype i = 0; i < blocks.size(); ++i) {
+                QVERIFY(!blocks[i].second.isEmpty());
+                // Без пропусков и перекрытий, каждый блок, кроме последнего, кончается разделителем
+                QCOMPARE(blocks[i].first - blocks.first().first, qint64(joined.size()));
+                if (i + 1 < blocks.size())
+                    QVERIFY(blocks[i].second.endsWith(' ') || blocks[i].second.endsWith('\n'));
+                joined += blocks[i].second;
+            }
+            QVERIFY(joined == content.mid(start));
+            // Длинное слово съело хотя бы один диапазон целиком
+            const qint64 firstRange = start / 4096 * 4096;
+            QVERIFY(blocks.size() < (content.size() - firstRange + 4095) / 4096);
+
+            QThread* mainThread = QThread::currentThread();
+            QMetaObject::invokeMethod(&reader, [&reader, mainThread]() {
+                reader.moveToThread(mainThread);
+            }, Qt::BlockingQueuedConnection);
+            reader.quit();
+            reader.wait();
+        }
+    }
+
+    void testAnalyzerOnRangeReaderReportsProgress() {
+        // Воркеры пула разбирают диапазоны, а поток анализатора тем временем шлёт прогресс
+        QTemporaryFile tmp;
+        QVERIFY(tmp.open());
+        QByteArray line;
+        for (int i = 0; i < 4096; ++i)
+            line += QString("w%1 ").arg(i % 997).toUtf8();
+        line += '\n';
+        qint64 written = 0;
+        while (written < 32 * 1024 * 1024)
+            written += tmp.write(line);
+        tmp.flush();
+
+        Config cfg = Config::defaultConfig();
+        cfg.read_backend = Config::ReadBackend::Ranges;
+        cfg.chunk_size_bytes = 64 * 1024;
+        cfg.analyzer_threads = 4;
+        cfg.update_interval_ms = 1;
+
+        auto reader = std::make_unique<RangeFileReaderThread>(tmp.fileName(), cfg);
+        auto analyzer = std::make_unique<BlockAnalyzerThread>(cfg, reader.get());
+        connect(reader.get(), &RangeFileReaderThread::chunkIsReady,
+                analyzer.get(), &BlockAnalyzerThread::analyzeBlock, Qt::QueuedConnection);
+        connect(reader.get(), &RangeFileReaderThread::readingFinished,
+                analyzer.get(), &BlockAnalyzerThread::analyzingFinishing, Qt::QueuedConnection);
+        connect(reader.get(), &RangeFileReaderThread::totalSizeChanged,
+                analyzer.get(), &BlockAnalyzerThread::setTotalSize, Qt::QueuedConnection);
+
+        // Все три сигнала идут из потока анализатора, очередь сохраняет их порядок
+        QStringList events;
+        connect(analyzer.get(), &BlockAnalyzerThread::progress, this, [&events](quint8 value) {
+            events << QString("progress %1").arg(value);
+        });
+        connect(analyzer.get(), &BlockAnalyzerThread::topWords, this, [&events]() {
+            events << "top";
+        });
+        QSignalSpy spyFinished(analyzer.get(), &BlockAnalyzerThread::analyzisFinished);
+
+        reader->start();
+        analyzer->start();
+        QMetaObject::invokeMethod(analyzer.get(), "startAnalyzis", Qt::QueuedConnection);
+        QMetaObject::invokeMethod(reader.get(), "startReading", Qt::QueuedConnection);
+        QVERIFY(spyFinished.wait(20000));
+        QCoreApplication::processEvents();
+
+        // Промежуточный прогресс и топ пришли до итоговых 100%: анализатор не стоял
+        // в analyzingFinishing, пока пул дочитывал файл
+        const qsizetype done = events.indexOf("progress 100");
+        QVERIFY2(done > 0, qPrintable(events.join(", ")));
+        const qsizetype partial = events.indexOf(QRegularExpression("progress [0-9]{1,2}"));
+        const qsizetype top = events.indexOf("top");
+        QVERIFY2(partial >= 0 && partial < done, qPrintable(events.join(", ")));
+        QVERIFY2(top >= 0 && top < done, qPrintable(events.join(", ")));
+
+        QThread* mainThread = QThread::currentThread();
+        for (QThread* thread : {static_cast<QThread*>(reader.get()), static_cast<QThread*>(analyzer.get())}) {
+            QMetaObject::invokeMethod(thread, [thread, mainThread]() {
+                thread->moveToThread(mainThread);
+            }, Qt::BlockingQueuedConnection);
+            thread->quit();
+            thread->wait();
+        }
+    }
+
+    void testNgramsAcrossBlockBoundaries() {
+        // Блоки по 1..12 слов: n-граммы тянутся через один и через несколько стыков
+        QStringList words;
+        quint32 seed = 3;
+        for (int i = 0; i < 3000; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            words << QString("w%1").arg((seed >> 16) % 7);
+        }
+        QStringList blocks;
+        for (qsizetype pos = 0; pos < words.size();) {
+            seed = seed * 1103515245u + 12345u;
+            const qsizetype length = 1 + (seed >> 16) % 12;
+            blocks << words.mid(pos, length).join(' ') + ' ';
+            pos += length;
+        }
+
+        for (const qint32 n : {2, 3}) {
+            QMap<QString, quint64> expected;
+            for (qsizetype i = 0; i + n <= words.size(); ++i)
+                ++expected[words.mid(i, n).join(' ')];
+
+            for (const qint32 threads : {1, 4}) {
+                Config cfg = Config::defaultConfig();
+                cfg.ngram_size = n;
+                cfg.analyzer_threads = threads;
+                cfg.top_n = static_cast<qint32>(expected.size()) + 10;
+                const auto list = runToFinish(cfg, blocks);
+
+                QMap<QString, quint64> counted;
+                for (const auto& entry : list)
+                    counted[entry.second] = entry.first;
+                QCOMPARE(counted, expected);
+            }
+        }
+    }
+
+    void testRingProviderBatches() {
+        const QByteArray payload = "0123456789";
+        const int total = 5000;
+        TestRingProvider ring(8);
+        QCOMPARE(ring.waitForData(0), false);
+
+        // Производитель в отдельном потоке, потребитель спит в waitForData, пока пусто
+        std::unique_ptr<QThread> producer(QThread::create([&ring, &payload]() {
+            for (int i = 0; i < total; ++i) {
+                const QByteArrayView block(payload.constData() + i % payload.size(), 1);
+                while (!ring.pushDataBlock(block))
+                    QThread::yieldCurrentThread();
+            }
+            ring.closeData();
+        }));
+        producer->start();
+
+        int received = 0;
+        qint64 sum = 0;
+        QByteArrayView blocks[4];
+        while (ring.waitForData(1000) || !producer->isFinished()) {
+            qsizetype sizeBefore = 0;
+            const qsizetype taken = ring.takeDataBlocks(blocks, 4, sizeBefore);
+            QVERIFY(taken <= 4);
+            for (qsizetype i = 0; i < taken; ++i)
+                sum += blocks[i][0] - '0';
+            received += int(taken);
+        }
+        producer->wait();
+
+        QCOMPARE(received, total);
+        QCOMPARE(sum, qint64(total / 10 * 45));
+        QVERIFY(ring.isDataEmpty());
+    }
+
+    void testConfigRejectsOnlyInvalidKey() {
+        const QJsonObject obj{{"top_n", 7}, {"chunk_size_bytes", -5}, {"window_seconds", 30},
+                              {"word_pattern", "[a-z"}};
+
+        // Строгий режим называет ключ и его значение
+        QString error;
+        Config::fromJsonObject(obj, &error);
+        QCOMPARE(error, QString("Invalid chunk_size_bytes in config: -5"));
+
+        // Без error по умолчанию берутся только неверные поля
+        const Config defaults = Config::defaultConfig();
+        const Config cfg = Config::fromJsonObject(obj);
+        QCOMPARE(cfg.top_n, 7);
+        QCOMPARE(cfg.window_seconds, 30);
+        QCOMPARE(cfg.chunk_size_bytes, defaults.chunk_size_bytes);
+        QCOMPARE(cfg.string_pattern, defaults.string_pattern);
+
+        // Верхняя граница ниже нижней поднимается, нижняя остаётся
+        const Config depths = Config::fromJsonObject(QJsonObject{{"queue_depth_min", 100}, {"queue_depth_max", 8}});
+        QCOMPARE(depths.queue_depth_min, 100);
+        QCOMPARE(depths.queue_depth_max, 100);
+
+        // Настройки Space-Saving проверяются так же
+        error.clear();
+        Config::fromJsonObject(QJsonObject{{"approx_capacity", 0}}, &error);
+        QCOMPARE(error, QString("Invalid approx_capacity in config: 0"));
+        error.clear();
+        Config::fromJsonObject(QJsonObject{{"approx_sketch_depth", -3}}, &error);
+        QCOMPARE(error, QString("Invalid approx_sketch_depth in config: -3"));
+        const Config sketch = Config::fromJsonObject(
+            QJsonObject{{"approx_capacity", -1}, {"approx_sketch_width", 2048}, {"approx_sketch_depth", -3}});
+        QCOMPARE(sketch.approx_capacity, defaults.approx_capacity);
+        QCOMPARE(sketch.approx_sketch_width, 2048);
+        QCOMPARE(sketch.approx_sketch_depth, defaults.approx_sketch_depth);
+    }
+
+    void testLoggerFiltersTruncatesAndCountsDrops() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString path = dir.filePath("logger.log");
+
+        // Logger заменяет обработчик QtTest: после теста он возвращается на место
+        const QtMessageHandler testHandler = qInstallMessageHandler(nullptr);
+        qInstallMessageHandler(testHandler);
+        const auto restore = qScopeGuard([testHandler]() {
+            qInstallMessageHandler(testHandler);
+            Logger::setLevel(QtDebugMsg);
+        });
+        Logger::init(path, QtInfoMsg);
+
+        // Потоки пишут пачками быстрее, чем разбирает поток записи: очередь на 1024 записи
+        // переполняется. debug ниже уровня и в файл попасть не должен
+        constexpr int kThreads = 4;
+        constexpr int kPerThread = 2000;
+        int rounds = 0;
+        bool overflowed = false;
+        while (rounds < 10 && !overflowed) {
+            const int round = rounds++;
+            std::vector<std::unique_ptr<QThread>> threads;
+            for (int t = 0; t < kThreads; ++t) {
+                threads.emplace_back(QThread::create([round, t]() {
+                    for (int i = 0; i < kPerThread; ++i) {
+                        qDebug("hidden %d %d %d", round, t, i);
+                        qInfo("shown %d %d %d", round, t, i);
+                    }
+                }));
+                threads.back()->start();
+            }
+            for (auto& thread : threads)
+                QVERIFY(thread->wait(10000));
+            Logger::flush();
+            // Число отброшенных пишется, когда очередь опустела, - не позже следующего сообщения
+            qWarning("round %d done", round);
+            Logger::flush();
+
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            overflowed = file.readAll().contains(" messages dropped, queue was full");
+        }
+        QVERIFY2(overflowed, "the logger queue never overflowed");
+
+        // Длинное сообщение обрезается до записи в 512 байт, не разрывая символ: € - три байта UTF-8
+        qInfo().noquote() << "long:" + QString(400, QChar(0x20AC));
+        Logger::flush();
+
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QList<QByteArray> lines = file.readAll().split('\n');
+        qint64 shown = 0;
+        qint64 dropped = 0;
+        QByteArray longLine;
+        for (const QByteArray& line : lines) {
+            QVERIFY2(!line.contains("] hidden "), line.constData());
+            if (line.contains("] shown "))
+                ++shown;
+            else if (line.startsWith("[Logger] "))
+                dropped += line.mid(9, line.indexOf(' ', 9) - 9).toLongLong();
+            else if (line.contains("long:"))
+                longLine = line;
+        }
+        // Каждое сообщение либо в файле, либо учтено в счётчике отброшенных
+        QVERIFY(dropped > 0);
+        QCOMPARE(shown + dropped, qint64(rounds) * kThreads * kPerThread);
+
+        QVERIFY(!longLine.isEmpty());
+        QVERIFY(longLine.size() + 1 <= 512);
+        QVERIFY(longLine.size() + 1 > 512 - 3);
+        QStringDecoder decoder(QStringDecoder::Utf8);
+        const QString text = decoder(longLine);
+        QVERIFY(!decoder.hasError());
+        const QString tail = text.mid(text.indexOf("long:") + 5);
+        QVERIFY(!tail.isEmpty() && tail.size() < 400);
+        QCOMPARE(tail, QString(tail.size(), QChar(0x20AC)));
+    }
+
     void testQueueProcessingAndSignals() {
         Config cfg = Config::defaultConfig();
         cfg.top_n = 10;
@@ -104,9 +1770,15 @@ private slots:
         mock.addData("Hello");
         QMetaObject::invokeMethod(analyzer.get(), "analyzeBlock", Qt::QueuedConnection);
 
-        // 2. Сброс
+        // 2. Сброс: GUI получает пустой топ, хотя пустой снимок совпадает с отобранным
+        QSignalSpy spyReset(analyzer.get(), &BlockAnalyzerThread::topWords);
+        QSignalSpy spyReady(analyzer.get(), &BlockAnalyzerThread::snapshotReady);
         QMetaObject::invokeMethod(analyzer.get(), "cancelAnalyzis", Qt::QueuedConnection);
         QTest::qWait(100);
+        QVERIFY(!spyReset.isEmpty());
+        QVERIFY(spyReset.last().at(0).value<QVector<QPair<quint64, QString>>>().isEmpty());
+        QVERIFY(!spyReady.isEmpty());
+        QVERIFY(analyzer->latestSnapshot()->top.isEmpty());
 
         QSignalSpy spy(analyzer.get(), &BlockAnalyzerThread::topWords);
         // 3. Считаем "World"